@@ -0,0 +1,13 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstddef>
+
+// Calls to the global operator new since the program started, so the demo can
+// check the steady-state dispatch path. The counting operator new and delete
+// live in their own translation unit: inlined into callers, GCC would flag the
+// malloc/free pair as mismatched with new/delete.
+extern std::atomic<size_t> allocationCount;
+
+#endif // ALLOCATIONCOUNTER_H
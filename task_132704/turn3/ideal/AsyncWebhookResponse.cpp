@@ -0,0 +1,419 @@
+#include "AsyncWebhookResponse.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t maxLatencySamples = 65536;
+
+// Sends every byte described by `iov`, resuming after partial writes
+bool sendAll(int fd, std::vector<iovec>& iov) {
+    size_t first = 0;
+    while (first < iov.size()) {
+        msghdr message{};
+        message.msg_iov = &iov[first];
+        message.msg_iovlen = std::min<size_t>(iov.size() - first, IOV_MAX);
+        ssize_t written = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        size_t remaining = static_cast<size_t>(written);
+        while (remaining > 0) {
+            if (remaining >= iov[first].iov_len) {
+                remaining -= iov[first].iov_len;
+                ++first;
+            } else {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+                iov[first].iov_len -= remaining;
+                remaining = 0;
+            }
+        }
+        while (first < iov.size() && iov[first].iov_len == 0) {
+            ++first;
+        }
+    }
+    return true;
+}
+
+// Waits until `fd` is ready for `events` or `deadline` passes; returns false on timeout or error
+bool waitUntil(int fd, short events, std::chrono::steady_clock::time_point deadline) {
+    for (;;) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() < 0) {
+            return false;
+        }
+        pollfd entry{fd, events, 0};
+        int ready = ::poll(&entry, 1, static_cast<int>(std::min<long long>(remaining.count() + 1, INT_MAX)));
+        if (ready > 0) {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+// Connects without blocking past `timeout`; returns false if the connect fails or times out
+bool connectWithin(int fd, const sockaddr* address, socklen_t length, std::chrono::milliseconds timeout, bool& timedOut) {
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return false;
+    }
+    if (::connect(fd, address, length) != 0) {
+        if (errno != EINPROGRESS) {
+            return false;
+        }
+        if (!waitUntil(fd, POLLOUT, std::chrono::steady_clock::now() + timeout)) {
+            timedOut = true;
+            return false;
+        }
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) != 0 || error != 0) {
+            return false;
+        }
+    }
+    return ::fcntl(fd, F_SETFL, flags) == 0;
+}
+
+size_t findHeaderValue(const std::string& headers, const char* lowerName) {
+    std::string lower(headers);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    size_t pos = lower.find(lowerName);
+    return pos == std::string::npos ? pos : pos + std::strlen(lowerName);
+}
+
+} // namespace
+
+AsyncWebhookResponse::AsyncWebhookResponse(AsyncResponseOptions options)
+    : options(options) {
+    if (this->options.maxCoalesce == 0) {
+        this->options.maxCoalesce = 1;
+    }
+    if (this->options.maxPipelineDepth == 0) {
+        this->options.maxPipelineDepth = 1;
+    }
+    latencySamplesUs.reserve(maxLatencySamples);
+    senderThread = std::thread(&AsyncWebhookResponse::runSender, this);
+}
+
+AsyncWebhookResponse::~AsyncWebhookResponse() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stop = true;
+    }
+    queueCondition.notify_one();
+    senderThread.join();
+    for (auto& entry : connections) {
+        closeConnection(entry.second);
+    }
+}
+
+void AsyncWebhookResponse::sendResponse(const std::string& url, const Payload& payload) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (queue.size() >= options.queueCapacity) {
+        if (!options.blockWhenFull) {
+            ++stats.dropped;
+            return;
+        }
+        spaceCondition.wait(lock, [this] { return queue.size() < options.queueCapacity; });
+    }
+    queue.push_back(Outbound{url, payload, Clock::now()});
+    lock.unlock();
+    queueCondition.notify_one();
+}
+
+void AsyncWebhookResponse::flush() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    idleCondition.wait(lock, [this] { return queue.empty() && !sending; });
+}
+
+AsyncResponseStats AsyncWebhookResponse::getStats() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    AsyncResponseStats snapshot = stats;
+    if (!latencySamplesUs.empty()) {
+        std::vector<double> samples(latencySamplesUs);
+        size_t index = (samples.size() - 1) * 99 / 100;
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        snapshot.p99EnqueueToSendUs = samples[index];
+    }
+    return snapshot;
+}
+
+void AsyncWebhookResponse::runSender() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    for (;;) {
+        queueCondition.wait(lock, [this] { return stop || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        std::deque<Outbound> batch;
+        batch.swap(queue);
+        sending = true;
+        lock.unlock();
+        spaceCondition.notify_all();
+
+        // Group by URL, keeping each URL's responses in the order they were queued
+        std::vector<std::pair<const Destination*, std::vector<Outbound*>>> groups;
+        std::unordered_map<std::string, size_t> groupIndex;
+        for (Outbound& outbound : batch) {
+            auto inserted = groupIndex.emplace(outbound.url, groups.size());
+            if (inserted.second) {
+                groups.emplace_back(&destinationFor(outbound.url), std::vector<Outbound*>());
+            }
+            groups[inserted.first->second].second.push_back(&outbound);
+        }
+        for (auto& group : groups) {
+            sendGroup(*group.first, group.second);
+        }
+
+        lock.lock();
+        sending = false;
+        if (queue.empty()) {
+            idleCondition.notify_all();
+        }
+    }
+}
+
+void AsyncWebhookResponse::sendGroup(const Destination& destination, std::vector<Outbound*>& responses) {
+    size_t delivered = 0;
+    size_t failed = 0;
+    size_t requests = 0;
+    size_t timeouts = 0;
+    std::vector<double> latencies;
+    latencies.reserve(responses.size());
+
+    bool timedOut = false;
+    Connection* connection = destination.valid ? &connectionFor(destination, timedOut) : nullptr;
+    if (timedOut) {
+        ++timeouts;
+    }
+    size_t index = 0;
+    while (index < responses.size()) {
+        if (!connection || connection->fd < 0) {
+            failed += responses.size() - index;
+            break;
+        }
+
+        // Pipeline a window of requests in one write, then collect their replies in order
+        std::vector<size_t> window;
+        std::vector<iovec> iov;
+        std::deque<std::string> headers;
+        size_t windowStart = index;
+        while (index < responses.size() && window.size() < options.maxPipelineDepth) {
+            size_t count = std::min(options.maxCoalesce, responses.size() - index);
+            appendRequest(iov, headers, destination, &responses[index], count);
+            window.push_back(count);
+            index += count;
+        }
+        bool healthy = sendAll(connection->fd, iov);
+        if (!healthy && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ++timeouts; // the peer stopped reading for longer than replyTimeout
+        }
+        if (healthy) {
+            requests += window.size();
+            Clock::time_point sentAt = Clock::now();
+            for (size_t i = windowStart; i < index; ++i) {
+                latencies.push_back(std::chrono::duration<double, std::micro>(sentAt - responses[i]->enqueuedAt).count());
+            }
+        }
+
+        timedOut = false;
+        for (size_t count : window) {
+            int status = 0;
+            if (healthy && readReply(*connection, status, timedOut)) {
+                (status >= 200 && status < 300 ? delivered : failed) += count;
+            } else {
+                if (healthy && timedOut) {
+                    ++timeouts;
+                }
+                healthy = false;
+                failed += count;
+            }
+        }
+        if (!healthy) {
+            // Drop the connection; the next group reconnects
+            closeConnection(*connection);
+            failed += responses.size() - index;
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    stats.delivered += delivered;
+    stats.failed += failed;
+    stats.requests += requests;
+    stats.timeouts += timeouts;
+    for (double latency : latencies) {
+        recordLatency(latency);
+    }
+}
+
+void AsyncWebhookResponse::appendRequest(std::vector<iovec>& iov, std::deque<std::string>& headers,
+                                         const Destination& destination, Outbound* const* responses, size_t count) {
+    size_t bodySize = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bodySize += responses[i]->payload.size();
+    }
+    if (count > 1) {
+        bodySize += count + 1; // brackets and separating commas
+    }
+
+    headers.push_back("POST " + destination.path + " HTTP/1.1\r\nHost: " + destination.host +
+                      "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(bodySize) +
+                      "\r\nX-Webhook-Count: " + std::to_string(count) + "\r\n\r\n");
+
+    // Payload bytes are referenced in place rather than copied into the request
+    static const char open[] = "[";
+    static const char comma[] = ",";
+    static const char close[] = "]";
+    iov.push_back(iovec{&headers.back()[0], headers.back().size()});
+    if (count > 1) {
+        iov.push_back(iovec{const_cast<char*>(open), 1});
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            iov.push_back(iovec{const_cast<char*>(comma), 1});
+        }
+        const Payload& payload = responses[i]->payload;
+        iov.push_back(iovec{const_cast<char*>(payload.data()), payload.size()});
+    }
+    if (count > 1) {
+        iov.push_back(iovec{const_cast<char*>(close), 1});
+    }
+}
+
+bool AsyncWebhookResponse::readReply(Connection& connection, int& status, bool& timedOut) {
+    char chunk[16384];
+    const Clock::time_point deadline = Clock::now() + options.replyTimeout;
+    for (;;) {
+        size_t headerEnd = connection.readBuffer.find("\r\n\r\n");
+        if (headerEnd != std::string::npos) {
+            std::string headers = connection.readBuffer.substr(0, headerEnd + 2);
+            if (headers.compare(0, 5, "HTTP/") != 0 || headers.size() < 12) {
+                return false;
+            }
+            status = std::atoi(headers.c_str() + 9);
+            size_t contentLength = 0;
+            size_t lengthPos = findHeaderValue(headers, "\r\ncontent-length:");
+            if (lengthPos != std::string::npos) {
+                contentLength = std::strtoul(headers.c_str() + lengthPos, nullptr, 10);
+            }
+            size_t total = headerEnd + 4 + contentLength;
+            if (connection.readBuffer.size() >= total) {
+                connection.readBuffer.erase(0, total);
+                return true;
+            }
+        }
+
+        if (!waitUntil(connection.fd, POLLIN, deadline)) {
+            timedOut = true;
+            return false;
+        }
+        ssize_t received = ::recv(connection.fd, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        connection.readBuffer.append(chunk, static_cast<size_t>(received));
+    }
+}
+
+AsyncWebhookResponse::Connection& AsyncWebhookResponse::connectionFor(const Destination& destination, bool& timedOut) {
+    Connection& connection = connections[destination.host + ":" + destination.port];
+    if (connection.fd >= 0) {
+        return connection;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (::getaddrinfo(destination.host.c_str(), destination.port.c_str(), &hints, &addresses) != 0) {
+        return connection;
+    }
+    for (addrinfo* address = addresses; address; address = address->ai_next) {
+        int fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connectWithin(fd, address->ai_addr, address->ai_addrlen, options.connectTimeout, timedOut)) {
+            int noDelay = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            // A peer that stops reading cannot block a pipelined write forever
+            timeval sendTimeout{};
+            sendTimeout.tv_sec = options.replyTimeout.count() / 1000;
+            sendTimeout.tv_usec = options.replyTimeout.count() % 1000 * 1000;
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+            connection.fd = fd;
+            break;
+        }
+        ::close(fd);
+    }
+    ::freeaddrinfo(addresses);
+
+    if (connection.fd >= 0) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        ++stats.connections;
+    }
+    return connection;
+}
+
+void AsyncWebhookResponse::closeConnection(Connection& connection) {
+    if (connection.fd >= 0) {
+        ::close(connection.fd);
+        connection.fd = -1;
+    }
+    connection.readBuffer.clear();
+}
+
+const AsyncWebhookResponse::Destination& AsyncWebhookResponse::destinationFor(const std::string& url) {
+    auto found = destinations.find(url);
+    if (found != destinations.end()) {
+        return found->second;
+    }
+
+    Destination destination;
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) == 0) {
+        size_t pathStart = url.find('/', scheme.size());
+        std::string hostPort = url.substr(scheme.size(), pathStart == std::string::npos ? std::string::npos : pathStart - scheme.size());
+        destination.path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+        size_t colon = hostPort.rfind(':');
+        destination.host = colon == std::string::npos ? hostPort : hostPort.substr(0, colon);
+        destination.port = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+        destination.valid = !destination.host.empty();
+    }
+    return destinations.emplace(url, destination).first->second;
+}
+
+// Called with queueMutex held
+void AsyncWebhookResponse::recordLatency(double micros) {
+    if (latencySamplesUs.size() < maxLatencySamples) {
+        latencySamplesUs.push_back(micros);
+    } else {
+        latencySamplesUs[nextSample] = micros;
+        nextSample = (nextSample + 1) % maxLatencySamples;
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef ASYNCWEBHOOKRESPONSE_H
+#define ASYNCWEBHOOKRESPONSE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "WebhookHandler.h"
+
+struct AsyncResponseOptions {
+    size_t queueCapacity = 65536;  // responses waiting to be sent
+    size_t maxCoalesce = 64;       // responses to one URL merged into a single request
+    size_t maxPipelineDepth = 32;  // requests written on a connection before reading replies
+    bool blockWhenFull = true;     // otherwise responses are dropped while the queue is full
+    std::chrono::milliseconds connectTimeout{2000};
+    std::chrono::milliseconds replyTimeout{5000}; // per reply, and per blocked write
+};
+
+struct AsyncResponseStats {
+    size_t delivered = 0;  // responses acknowledged with a 2xx status
+    size_t failed = 0;     // responses whose request failed or was rejected
+    size_t dropped = 0;    // responses refused because the queue was full
+    size_t requests = 0;   // HTTP requests written
+    size_t connections = 0;
+    size_t timeouts = 0;   // connects or replies abandoned at their deadline
+    double p99EnqueueToSendUs = 0;
+};
+
+// Response strategy that queues responses and sends them from a background
+// thread, so handlers never block on the outbound call. Each destination keeps
+// one persistent HTTP/1.1 connection; queued responses to the same URL are
+// coalesced into one request whose body is a JSON array of the payloads (with
+// an X-Webhook-Count header), and requests are pipelined before their replies
+// are read. Only plain http:// URLs are supported. A destination that does not
+// connect or reply in time has its connection dropped and the affected
+// responses counted as failed, so it cannot stall the queue.
+class AsyncWebhookResponse : public WebhookResponseStrategy {
+public:
+    explicit AsyncWebhookResponse(AsyncResponseOptions options = AsyncResponseOptions());
+    ~AsyncWebhookResponse() override;
+
+    AsyncWebhookResponse(const AsyncWebhookResponse&) = delete;
+    AsyncWebhookResponse& operator=(const AsyncWebhookResponse&) = delete;
+
+    void sendResponse(const std::string& url, const Payload& payload) override;
+
+    // Blocks until every queued response has been sent and acknowledged
+    void flush();
+
+    AsyncResponseStats getStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Outbound {
+        std::string url;
+        Payload payload;
+        Clock::time_point enqueuedAt;
+    };
+
+    struct Destination {
+        std::string host;
+        std::string port;
+        std::string path;
+        bool valid = false;
+    };
+
+    struct Connection {
+        int fd = -1;
+        std::string readBuffer;
+    };
+
+    void runSender();
+    void sendGroup(const Destination& destination, std::vector<Outbound*>& responses);
+    void appendRequest(std::vector<iovec>& iov, std::deque<std::string>& headers,
+                       const Destination& destination, Outbound* const* responses, size_t count);
+    bool readReply(Connection& connection, int& status, bool& timedOut);
+    Connection& connectionFor(const Destination& destination, bool& timedOut);
+    void closeConnection(Connection& connection);
+    const Destination& destinationFor(const std::string& url);
+    void recordLatency(double micros);
+
+    AsyncResponseOptions options;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::condition_variable spaceCondition;
+    std::condition_variable idleCondition;
+    std::deque<Outbound> queue;
+    bool sending = false;
+    bool stop = false;
+
+    AsyncResponseStats stats;
+    std::vector<double> latencySamplesUs; // ring of the most recent samples
+    size_t nextSample = 0;
+
+    // Only touched by the sender thread
+    std::unordered_map<std::string, Destination> destinations;
+    std::unordered_map<std::string, Connection> connections;
+
+    std::thread senderThread;
+};
+
+#endif // ASYNCWEBHOOKRESPONSE_H
@@ -0,0 +1,172 @@
+#include "BatchingWebhookDispatcher.h"
+
+BatchingWebhookDispatcher::BatchingWebhookDispatcher(BatchPolicy policy)
+    : policy(policy) {
+    if (this->policy.maxBatchSize == 0) {
+        this->policy.maxBatchSize = 1;
+    }
+    if (this->policy.maxQueued == 0) {
+        this->policy.maxQueued = 1;
+    }
+    deliveryThread = std::thread(&BatchingWebhookDispatcher::runDelivery, this);
+}
+
+BatchingWebhookDispatcher::~BatchingWebhookDispatcher() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        stop = true;
+    }
+    deliveryCondition.notify_one();
+    deliveryThread.join();
+}
+
+void BatchingWebhookDispatcher::registerHandler(const std::string& event, std::unique_ptr<WebhookHandler> handler) {
+    std::lock_guard<std::mutex> lock(batchMutex);
+    routes.registerRoute(event, pending.size());
+    pending.push_back(PendingBatch{handler.get(), {}, Clock::time_point::max()});
+    pending.back().payloads.reserve(policy.maxBatchSize);
+    ownedHandlers.push_back(std::move(handler));
+}
+
+void BatchingWebhookDispatcher::compileRoutes() {
+    std::lock_guard<std::mutex> lock(batchMutex);
+    routes.compile();
+}
+
+void BatchingWebhookDispatcher::setIdempotencyCache(IdempotencyCache* cache, const std::string& deliveryIdField) {
+    idempotencyCache = cache;
+    this->deliveryIdField = cache ? deliveryIdField : std::string();
+}
+
+DispatchResult BatchingWebhookDispatcher::handleWebhook(std::string_view event, Payload payload) {
+    const size_t* index = routes.find(event);
+    if (!index) {
+        std::cout << "No handler found for event: " << event << std::endl;
+        return DispatchResult::NoHandler;
+    }
+    std::string_view deliveryId;
+    if (idempotencyCache) {
+        deliveryId = extractJsonField(payload.view(), deliveryIdField);
+        if (!deliveryId.empty() && !idempotencyCache->insertIfAbsent(deliveryId)) {
+            return DispatchResult::Duplicate;
+        }
+    }
+
+    bool wakeDelivery = false;
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        if (queued >= policy.maxQueued) {
+            // Not accepted, so the sender's retry must not count as a duplicate
+            if (!deliveryId.empty()) {
+                idempotencyCache->forget(deliveryId);
+            }
+            return DispatchResult::Rejected;
+        }
+        ++queued;
+        PendingBatch& batch = pending[*index];
+        if (batch.payloads.empty()) {
+            batch.deadline = Clock::now() + policy.maxDelay;
+            wakeDelivery = true; // the delivery thread may need an earlier wake-up
+        }
+        batch.payloads.push_back(std::move(payload));
+        if (batch.payloads.size() >= policy.maxBatchSize) {
+            closeBatch(batch);
+            wakeDelivery = true;
+        }
+    }
+    if (wakeDelivery) {
+        deliveryCondition.notify_one();
+    }
+    return DispatchResult::Handled;
+}
+
+void BatchingWebhookDispatcher::flush() {
+    std::unique_lock<std::mutex> lock(batchMutex);
+    for (PendingBatch& batch : pending) {
+        if (!batch.payloads.empty()) {
+            closeBatch(batch);
+        }
+    }
+    deliveryCondition.notify_one();
+    idleCondition.wait(lock, [this] { return ready.empty() && inFlight == 0; });
+}
+
+// Moves a pending batch to the ready queue; called with batchMutex held
+void BatchingWebhookDispatcher::closeBatch(PendingBatch& batch) {
+    ready.push_back(ReadyBatch{batch.handler, std::move(batch.payloads)});
+    if (!spareBuffers.empty()) {
+        batch.payloads = std::move(spareBuffers.back());
+        spareBuffers.pop_back();
+    } else {
+        batch.payloads = std::vector<Payload>();
+        batch.payloads.reserve(policy.maxBatchSize);
+    }
+    batch.deadline = Clock::time_point::max();
+}
+
+void BatchingWebhookDispatcher::runDelivery() {
+    std::unique_lock<std::mutex> lock(batchMutex);
+    for (;;) {
+        // Close batches whose oldest webhook has waited long enough
+        Clock::time_point now = Clock::now();
+        Clock::time_point nextDeadline = Clock::time_point::max();
+        for (PendingBatch& batch : pending) {
+            if (batch.payloads.empty()) {
+                continue;
+            }
+            if (batch.deadline <= now) {
+                closeBatch(batch);
+            } else if (batch.deadline < nextDeadline) {
+                nextDeadline = batch.deadline;
+            }
+        }
+
+        if (ready.empty()) {
+            if (stop) {
+                return;
+            }
+            idleCondition.notify_all();
+            if (nextDeadline == Clock::time_point::max()) {
+                deliveryCondition.wait(lock);
+            } else {
+                deliveryCondition.wait_until(lock, nextDeadline);
+            }
+            continue;
+        }
+
+        ReadyBatch batch = std::move(ready.front());
+        ready.pop_front();
+        ++inFlight;
+        lock.unlock();
+        deliverBatch(batch);
+        size_t delivered = batch.payloads.size();
+        batch.payloads.clear();
+        lock.lock();
+        --inFlight;
+        queued -= delivered;
+        spareBuffers.push_back(std::move(batch.payloads));
+    }
+}
+
+// A throwing handler is counted and logged rather than taking the delivery thread down
+void BatchingWebhookDispatcher::deliverBatch(ReadyBatch& batch) {
+    try {
+        batch.handler->handleBatch(batch.payloads);
+        return;
+    } catch (const std::exception& error) {
+        std::cout << "Webhook batch handler failed: " << error.what() << std::endl;
+    } catch (...) {
+        std::cout << "Webhook batch handler failed" << std::endl;
+    }
+    failures.fetch_add(batch.payloads.size(), std::memory_order_relaxed);
+    // None of the batch counts as handled, so the provider's retries must be accepted
+    if (idempotencyCache) {
+        for (const Payload& payload : batch.payloads) {
+            std::string_view id = extractJsonField(payload.view(), deliveryIdField);
+            if (!id.empty()) {
+                idempotencyCache->forget(id);
+            }
+        }
+    }
+}
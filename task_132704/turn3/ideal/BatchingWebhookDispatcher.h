@@ -0,0 +1,95 @@
+#ifndef BATCHINGWEBHOOKDISPATCHER_H
+#define BATCHINGWEBHOOKDISPATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "IdempotencyCache.h"
+#include "JsonFieldScanner.h"
+#include "WebhookDispatcher.h"
+#include "WebhookHandler.h"
+#include "WebhookRouter.h"
+
+// Limits on how long webhooks may wait while a batch builds up
+struct BatchPolicy {
+    size_t maxBatchSize = 256;
+    std::chrono::microseconds maxDelay{2000};
+    size_t maxQueued = 65536; // webhooks awaiting delivery before new ones are Rejected
+};
+
+// Dispatcher that accumulates webhooks per handler and delivers them through
+// WebhookHandler::handleBatch once a batch is full or its oldest event has
+// waited maxDelay. Batches are delivered on a single worker thread, so each
+// handler sees its events in arrival order.
+class BatchingWebhookDispatcher {
+public:
+    explicit BatchingWebhookDispatcher(BatchPolicy policy = BatchPolicy());
+    ~BatchingWebhookDispatcher();
+
+    BatchingWebhookDispatcher(const BatchingWebhookDispatcher&) = delete;
+    BatchingWebhookDispatcher& operator=(const BatchingWebhookDispatcher&) = delete;
+
+    // Handlers must be registered before webhooks start flowing
+    void registerHandler(const std::string& event, std::unique_ptr<WebhookHandler> handler);
+    void compileRoutes();
+
+    // Rejects webhooks whose delivery ID field was already seen by `cache`;
+    // IDs from a batch whose handler throws are forgotten so retries go through
+    void setIdempotencyCache(IdempotencyCache* cache, const std::string& deliveryIdField = "delivery_id");
+
+    // Adds the webhook to its handler's batch, or returns Rejected when
+    // maxQueued webhooks are already waiting
+    DispatchResult handleWebhook(std::string_view event, Payload payload);
+
+    // Delivers every pending batch and waits until the handlers have run
+    void flush();
+
+    // Webhooks in batches whose handleBatch threw; the error is logged and delivery moves on
+    size_t failedWebhooks() const { return failures.load(std::memory_order_relaxed); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PendingBatch {
+        WebhookHandler* handler;
+        std::vector<Payload> payloads;
+        Clock::time_point deadline;
+    };
+
+    struct ReadyBatch {
+        WebhookHandler* handler;
+        std::vector<Payload> payloads;
+    };
+
+    void closeBatch(PendingBatch& batch);
+    void runDelivery();
+    void deliverBatch(ReadyBatch& batch);
+
+    BatchPolicy policy;
+    IdempotencyCache* idempotencyCache = nullptr;
+    std::string deliveryIdField;
+    std::vector<std::unique_ptr<WebhookHandler>> ownedHandlers;
+    WebhookRouter<size_t> routes;
+    std::vector<PendingBatch> pending;
+
+    std::mutex batchMutex;
+    std::condition_variable deliveryCondition;
+    std::condition_variable idleCondition;
+    std::deque<ReadyBatch> ready;
+    std::vector<std::vector<Payload>> spareBuffers;
+    size_t inFlight = 0;
+    size_t queued = 0; // webhooks pending, ready or in flight
+    std::atomic<size_t> failures{0};
+    bool stop = false;
+    std::thread deliveryThread;
+};
+
+#endif // BATCHINGWEBHOOKDISPATCHER_H
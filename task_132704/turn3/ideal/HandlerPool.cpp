@@ -0,0 +1,36 @@
+#include "HandlerPool.h"
+
+HandlerPool::HandlerPool(HandlerCreator creator, HandlerLifecycle lifecycle)
+    : creator(std::move(creator)), lifecycle(lifecycle) {
+    if (lifecycle == HandlerLifecycle::Stateless) {
+        sharedHandler = this->creator();
+    }
+}
+
+WebhookHandler* HandlerPool::acquire() {
+    if (lifecycle == HandlerLifecycle::Stateless) {
+        return sharedHandler.get();
+    }
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (!idleHandlers.empty()) {
+        WebhookHandler* handler = idleHandlers.back();
+        idleHandlers.pop_back();
+        return handler;
+    }
+
+    // Pool exhausted: grow it, keeping room to take every handler back without reallocating
+    ownedHandlers.push_back(creator());
+    idleHandlers.reserve(ownedHandlers.size());
+    return ownedHandlers.back().get();
+}
+
+void HandlerPool::release(WebhookHandler* handler) {
+    if (lifecycle == HandlerLifecycle::Stateless) {
+        return;
+    }
+
+    handler->reset();
+    std::lock_guard<std::mutex> lock(poolMutex);
+    idleHandlers.push_back(handler);
+}
@@ -0,0 +1,78 @@
+#ifndef HANDLERPOOL_H
+#define HANDLERPOOL_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "WebhookHandler.h"
+
+// How the factory manages handler instances for a webhook type
+enum class HandlerLifecycle {
+    Stateless, // one instance, constructed at registration and shared by every webhook
+    Stateful   // instances recycled through a per-type pool and reset() between webhooks
+};
+
+// Owns every handler instance of one webhook type. After warm-up, acquiring and
+// releasing handlers performs no heap allocation.
+class HandlerPool {
+public:
+    using HandlerCreator = std::function<std::unique_ptr<WebhookHandler>()>;
+
+    HandlerPool(HandlerCreator creator, HandlerLifecycle lifecycle);
+
+    WebhookHandler* acquire();
+    void release(WebhookHandler* handler);
+
+    HandlerLifecycle getLifecycle() const { return lifecycle; }
+
+private:
+    HandlerCreator creator;
+    HandlerLifecycle lifecycle;
+    std::unique_ptr<WebhookHandler> sharedHandler;
+
+    std::mutex poolMutex;
+    std::vector<std::unique_ptr<WebhookHandler>> ownedHandlers;
+    std::vector<WebhookHandler*> idleHandlers;
+};
+
+// Scoped handle to a handler borrowed from a HandlerPool; returns it on destruction
+class HandlerLease {
+public:
+    HandlerLease() = default;
+    HandlerLease(std::shared_ptr<HandlerPool> pool, WebhookHandler* handler)
+        : pool(std::move(pool)), handler(handler) {}
+    HandlerLease(HandlerLease&& other) noexcept
+        : pool(std::move(other.pool)), handler(other.handler) { other.handler = nullptr; }
+    HandlerLease& operator=(HandlerLease&& other) noexcept {
+        if (this != &other) {
+            reset();
+            pool = std::move(other.pool);
+            handler = other.handler;
+            other.handler = nullptr;
+        }
+        return *this;
+    }
+    HandlerLease(const HandlerLease&) = delete;
+    HandlerLease& operator=(const HandlerLease&) = delete;
+    ~HandlerLease() { reset(); }
+
+    WebhookHandler* operator->() const { return handler; }
+    WebhookHandler& operator*() const { return *handler; }
+    explicit operator bool() const { return handler != nullptr; }
+
+    void reset() {
+        if (handler) {
+            pool->release(handler);
+            handler = nullptr;
+        }
+        pool.reset();
+    }
+
+private:
+    std::shared_ptr<HandlerPool> pool;
+    WebhookHandler* handler = nullptr;
+};
+
+#endif // HANDLERPOOL_H
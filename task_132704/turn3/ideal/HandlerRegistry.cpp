@@ -0,0 +1,70 @@
+#include "HandlerRegistry.h"
+
+#include <thread>
+
+namespace {
+
+// Spreads reader threads over the counter slots so they rarely share a cache line
+size_t readerSlotForThisThread(size_t slots) {
+    static std::atomic<size_t> nextSlot{0};
+    thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot % slots;
+}
+
+} // namespace
+
+HandlerRegistry::ReadGuard::ReadGuard(const HandlerRegistry& registry) {
+    const size_t slot = readerSlotForThisThread(readerSlots);
+    for (;;) {
+        uint64_t seen = registry.epoch.load();
+        counter = &registry.readers[seen & 1][slot].count;
+        counter->fetch_add(1);
+        // If a writer flipped the epoch meanwhile it may already have stopped
+        // waiting on this counter, so register under the new epoch instead
+        if (registry.epoch.load() == seen) {
+            break;
+        }
+        counter->fetch_sub(1, std::memory_order_release);
+    }
+    current = registry.current.load(std::memory_order_acquire);
+}
+
+HandlerRegistry::HandlerRegistry() : current(new Snapshot()) {}
+
+HandlerRegistry::~HandlerRegistry() {
+    delete current.load();
+}
+
+void HandlerRegistry::registerHandler(const std::string& event, std::shared_ptr<WebhookHandler> handler, size_t eventId) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    auto next = std::make_unique<Snapshot>(*current.load());
+    next->routes.registerRoute(event, Route{handler.get(), eventId});
+    next->handlers[event] = std::move(handler); // a swapped-out handler dies with the old snapshot
+    publish(std::move(next));
+}
+
+void HandlerRegistry::compile() {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    auto next = std::make_unique<Snapshot>(*current.load());
+    next->routes.compile();
+    publish(std::move(next));
+}
+
+// Called with writerMutex held
+void HandlerRegistry::publish(std::unique_ptr<Snapshot> next) {
+    const Snapshot* old = current.exchange(next.release());
+    const uint64_t retiring = epoch.fetch_add(1) & 1;
+
+    // Grace period: readers registered under the old epoch may hold `old`
+    for (;;) {
+        int64_t active = 0;
+        for (const ReaderCount& reader : readers[retiring]) {
+            active += reader.count.load(std::memory_order_acquire);
+        }
+        if (active == 0) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    delete old;
+}
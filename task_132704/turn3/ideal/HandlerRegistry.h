@@ -0,0 +1,76 @@
+#ifndef HANDLERREGISTRY_H
+#define HANDLERREGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "WebhookHandler.h"
+#include "WebhookRouter.h"
+
+// Read-copy-update registry of webhook handlers. Dispatch reads an immutable
+// snapshot through a ReadGuard: one atomic load of the snapshot pointer plus
+// an increment of a per-thread-slot reader counter, never a mutex. Writers
+// copy the current snapshot, modify the copy, publish it with an atomic
+// exchange and then wait for a grace period (every reader that could still
+// see the old snapshot has left) before freeing it. Writers are serialised
+// and may block on slow handlers; readers never wait.
+class HandlerRegistry {
+public:
+    struct Route {
+        WebhookHandler* handler;
+        size_t eventId; // caller-assigned, e.g. the event's WebhookMetrics id
+    };
+
+    struct Snapshot {
+        WebhookRouter<Route> routes;
+        std::unordered_map<std::string, std::shared_ptr<WebhookHandler>> handlers; // owners, by event
+    };
+
+    // Keeps the snapshot seen at construction alive until destruction
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const HandlerRegistry& registry);
+        ~ReadGuard() { counter->fetch_sub(1, std::memory_order_release); }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const Snapshot& snapshot() const { return *current; }
+
+    private:
+        std::atomic<int64_t>* counter;
+        const Snapshot* current;
+    };
+
+    HandlerRegistry();
+    ~HandlerRegistry();
+
+    HandlerRegistry(const HandlerRegistry&) = delete;
+    HandlerRegistry& operator=(const HandlerRegistry&) = delete;
+
+    // Adds or swaps the handler for `event`; safe while webhooks are flowing
+    void registerHandler(const std::string& event, std::shared_ptr<WebhookHandler> handler, size_t eventId = 0);
+
+    // Publishes a snapshot whose routes are all in the perfect-hash table
+    void compile();
+
+private:
+    static constexpr size_t readerSlots = 32;
+
+    struct alignas(64) ReaderCount {
+        std::atomic<int64_t> count{0};
+    };
+
+    void publish(std::unique_ptr<Snapshot> next);
+
+    std::atomic<const Snapshot*> current;
+    std::atomic<uint64_t> epoch{0};
+    mutable ReaderCount readers[2][readerSlots];
+    std::mutex writerMutex;
+};
+
+#endif // HANDLERREGISTRY_H
@@ -0,0 +1,97 @@
+#include "IdempotencyCache.h"
+
+#include <functional>
+
+IdempotencyCache::IdempotencyCache(size_t capacity, std::chrono::milliseconds window)
+    : bucketCount(1),
+      epochLength(std::chrono::duration_cast<std::chrono::nanoseconds>(window) / epochsPerWindow) {
+    while (bucketCount * slotsPerBucket < capacity) {
+        bucketCount *= 2;
+    }
+    if (epochLength.count() <= 0) {
+        epochLength = std::chrono::nanoseconds(1);
+    }
+    buckets.reset(new Bucket[bucketCount]);
+    for (size_t i = 0; i < bucketCount; ++i) {
+        for (auto& slot : buckets[i].slots) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t IdempotencyCache::currentEpoch() const {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(now / epochLength) & epochMask;
+}
+
+IdempotencyCache::Bucket& IdempotencyCache::bucketFor(std::string_view deliveryId, uint64_t& fingerprint) const {
+    uint64_t hash = std::hash<std::string_view>()(deliveryId) * 0x9E3779B97F4A7C15ull;
+    fingerprint = ((hash >> 24) | 1) << 24; // never zero, low 24 bits hold the epoch
+    return buckets[(hash >> 7) & (bucketCount - 1)];
+}
+
+bool IdempotencyCache::insertIfAbsent(std::string_view deliveryId) {
+    uint64_t fingerprint;
+    Bucket& bucket = bucketFor(deliveryId, fingerprint);
+
+    for (;;) {
+        const uint64_t epoch = currentEpoch();
+        size_t victim = slotsPerBucket;
+        uint64_t victimValue = 0;
+        uint64_t victimAge = 0;
+        for (size_t i = 0; i < slotsPerBucket; ++i) {
+            uint64_t slot = bucket.slots[i].load(std::memory_order_acquire);
+            bool live = isLive(slot, epoch);
+            if (live && (slot & ~epochMask) == fingerprint) {
+                return false;
+            }
+            // Prefer a free or expired slot, otherwise the oldest live one
+            uint64_t age = live ? ((epoch - slot) & epochMask) : epochMask + 1;
+            if (victim == slotsPerBucket || age > victimAge) {
+                victim = i;
+                victimValue = slot;
+                victimAge = age;
+            }
+        }
+        const uint64_t inserted = fingerprint | epoch;
+        if (!bucket.slots[victim].compare_exchange_strong(victimValue, inserted, std::memory_order_seq_cst)) {
+            continue; // another thread changed the slot, possibly inserting this same ID; rescan
+        }
+
+        // Two threads inserting the same ID may have picked different slots.
+        // With sequentially consistent slot accesses the later of the two CASes
+        // always sees the earlier copy, so whoever sees another copy backs out.
+        // A thread that backs out and then finds no copy left retries, since
+        // the other thread backed out too.
+        if (!hasOtherCopy(bucket, victim, fingerprint, epoch)) {
+            return true;
+        }
+        uint64_t ours = inserted;
+        bucket.slots[victim].compare_exchange_strong(ours, victimValue, std::memory_order_seq_cst);
+        if (hasOtherCopy(bucket, slotsPerBucket, fingerprint, epoch)) {
+            return false;
+        }
+    }
+}
+
+bool IdempotencyCache::hasOtherCopy(const Bucket& bucket, size_t skip, uint64_t fingerprint, uint64_t epoch) const {
+    for (size_t i = 0; i < slotsPerBucket; ++i) {
+        uint64_t slot = bucket.slots[i].load(std::memory_order_seq_cst);
+        if (i != skip && isLive(slot, epoch) && (slot & ~epochMask) == fingerprint) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void IdempotencyCache::forget(std::string_view deliveryId) {
+    uint64_t fingerprint;
+    Bucket& bucket = bucketFor(deliveryId, fingerprint);
+    for (auto& slot : bucket.slots) {
+        uint64_t value = slot.load(std::memory_order_acquire);
+        if ((value & ~epochMask) == fingerprint) {
+            // Fails only if another thread has already reused the slot
+            slot.compare_exchange_strong(value, 0, std::memory_order_acq_rel);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef IDEMPOTENCYCACHE_H
+#define IDEMPOTENCYCACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+// Bounded, time-windowed set of webhook delivery IDs used to suppress provider
+// retries. Slots are 64-bit words packing a 40-bit fingerprint of the ID with
+// the 24-bit epoch it was last seen in; a slot whose epoch has left the window
+// counts as free. Each ID probes one bucket of eight slots (one cache line)
+// with plain atomic loads and a single CAS, so many ingest threads can check
+// and insert concurrently without locks. Memory is fixed at construction: when
+// a bucket is full of live IDs the oldest one is overwritten, which shortens
+// the effective window under extreme load rather than growing the table.
+class IdempotencyCache {
+public:
+    explicit IdempotencyCache(size_t capacity = size_t(1) << 20,
+                              std::chrono::milliseconds window = std::chrono::minutes(5));
+
+    // Returns true the first time `deliveryId` is seen within the window and
+    // false for a repeat, including when threads insert the same ID at once.
+    // Only an ID evicted from a full bucket in the meantime can be accepted twice.
+    bool insertIfAbsent(std::string_view deliveryId);
+
+    // Removes `deliveryId` so its next delivery is accepted again; for when
+    // handling the delivery failed and the provider's retry must go through
+    void forget(std::string_view deliveryId);
+
+    size_t memoryBytes() const { return bucketCount * sizeof(Bucket); }
+
+private:
+    static constexpr size_t slotsPerBucket = 8;
+    static constexpr uint64_t epochsPerWindow = 8;
+    static constexpr uint64_t epochMask = (uint64_t(1) << 24) - 1;
+
+    struct alignas(64) Bucket {
+        std::atomic<uint64_t> slots[slotsPerBucket];
+    };
+
+    // The ID's bucket and its fingerprint, placed above the epoch bits
+    Bucket& bucketFor(std::string_view deliveryId, uint64_t& fingerprint) const;
+    uint64_t currentEpoch() const;
+    // Whether a live slot other than `skip` holds the fingerprint
+    bool hasOtherCopy(const Bucket& bucket, size_t skip, uint64_t fingerprint, uint64_t epoch) const;
+    bool isLive(uint64_t slot, uint64_t epoch) const {
+        return slot != 0 && ((epoch - slot) & epochMask) <= epochsPerWindow;
+    }
+
+    std::unique_ptr<Bucket[]> buckets;
+    size_t bucketCount;
+    std::chrono::nanoseconds epochLength;
+};
+
+#endif // IDEMPOTENCYCACHE_H
@@ -0,0 +1,307 @@
+#include "JsonFieldScanner.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Returns the first position in [p, end) holding one of Cs, or end
+template <bool Vectorized, char... Cs>
+const char* findAny(const char* p, const char* end) {
+    if (Vectorized) {
+#if defined(__AVX2__)
+        while (end - p >= 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i hits = _mm256_setzero_si256();
+            ((hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(Cs)))), ...);
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+            if (mask) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+#endif
+#if defined(__SSE2__)
+        while (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i hits = _mm_setzero_si128();
+            ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(Cs)))), ...);
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+            if (mask) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+#endif
+    }
+    for (; p < end; ++p) {
+        if (((*p == Cs) || ...)) {
+            return p;
+        }
+    }
+    return end;
+}
+
+// Bit masks for one 64-byte block, bit i describing byte i
+struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t open = 0;  // '{' or '['
+    uint64_t close = 0; // '}' or ']'
+};
+
+template <bool Vectorized>
+BlockMasks classifyBlock(const char* block) {
+    BlockMasks masks;
+    if (Vectorized) {
+#if defined(__AVX2__)
+        for (int half = 0; half < 2; ++half) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * half));
+            auto match = [&](char c) {
+                uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c))));
+                return static_cast<uint64_t>(bits) << (32 * half);
+            };
+            masks.quote |= match('"');
+            masks.backslash |= match('\\');
+            masks.open |= match('{') | match('[');
+            masks.close |= match('}') | match(']');
+        }
+        return masks;
+#elif defined(__SSE2__)
+        for (int quarter = 0; quarter < 4; ++quarter) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * quarter));
+            auto match = [&](char c) {
+                uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c))));
+                return static_cast<uint64_t>(bits & 0xFFFF) << (16 * quarter);
+            };
+            masks.quote |= match('"');
+            masks.backslash |= match('\\');
+            masks.open |= match('{') | match('[');
+            masks.close |= match('}') | match(']');
+        }
+        return masks;
+#endif
+    }
+    for (int i = 0; i < 64; ++i) {
+        uint64_t bit = 1ull << i;
+        switch (block[i]) {
+        case '"': masks.quote |= bit; break;
+        case '\\': masks.backslash |= bit; break;
+        case '{': case '[': masks.open |= bit; break;
+        case '}': case ']': masks.close |= bit; break;
+        default: break;
+        }
+    }
+    return masks;
+}
+
+// Bit i of the result is set when an odd number of bits at or below i are set
+inline uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Walks the object a block at a time: quote and bracket masks give the
+// in-string mask by prefix XOR, so only string openings and brackets outside
+// strings are visited, whatever lies between them.
+template <bool Vectorized>
+class TopLevelScanner {
+public:
+    explicit TopLevelScanner(std::string_view json) : json(json) {}
+
+    size_t scan(const std::string_view* keys, size_t keyCount, std::string_view* values) {
+        for (size_t i = 0; i < keyCount; ++i) {
+            values[i] = std::string_view();
+        }
+        size_t first = skipWhitespace(0);
+        if (first >= json.size() || json[first] != '{') {
+            return 0;
+        }
+
+        size_t found = 0;
+        int depth = 0;
+        size_t skipUntil = 0;
+        size_t pendingKey = keyCount; // key whose object/array value is still open
+        size_t pendingStart = 0;
+        char padded[64];
+
+        for (size_t blockStart = 0; blockStart < json.size() && found < keyCount; blockStart += 64) {
+            const char* block = json.data() + blockStart;
+            if (json.size() - blockStart < 64) {
+                std::memset(padded, ' ', sizeof(padded));
+                std::memcpy(padded, block, json.size() - blockStart);
+                block = padded;
+            }
+
+            BlockMasks masks = classifyBlock<Vectorized>(block);
+            uint64_t quotes = masks.quote & ~findEscaped(masks.backslash);
+            uint64_t inString = prefixXor(quotes) ^ inStringCarry;
+            inStringCarry = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+            uint64_t events = (quotes & inString) | ((masks.open | masks.close) & ~inString);
+
+            for (; events != 0; events &= events - 1) {
+                size_t pos = blockStart + static_cast<size_t>(__builtin_ctzll(events));
+                if (pos < skipUntil) {
+                    continue;
+                }
+                char c = json[pos];
+                if (c == '{' || c == '[') {
+                    ++depth;
+                    continue;
+                }
+                if (c == '}' || c == ']') {
+                    if (--depth == 1 && pendingKey < keyCount) {
+                        values[pendingKey] = json.substr(pendingStart, pos + 1 - pendingStart);
+                        ++found;
+                        pendingKey = keyCount;
+                    }
+                    if (depth == 0) {
+                        return found;
+                    }
+                    continue;
+                }
+
+                // Opening quote; at depth 1 it is a key when followed by ':'
+                if (depth != 1) {
+                    continue;
+                }
+                size_t keyEnd = stringEnd(pos + 1);
+                size_t colon = skipWhitespace(keyEnd + 1);
+                if (keyEnd >= json.size() || colon >= json.size() || json[colon] != ':') {
+                    continue;
+                }
+                std::string_view key = json.substr(pos + 1, keyEnd - pos - 1);
+                size_t match = keyCount;
+                for (size_t i = 0; i < keyCount; ++i) {
+                    if (values[i].data() == nullptr && keys[i] == key) {
+                        match = i;
+                        break;
+                    }
+                }
+
+                size_t valueStart = skipWhitespace(colon + 1);
+                if (valueStart >= json.size()) {
+                    return found;
+                }
+                if (json[valueStart] == '"') {
+                    size_t valueEnd = stringEnd(valueStart + 1);
+                    if (valueEnd >= json.size()) {
+                        return found;
+                    }
+                    if (match < keyCount) {
+                        values[match] = json.substr(valueStart + 1, valueEnd - valueStart - 1);
+                        ++found;
+                    }
+                    skipUntil = valueEnd + 1;
+                } else if (json[valueStart] == '{' || json[valueStart] == '[') {
+                    if (match < keyCount) {
+                        pendingKey = match;
+                        pendingStart = valueStart;
+                    }
+                    skipUntil = valueStart; // the bracket itself is still an event
+                } else {
+                    size_t valueEnd = valueStart;
+                    while (valueEnd < json.size() && !isScalarEnd(json[valueEnd])) {
+                        ++valueEnd;
+                    }
+                    if (match < keyCount) {
+                        values[match] = json.substr(valueStart, valueEnd - valueStart);
+                        ++found;
+                    }
+                    skipUntil = valueEnd;
+                }
+            }
+        }
+        return found;
+    }
+
+private:
+    // Marks the bytes escaped by a backslash. Backslashes are rare in webhook
+    // payloads, so they are walked one by one.
+    uint64_t findEscaped(uint64_t backslash) {
+        uint64_t escaped = escapeCarry ? 1 : 0;
+        escapeCarry = false;
+        backslash &= ~escaped;
+        while (backslash != 0) {
+            int i = __builtin_ctzll(backslash);
+            backslash &= backslash - 1;
+            if (i == 63) {
+                escapeCarry = true;
+                break;
+            }
+            uint64_t next = 1ull << (i + 1);
+            escaped |= next;
+            backslash &= ~next;
+        }
+        return escaped;
+    }
+
+    // Index of the quote closing a string whose body starts at `from`
+    size_t stringEnd(size_t from) const {
+        const char* end = json.data() + json.size();
+        const char* p = json.data() + from;
+        for (;;) {
+            p = findAny<Vectorized, '"', '\\'>(p, end);
+            if (p >= end) {
+                return json.size();
+            }
+            if (*p == '"') {
+                return static_cast<size_t>(p - json.data());
+            }
+            p += 2;
+        }
+    }
+
+    size_t skipWhitespace(size_t pos) const {
+        while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\r' || json[pos] == '\n')) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    static bool isScalarEnd(char c) {
+        return c == ',' || c == '}' || c == ']' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    std::string_view json;
+    uint64_t inStringCarry = 0; // all ones when the previous block ended inside a string
+    bool escapeCarry = false;   // the previous block ended with an escaping backslash
+};
+
+size_t scanTopLevel(std::string_view json, const std::string_view* keys, size_t keyCount,
+                    std::string_view* values, bool vectorized) {
+    if (vectorized) {
+        return TopLevelScanner<true>(json).scan(keys, keyCount, values);
+    }
+    return TopLevelScanner<false>(json).scan(keys, keyCount, values);
+}
+
+} // namespace
+
+JsonFieldScanner::JsonFieldScanner(std::vector<std::string> keys, bool vectorized)
+    : keys(std::move(keys)), vectorized(vectorized) {
+    for (const std::string& key : this->keys) {
+        keyViews.emplace_back(key);
+    }
+}
+
+size_t JsonFieldScanner::scan(std::string_view json, std::string_view* values) const {
+    return scanTopLevel(json, keyViews.data(), keyViews.size(), values, vectorized);
+}
+
+std::string_view JsonFieldScanner::findField(std::string_view json, std::string_view key, bool vectorized) {
+    std::string_view value;
+    scanTopLevel(json, &key, 1, &value, vectorized);
+    return value;
+}
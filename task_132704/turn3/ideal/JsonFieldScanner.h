@@ -0,0 +1,37 @@
+#ifndef JSONFIELDSCANNER_H
+#define JSONFIELDSCANNER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Locates a fixed set of top-level keys in a JSON object without building a
+// DOM. String values are returned without their quotes (escapes untouched),
+// objects and arrays as their raw span, and scalars as written. The scan jumps
+// between structural characters 16 or 32 bytes at a time with SSE2/AVX2 when
+// the compiler targets them, and falls back to a byte loop otherwise.
+class JsonFieldScanner {
+public:
+    explicit JsonFieldScanner(std::vector<std::string> keys, bool vectorized = true);
+
+    // `values` must have room for keyCount() views; absent keys come back empty.
+    // Returns the number of keys found.
+    size_t scan(std::string_view json, std::string_view* values) const;
+
+    size_t keyCount() const { return keys.size(); }
+
+    // One-off lookup of a single top-level key
+    static std::string_view findField(std::string_view json, std::string_view key, bool vectorized = true);
+
+private:
+    std::vector<std::string> keys;
+    std::vector<std::string_view> keyViews;
+    bool vectorized;
+};
+
+// Returns the raw value of a top-level JSON field, or an empty view if it is absent
+inline std::string_view extractJsonField(std::string_view payload, std::string_view key) {
+    return JsonFieldScanner::findField(payload, key);
+}
+
+#endif // JSONFIELDSCANNER_H
@@ -0,0 +1,67 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Immutable view over a reference-counted receive buffer. Copying a Payload or
+// taking a slice of it only bumps the reference count, so a webhook body can
+// flow from ingestion through dispatch and into the response strategy without
+// its bytes ever being copied. The buffer is freed with the last Payload.
+class Payload {
+public:
+    Payload() = default;
+
+    // Takes ownership of the string's storage; the bytes are not copied
+    Payload(std::string&& bytes)
+        : buffer(std::make_shared<const std::string>(std::move(bytes))),
+          begin(buffer->data()), length(buffer->size()) {}
+
+    // Copies a string literal; convenient for demos and tests
+    Payload(const char* text) : Payload(std::string(text)) {}
+
+    // Explicit copy for callers that only hold borrowed bytes
+    static Payload copyOf(std::string_view bytes) { return Payload(std::string(bytes)); }
+
+    // Shares the same buffer; offset and count are clamped to this payload
+    Payload slice(size_t offset, size_t count = std::string_view::npos) const {
+        Payload part(*this);
+        offset = offset < length ? offset : length;
+        part.begin = begin + offset;
+        part.length = count < length - offset ? count : length - offset;
+        return part;
+    }
+
+    // Slice covering `part`, which must point into this payload
+    Payload slice(std::string_view part) const {
+        return slice(static_cast<size_t>(part.data() - begin), part.size());
+    }
+
+    std::string_view view() const { return std::string_view(begin, length); }
+    const char* data() const { return begin; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    std::string toString() const { return std::string(begin, length); }
+
+    // True when both payloads are views into the same receive buffer
+    bool sharesBufferWith(const Payload& other) const { return buffer && buffer == other.buffer; }
+
+    bool operator==(std::string_view other) const {
+        return length == other.size() && std::memcmp(begin, other.data(), length) == 0;
+    }
+
+private:
+    std::shared_ptr<const std::string> buffer;
+    const char* begin = "";
+    size_t length = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const Payload& payload) {
+    return out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+}
+
+#endif // PAYLOAD_H
@@ -0,0 +1,177 @@
+#include "PriorityWebhookDispatcher.h"
+
+#include <optional>
+
+PriorityWebhookDispatcher::PriorityWebhookDispatcher(size_t workerCount) {
+    for (size_t i = 0; i < (workerCount ? workerCount : 1); ++i) {
+        workers.emplace_back(&PriorityWebhookDispatcher::runWorker, this);
+    }
+}
+
+PriorityWebhookDispatcher::~PriorityWebhookDispatcher() {
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stop = true;
+    }
+    workCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t PriorityWebhookDispatcher::addLane(const std::string& name, LanePolicy policy) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    auto lane = std::make_unique<Lane>();
+    lane->name = name;
+    lane->policy = policy;
+    if (lane->policy.weight == 0) {
+        lane->policy.weight = 1;
+    }
+    if (lane->policy.capacity == 0) {
+        lane->policy.capacity = 1;
+    }
+    lanes.push_back(std::move(lane));
+    return lanes.size() - 1;
+}
+
+void PriorityWebhookDispatcher::registerHandler(const std::string& event, std::unique_ptr<WebhookHandler> handler, size_t lane) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (lane >= lanes.size()) {
+        std::cout << "Unknown lane " << lane << " for event: " << event << std::endl;
+        return;
+    }
+    routes.registerRoute(event, Route{handler.get(), lane, metrics ? metrics->registerEvent(event) : 0});
+    ownedHandlers.push_back(std::move(handler));
+}
+
+void PriorityWebhookDispatcher::compileRoutes() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    routes.compile();
+}
+
+void PriorityWebhookDispatcher::setMetrics(WebhookMetrics* metrics) {
+    this->metrics = metrics;
+}
+
+DispatchResult PriorityWebhookDispatcher::handleWebhook(std::string_view event, Payload payload) {
+    const Route* route = routes.find(event);
+    if (!route) {
+        std::cout << "No handler found for event: " << event << std::endl;
+        return DispatchResult::NoHandler;
+    }
+
+    uint64_t enqueuedAt = metrics ? MetricsClock::now() : 0;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        Lane& lane = *lanes[route->lane];
+        if (lane.jobs.size() >= lane.policy.capacity) {
+            if (lane.policy.overflow == OverflowPolicy::RejectNew) {
+                ++lane.stats.rejected;
+                return DispatchResult::Rejected;
+            }
+            lane.jobs.pop_front();
+            ++lane.stats.dropped;
+            --queued;
+        }
+        lane.jobs.push_back(Job{route, std::move(payload), enqueuedAt});
+        ++lane.stats.accepted;
+        ++queued;
+    }
+    workCondition.notify_one();
+    return DispatchResult::Handled;
+}
+
+void PriorityWebhookDispatcher::drain() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    idleCondition.wait(lock, [this] { return queued == 0 && inFlight == 0; });
+}
+
+size_t PriorityWebhookDispatcher::getLaneCount() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return lanes.size();
+}
+
+const std::string& PriorityWebhookDispatcher::getLaneName(size_t lane) const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return lanes.at(lane)->name;
+}
+
+LaneStats PriorityWebhookDispatcher::getLaneStats(size_t lane) const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    LaneStats stats = lanes.at(lane)->stats;
+    stats.queued = lanes[lane]->jobs.size();
+    return stats;
+}
+
+// Smooth weighted round robin: every backlogged lane earns its weight, the
+// richest one is served and pays back the total. Over any window a lane gets
+// weight/total of the picks, interleaved rather than in bursts. Called with
+// queueMutex held.
+PriorityWebhookDispatcher::Lane* PriorityWebhookDispatcher::pickLane() {
+    Lane* best = nullptr;
+    long total = 0;
+    for (auto& lane : lanes) {
+        if (lane->jobs.empty()) {
+            continue;
+        }
+        lane->credit += lane->policy.weight;
+        total += lane->policy.weight;
+        if (!best || lane->credit > best->credit) {
+            best = lane.get();
+        }
+    }
+    if (best) {
+        best->credit -= total;
+    }
+    return best;
+}
+
+void PriorityWebhookDispatcher::runWorker() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    for (;;) {
+        workCondition.wait(lock, [this] { return stop || queued > 0; });
+        if (queued == 0) {
+            return;
+        }
+
+        Lane* lane = pickLane();
+        Job job = std::move(lane->jobs.front());
+        lane->jobs.pop_front();
+        if (lane->jobs.empty()) {
+            lane->credit = 0; // an idle lane neither banks nor owes turns
+        }
+        --queued;
+        ++inFlight;
+        lock.unlock();
+        runJob(job);
+        job.payload = Payload();
+        lock.lock();
+        --inFlight;
+        ++lane->stats.handled;
+        if (queued == 0 && inFlight == 0) {
+            idleCondition.notify_all();
+        }
+    }
+}
+
+// A throwing handler is counted and logged rather than taking its worker down
+void PriorityWebhookDispatcher::runJob(const Job& job) {
+    std::optional<WebhookMetrics::Scope> scope;
+    if (metrics) {
+        scope.emplace(*metrics, job.route->eventId, job.enqueuedAt);
+    }
+    try {
+        job.route->handler->handleWebhook(job.payload);
+    } catch (const std::exception& error) {
+        if (scope) {
+            scope->fail();
+        }
+        std::cout << "Webhook handler failed: " << error.what() << std::endl;
+    } catch (...) {
+        if (scope) {
+            scope->fail();
+        }
+        std::cout << "Webhook handler failed" << std::endl;
+    }
+}
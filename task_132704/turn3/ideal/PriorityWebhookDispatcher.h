@@ -0,0 +1,110 @@
+#ifndef PRIORITYWEBHOOKDISPATCHER_H
+#define PRIORITYWEBHOOKDISPATCHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "WebhookDispatcher.h"
+#include "WebhookHandler.h"
+#include "WebhookMetrics.h"
+#include "WebhookRouter.h"
+
+// What a full lane does with a new webhook
+enum class OverflowPolicy {
+    RejectNew, // refuse it with DispatchResult::Rejected so the sender retries later
+    DropOldest // accept it and discard the longest-waiting webhook instead
+};
+
+struct LanePolicy {
+    unsigned weight = 1;     // share of worker time while other lanes are also backlogged
+    size_t capacity = 4096;  // queued webhooks before the overflow policy applies
+    OverflowPolicy overflow = OverflowPolicy::RejectNew;
+};
+
+struct LaneStats {
+    size_t accepted = 0;
+    size_t rejected = 0;
+    size_t dropped = 0;
+    size_t handled = 0;
+    size_t queued = 0;
+};
+
+// Dispatcher that assigns each event type to a priority lane. Every lane has
+// its own bounded queue, and workers pick the next webhook by smooth weighted
+// round robin over the lanes that have work, so a backlog of bulk events can
+// only take its weighted share of the workers from latency-critical ones.
+// Once a lane is full its overflow policy sheds load from that lane alone.
+// Handlers may run on several workers at once and must be thread-safe.
+class PriorityWebhookDispatcher {
+public:
+    explicit PriorityWebhookDispatcher(size_t workerCount = 1);
+    ~PriorityWebhookDispatcher();
+
+    PriorityWebhookDispatcher(const PriorityWebhookDispatcher&) = delete;
+    PriorityWebhookDispatcher& operator=(const PriorityWebhookDispatcher&) = delete;
+
+    // Lanes and handlers must be set up before webhooks start flowing.
+    // Returns the lane's index for registerHandler and getLaneStats.
+    size_t addLane(const std::string& name, LanePolicy policy = LanePolicy());
+    void registerHandler(const std::string& event, std::unique_ptr<WebhookHandler> handler, size_t lane);
+    void compileRoutes();
+
+    // Records per-event counts, queue waits and handler latencies. Set before registering handlers.
+    void setMetrics(WebhookMetrics* metrics);
+
+    // Queues the webhook on its event's lane, or returns Rejected when the lane is full
+    DispatchResult handleWebhook(std::string_view event, Payload payload);
+
+    // Blocks until every queued webhook has been handled
+    void drain();
+
+    size_t getLaneCount() const;
+    const std::string& getLaneName(size_t lane) const;
+    LaneStats getLaneStats(size_t lane) const;
+
+private:
+    struct Route {
+        WebhookHandler* handler;
+        size_t lane;
+        size_t eventId;
+    };
+
+    struct Job {
+        const Route* route;
+        Payload payload;
+        uint64_t enqueuedAt; // MetricsClock reading, taken only when metrics are on
+    };
+
+    struct Lane {
+        std::string name;
+        LanePolicy policy;
+        std::deque<Job> jobs;
+        long credit = 0; // smooth weighted round robin state
+        LaneStats stats;
+    };
+
+    Lane* pickLane();
+    void runWorker();
+    void runJob(const Job& job);
+
+    std::vector<std::unique_ptr<WebhookHandler>> ownedHandlers;
+    WebhookRouter<Route> routes;
+    WebhookMetrics* metrics = nullptr;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable workCondition;
+    std::condition_variable idleCondition;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    size_t queued = 0;
+    size_t inFlight = 0;
+    bool stop = false;
+    std::vector<std::thread> workers;
+};
+
+#endif // PRIORITYWEBHOOKDISPATCHER_H
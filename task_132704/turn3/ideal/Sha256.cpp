@@ -0,0 +1,246 @@
+#include "Sha256.h"
+
+#include <cstring>
+
+#if defined(__SHA__) && defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+alignas(16) const uint32_t roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#if !(defined(__SHA__) && defined(__SSE4_1__))
+inline uint32_t rotr(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+inline uint32_t loadBigEndian(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+#endif
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
+Sha256::Sha256()
+    : state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19} {}
+
+void Sha256::update(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    totalBytes += size;
+    if (buffered > 0) {
+        size_t take = std::min(size, blockSize - buffered);
+        std::memcpy(buffer + buffered, bytes, take);
+        buffered += take;
+        bytes += take;
+        size -= take;
+        if (buffered < blockSize) {
+            return;
+        }
+        compress(state, buffer, 1);
+        buffered = 0;
+    }
+    // Whole blocks are hashed straight from the caller's memory
+    if (size >= blockSize) {
+        compress(state, bytes, size / blockSize);
+        bytes += size - size % blockSize;
+        size %= blockSize;
+    }
+    std::memcpy(buffer, bytes, size);
+    buffered = size;
+}
+
+void Sha256::finish(uint8_t digest[digestSize]) {
+    uint64_t bits = totalBytes * 8;
+    buffer[buffered++] = 0x80;
+    if (buffered > blockSize - 8) {
+        std::memset(buffer + buffered, 0, blockSize - buffered);
+        compress(state, buffer, 1);
+        buffered = 0;
+    }
+    std::memset(buffer + buffered, 0, blockSize - 8 - buffered);
+    for (int i = 0; i < 8; ++i) {
+        buffer[blockSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    compress(state, buffer, 1);
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
+
+#if defined(__SHA__) && defined(__SSE4_1__)
+void Sha256::compress(uint32_t state[8], const uint8_t* blocks, size_t count) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The instructions keep the state as ABEF and CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; count > 0; --count, blocks += blockSize) {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+        __m128i words[4];
+
+        // Four rounds per step; the message schedule runs alongside, each
+        // word group finished (msg1 then msg2) a few steps before it is used
+#pragma GCC unroll 16
+        for (int step = 0; step < 16; ++step) {
+            if (step < 4) {
+                words[step] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * step)), byteSwap);
+            }
+            __m128i current = words[step & 3];
+            __m128i message = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i*>(&roundConstants[4 * step])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+            if (step >= 3 && step <= 14) {
+                __m128i& next = words[(step + 1) & 3];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(current, words[(step - 1) & 3], 4));
+                next = _mm_sha256msg2_epu32(next, current);
+            }
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0E));
+            if (step >= 1 && step <= 12) {
+                words[(step - 1) & 3] = _mm_sha256msg1_epu32(words[(step - 1) & 3], current);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+#else
+void Sha256::compress(uint32_t state[8], const uint8_t* blocks, size_t count) {
+    for (; count > 0; --count, blocks += blockSize) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = loadBigEndian(blocks + 4 * i);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + roundConstants[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+#endif
+
+HmacSha256::HmacSha256(std::string_view key) {
+    uint8_t block[Sha256::blockSize] = {};
+    if (key.size() > Sha256::blockSize) {
+        Sha256 keyHash;
+        keyHash.update(key);
+        keyHash.finish(block);
+    } else {
+        std::memcpy(block, key.data(), key.size());
+    }
+
+    uint8_t pad[Sha256::blockSize];
+    for (size_t i = 0; i < Sha256::blockSize; ++i) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    inner.update(pad, sizeof(pad));
+    for (size_t i = 0; i < Sha256::blockSize; ++i) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    outer.update(pad, sizeof(pad));
+}
+
+void HmacSha256::sign(std::string_view message, uint8_t mac[Sha256::digestSize]) const {
+    Sha256 hash = inner;
+    hash.update(message);
+    uint8_t innerDigest[Sha256::digestSize];
+    hash.finish(innerDigest);
+    hash = outer;
+    hash.update(innerDigest, sizeof(innerDigest));
+    hash.finish(mac);
+}
+
+std::string HmacSha256::signHex(std::string_view message) const {
+    static const char digits[] = "0123456789abcdef";
+    uint8_t mac[Sha256::digestSize];
+    sign(message, mac);
+    std::string hex(2 * Sha256::digestSize, '0');
+    for (size_t i = 0; i < Sha256::digestSize; ++i) {
+        hex[2 * i] = digits[mac[i] >> 4];
+        hex[2 * i + 1] = digits[mac[i] & 15];
+    }
+    return hex;
+}
+
+bool HmacSha256::verify(std::string_view message, std::string_view signatureHex) const {
+    if (signatureHex.compare(0, 7, "sha256=") == 0) {
+        signatureHex.remove_prefix(7);
+    }
+    if (signatureHex.size() != 2 * Sha256::digestSize) {
+        return false;
+    }
+    uint8_t mac[Sha256::digestSize];
+    sign(message, mac);
+
+    // Accumulate every difference so timing does not reveal where the first mismatch is
+    unsigned difference = 0;
+    for (size_t i = 0; i < Sha256::digestSize; ++i) {
+        int high = hexValue(signatureHex[2 * i]);
+        int low = hexValue(signatureHex[2 * i + 1]);
+        difference |= static_cast<unsigned>((high | low) < 0);
+        // Shift as unsigned: a non-hex digit is -1, already rejected above
+        unsigned byte = (static_cast<unsigned>(high) << 4) | static_cast<unsigned>(low);
+        difference |= (byte ^ mac[i]) & 0xFF;
+    }
+    return difference == 0;
+}
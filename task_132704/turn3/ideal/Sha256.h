@@ -0,0 +1,54 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Incremental SHA-256. The state is a plain value, so a partially hashed
+// prefix can be copied and resumed, which is what HmacSha256 relies on. Uses
+// the SHA extensions when the compiler targets them (-msha -msse4.1 or a
+// -march that has them) and portable code otherwise.
+class Sha256 {
+public:
+    static constexpr size_t blockSize = 64;
+    static constexpr size_t digestSize = 32;
+
+    Sha256();
+
+    void update(const void* data, size_t size);
+    void update(std::string_view data) { update(data.data(), data.size()); }
+
+    // Writes the digest; the object must not be updated afterwards
+    void finish(uint8_t digest[digestSize]);
+
+private:
+    static void compress(uint32_t state[8], const uint8_t* blocks, size_t count);
+
+    uint32_t state[8];
+    uint8_t buffer[blockSize];
+    size_t buffered = 0;
+    uint64_t totalBytes = 0;
+};
+
+// HMAC-SHA256 with the key schedule precomputed: the hash states after the
+// inner (key ^ 0x36) and outer (key ^ 0x5c) pad blocks are kept, so each
+// message costs only its own blocks plus one outer block, not two extra
+// compressions and a key setup.
+class HmacSha256 {
+public:
+    explicit HmacSha256(std::string_view key);
+
+    void sign(std::string_view message, uint8_t mac[Sha256::digestSize]) const;
+    std::string signHex(std::string_view message) const;
+
+    // Compares in constant time against a hex digest, optionally prefixed "sha256="
+    bool verify(std::string_view message, std::string_view signatureHex) const;
+
+private:
+    Sha256 inner;
+    Sha256 outer;
+};
+
+#endif // SHA256_H
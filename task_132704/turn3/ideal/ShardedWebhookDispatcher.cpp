@@ -0,0 +1,138 @@
+#include "ShardedWebhookDispatcher.h"
+
+ShardedWebhookDispatcher::ShardedWebhookDispatcher(size_t shardCount, const std::string& orderingKeyField)
+    : orderingKeyField(orderingKeyField) {
+    rebuildFieldScanner();
+    for (size_t i = 0; i < (shardCount ? shardCount : 1); ++i) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+    for (auto& shard : shards) {
+        Shard* s = shard.get();
+        s->worker = std::thread([this, s] { runShard(*s); });
+    }
+}
+
+ShardedWebhookDispatcher::~ShardedWebhookDispatcher() {
+    for (auto& shard : shards) {
+        {
+            std::lock_guard<std::mutex> lock(shard->queueMutex);
+            shard->stop = true;
+        }
+        shard->queueCondition.notify_one();
+    }
+    for (auto& shard : shards) {
+        shard->worker.join();
+    }
+}
+
+void ShardedWebhookDispatcher::registerHandler(const std::string& event, std::unique_ptr<WebhookHandler> handler) {
+    routes.registerRoute(event, handler.get());
+    ownedHandlers.push_back(std::move(handler));
+}
+
+void ShardedWebhookDispatcher::compileRoutes() {
+    routes.compile();
+}
+
+void ShardedWebhookDispatcher::setIdempotencyCache(IdempotencyCache* cache, const std::string& deliveryIdField) {
+    idempotencyCache = cache;
+    this->deliveryIdField = cache ? deliveryIdField : std::string();
+    rebuildFieldScanner();
+}
+
+void ShardedWebhookDispatcher::rebuildFieldScanner() {
+    fieldScanner.reset();
+    if (!orderingKeyField.empty() || !deliveryIdField.empty()) {
+        fieldScanner = std::make_unique<JsonFieldScanner>(std::vector<std::string>{orderingKeyField, deliveryIdField});
+    }
+}
+
+DispatchResult ShardedWebhookDispatcher::handleWebhook(std::string_view event, Payload payload) {
+    WebhookHandler* const* handler = routes.find(event);
+    if (!handler) {
+        std::cout << "No handler found for event: " << event << std::endl;
+        return DispatchResult::NoHandler;
+    }
+
+    // Both fields are views into the payload, which the job keeps alive
+    std::string_view fields[2];
+    if (fieldScanner) {
+        fieldScanner->scan(payload.view(), fields);
+    }
+    const std::string_view routingKey = orderingKeyField.empty() ? std::string_view() : fields[0];
+    const std::string_view deliveryId = fields[1];
+    if (idempotencyCache && !deliveryId.empty() && !idempotencyCache->insertIfAbsent(deliveryId)) {
+        return DispatchResult::Duplicate;
+    }
+
+    Shard& shard = *shards[shardFor(routingKey)];
+    {
+        std::lock_guard<std::mutex> lock(shard.queueMutex);
+        shard.jobs.push_back(Job{*handler, std::move(payload), routingKey, deliveryId});
+        shard.depth.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.queueCondition.notify_one();
+    return DispatchResult::Handled;
+}
+
+size_t ShardedWebhookDispatcher::queueDepth(size_t shard) const {
+    return shards[shard]->depth.load(std::memory_order_relaxed);
+}
+
+void ShardedWebhookDispatcher::drain() {
+    for (auto& shard : shards) {
+        std::unique_lock<std::mutex> lock(shard->queueMutex);
+        shard->idleCondition.wait(lock, [&] { return shard->depth.load() == 0; });
+    }
+}
+
+size_t ShardedWebhookDispatcher::shardFor(std::string_view key) {
+    if (key.empty()) {
+        // Unkeyed events carry no ordering constraint, so spread them evenly
+        return nextUnkeyedShard.fetch_add(1, std::memory_order_relaxed) % shards.size();
+    }
+    return std::hash<std::string_view>()(key) % shards.size();
+}
+
+void ShardedWebhookDispatcher::runShard(Shard& shard) {
+    std::deque<Job> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(shard.queueMutex);
+            shard.queueCondition.wait(lock, [&] { return shard.stop || !shard.jobs.empty(); });
+            if (shard.jobs.empty()) {
+                return; // stopping with nothing left to handle
+            }
+            batch.swap(shard.jobs);
+        }
+
+        // Take the whole queue at once so producers rarely contend with the worker
+        for (Job& job : batch) {
+            runJob(job);
+        }
+
+        size_t handled = batch.size();
+        batch.clear();
+        std::lock_guard<std::mutex> lock(shard.queueMutex);
+        if (shard.depth.fetch_sub(handled) == handled) {
+            shard.idleCondition.notify_all();
+        }
+    }
+}
+
+// A throwing handler is counted and logged rather than taking its shard down
+void ShardedWebhookDispatcher::runJob(const Job& job) {
+    try {
+        job.handler->handleRoutedWebhook(job.payload, job.routingKey);
+        return;
+    } catch (const std::exception& error) {
+        std::cout << "Webhook handler failed: " << error.what() << std::endl;
+    } catch (...) {
+        std::cout << "Webhook handler failed" << std::endl;
+    }
+    failures.fetch_add(1, std::memory_order_relaxed);
+    // The delivery was not handled, so the provider's retry must be accepted
+    if (idempotencyCache && !job.deliveryId.empty()) {
+        idempotencyCache->forget(job.deliveryId);
+    }
+}
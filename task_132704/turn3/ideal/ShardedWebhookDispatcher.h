@@ -0,0 +1,90 @@
+#ifndef SHARDEDWEBHOOKDISPATCHER_H
+#define SHARDEDWEBHOOKDISPATCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "IdempotencyCache.h"
+#include "JsonFieldScanner.h"
+#include "WebhookDispatcher.h"
+#include "WebhookHandler.h"
+#include "WebhookRouter.h"
+
+// Dispatcher that fans webhooks out to worker shards. Events with the same
+// ordering key always land on the same shard and are handled in arrival order;
+// events with different keys run in parallel. Handlers are shared by all shards
+// and must therefore be thread-safe.
+class ShardedWebhookDispatcher {
+public:
+    // `orderingKeyField` names the top-level payload field that picks the shard
+    explicit ShardedWebhookDispatcher(size_t shardCount, const std::string& orderingKeyField = "order_id");
+    ~ShardedWebhookDispatcher();
+
+    ShardedWebhookDispatcher(const ShardedWebhookDispatcher&) = delete;
+    ShardedWebhookDispatcher& operator=(const ShardedWebhookDispatcher&) = delete;
+
+    // Handlers must be registered before webhooks start flowing
+    void registerHandler(const std::string& event, std::unique_ptr<WebhookHandler> handler);
+    void compileRoutes();
+
+    // Rejects webhooks whose delivery ID field was already seen, before they are
+    // queued. Safe to share one cache between many ingest threads and dispatchers.
+    void setIdempotencyCache(IdempotencyCache* cache, const std::string& deliveryIdField = "delivery_id");
+
+    // Queues the webhook on its shard
+    DispatchResult handleWebhook(std::string_view event, Payload payload);
+
+    size_t getShardCount() const { return shards.size(); }
+
+    // Webhooks queued on, or currently being handled by, the given shard
+    size_t queueDepth(size_t shard) const;
+
+    // Blocks until every queued webhook has been handled
+    void drain();
+
+    // Webhooks whose handler threw; the shard logs the error and moves on
+    size_t failedWebhooks() const { return failures.load(std::memory_order_relaxed); }
+
+private:
+    struct Job {
+        WebhookHandler* handler;
+        Payload payload;
+        std::string_view routingKey;
+        std::string_view deliveryId; // forgotten again if the handler throws
+    };
+
+    struct Shard {
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::condition_variable idleCondition;
+        std::deque<Job> jobs;
+        std::atomic<size_t> depth{0};
+        bool stop = false;
+        std::thread worker;
+    };
+
+    void runShard(Shard& shard);
+    void runJob(const Job& job);
+    size_t shardFor(std::string_view key);
+    void rebuildFieldScanner();
+
+    // Configured before traffic starts. One scan extracts the ordering key and delivery ID together
+    std::string orderingKeyField;
+    std::string deliveryIdField;
+    std::unique_ptr<JsonFieldScanner> fieldScanner;
+    IdempotencyCache* idempotencyCache = nullptr;
+    std::vector<std::unique_ptr<WebhookHandler>> ownedHandlers;
+    WebhookRouter<WebhookHandler*> routes;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<size_t> nextUnkeyedShard{0};
+    std::atomic<size_t> failures{0};
+};
+
+#endif // SHARDEDWEBHOOKDISPATCHER_H
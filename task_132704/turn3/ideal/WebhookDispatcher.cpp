@@ -0,0 +1,72 @@
+#include "WebhookDispatcher.h"
+
+#include <optional>
+
+void WebhookDispatcher::registerHandler(const std::string& event, std::unique_ptr<WebhookHandler> handler) {
+    size_t eventId = metrics ? metrics->registerEvent(event) : 0;
+    registry.registerHandler(event, std::shared_ptr<WebhookHandler>(std::move(handler)), eventId);
+}
+
+void WebhookDispatcher::compileRoutes() {
+    registry.compile();
+}
+
+void WebhookDispatcher::setRoutingKeyField(const std::string& field) {
+    routingKeyField = field;
+    rebuildFieldScanner();
+}
+
+void WebhookDispatcher::setIdempotencyCache(IdempotencyCache* cache, const std::string& deliveryIdField) {
+    idempotencyCache = cache;
+    this->deliveryIdField = cache ? deliveryIdField : std::string();
+    rebuildFieldScanner();
+}
+
+void WebhookDispatcher::setMetrics(WebhookMetrics* metrics) {
+    this->metrics = metrics;
+}
+
+void WebhookDispatcher::rebuildFieldScanner() {
+    fieldScanner.reset();
+    if (!routingKeyField.empty() || !deliveryIdField.empty()) {
+        fieldScanner = std::make_unique<JsonFieldScanner>(std::vector<std::string>{routingKeyField, deliveryIdField});
+    }
+}
+
+DispatchResult WebhookDispatcher::handleWebhook(std::string_view event, const Payload& payload) {
+    // The guard keeps the snapshot, and so the handler, alive until we return
+    HandlerRegistry::ReadGuard guard(registry);
+    const HandlerRegistry::Route* route = guard.snapshot().routes.find(event);
+    if (!route) {
+        std::cout << "No handler found for event: " << event << std::endl;
+        return DispatchResult::NoHandler;
+    }
+
+    std::string_view fields[2];
+    if (fieldScanner) {
+        fieldScanner->scan(payload.view(), fields);
+    }
+    const std::string_view routingKey = routingKeyField.empty() ? std::string_view() : fields[0];
+    const std::string_view deliveryId = fields[1];
+    if (idempotencyCache && !deliveryId.empty() && !idempotencyCache->insertIfAbsent(deliveryId)) {
+        return DispatchResult::Duplicate;
+    }
+
+    // A delivery whose handler throws was not handled, so its retry must not count as a duplicate
+    std::optional<WebhookMetrics::Scope> scope;
+    if (metrics) {
+        scope.emplace(*metrics, route->eventId);
+    }
+    try {
+        route->handler->handleRoutedWebhook(payload, routingKey);
+    } catch (...) {
+        if (scope) {
+            scope->fail();
+        }
+        if (idempotencyCache && !deliveryId.empty()) {
+            idempotencyCache->forget(deliveryId);
+        }
+        throw;
+    }
+    return DispatchResult::Handled;
+}
@@ -0,0 +1,58 @@
+#ifndef WEBHOOKDISPATCHER_H
+#define WEBHOOKDISPATCHER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "HandlerRegistry.h"
+#include "IdempotencyCache.h"
+#include "JsonFieldScanner.h"
+#include "WebhookMetrics.h"
+#include "WebhookHandler.h"
+#include "WebhookRouter.h"
+
+enum class DispatchResult {
+    Handled,     // handed to (or queued for) the event's handler
+    NoHandler,   // no handler registered for the event
+    Duplicate,   // delivery ID already seen within the idempotency window
+    Rejected,    // the event's queue is full; the sender should retry later (HTTP 429)
+    Unauthorized // the webhook's signature did not verify (HTTP 401)
+};
+
+// Context Class that routes each event to its registered handler
+class WebhookDispatcher {
+public:
+    // Handlers may be added or swapped while webhooks are flowing; events
+    // registered after compileRoutes() are served from the router's fallback
+    void registerHandler(const std::string& event, std::unique_ptr<WebhookHandler> handler);
+    void compileRoutes();
+
+    // Top-level payload field handed to handlers as the routing key
+    void setRoutingKeyField(const std::string& field);
+
+    // Rejects webhooks whose delivery ID field was already seen by `cache`.
+    // The cache may be shared with other dispatchers.
+    void setIdempotencyCache(IdempotencyCache* cache, const std::string& deliveryIdField = "delivery_id");
+
+    // Records per-event counts and handler latencies into `metrics`, which may
+    // be shared with other dispatchers. Set before registering handlers.
+    void setMetrics(WebhookMetrics* metrics);
+
+    DispatchResult handleWebhook(std::string_view event, const Payload& payload);
+
+private:
+    void rebuildFieldScanner();
+
+    HandlerRegistry registry;
+
+    // Configured before traffic starts. One scan extracts the routing key and delivery ID together
+    std::string routingKeyField;
+    std::string deliveryIdField;
+    std::unique_ptr<JsonFieldScanner> fieldScanner;
+    IdempotencyCache* idempotencyCache = nullptr;
+    WebhookMetrics* metrics = nullptr;
+};
+
+#endif // WEBHOOKDISPATCHER_H
@@ -0,0 +1,96 @@
+#ifndef WEBHOOKHANDLER_H
+#define WEBHOOKHANDLER_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Payload.h"
+
+// Abstract Base Class for Webhook Handlers
+class WebhookHandler {
+public:
+    virtual ~WebhookHandler() = default;
+    virtual void handleWebhook(const Payload& payload) = 0;
+
+    // Called by dispatchers that extract a routing key before the handler runs;
+    // the key is a view into the payload
+    virtual void handleRoutedWebhook(const Payload& payload, std::string_view routingKey) {
+        handleWebhook(payload);
+    }
+
+    // Handles several webhooks of this type at once. Handlers that can amortise
+    // work across events (one database round trip per batch) override this;
+    // the default hands the payloads over one at a time.
+    virtual void handleBatch(const std::vector<Payload>& payloads) {
+        for (const Payload& payload : payloads) {
+            handleWebhook(payload);
+        }
+    }
+
+    // Clears per-webhook state before a pooled handler is reused
+    virtual void reset() {}
+};
+
+// Base Strategy Class for Webhook Responses
+class WebhookResponseStrategy {
+public:
+    virtual ~WebhookResponseStrategy() = default;
+    virtual void sendResponse(const std::string& url, const Payload& payload) = 0;
+};
+
+// Concrete Strategy Class for Common Webhook Response
+class CommonWebhookResponse : public WebhookResponseStrategy {
+public:
+    void sendResponse(const std::string& url, const Payload& payload) override {
+        std::cout << "Sending common webhook response to: " << url << std::endl;
+    }
+};
+
+// Concrete Webhook Handlers for specific events
+class OrderWebhookHandler : public WebhookHandler {
+public:
+    void handleWebhook(const Payload& payload) override {
+        std::cout << "Handling Order Webhook: " << payload << std::endl;
+    }
+};
+
+class PaymentWebhookHandler : public WebhookHandler {
+public:
+    void handleWebhook(const Payload& payload) override {
+        std::cout << "Handling Payment Webhook: " << payload << std::endl;
+    }
+};
+
+class OrderPlacedHandler : public WebhookHandler {
+public:
+    void handleWebhook(const Payload& payload) override {
+        std::cout << "Handling Order Placed event." << std::endl;
+    }
+};
+
+class PaymentReceivedHandler : public WebhookHandler {
+public:
+    void handleWebhook(const Payload& payload) override {
+        std::cout << "Handling Payment Received event." << std::endl;
+    }
+};
+
+// Webhook Handler that delegates its response to a strategy
+class ServiceAWebhookHandler : public WebhookHandler {
+public:
+    explicit ServiceAWebhookHandler(std::unique_ptr<WebhookResponseStrategy> responseStrategy)
+        : responseStrategy(std::move(responseStrategy)) {}
+
+    void handleWebhook(const Payload& payload) override {
+        // Service A-specific processing
+        responseStrategy->sendResponse("https://example.com/service-a/webhook", payload);
+    }
+
+private:
+    std::unique_ptr<WebhookResponseStrategy> responseStrategy;
+};
+
+#endif // WEBHOOKHANDLER_H
@@ -0,0 +1,28 @@
+#include "WebhookHandlerFactory.h"
+
+WebhookHandlerFactory::WebhookHandlerFactory() {
+    registerHandler("order", []() { return std::make_unique<OrderWebhookHandler>(); },
+                    HandlerLifecycle::Stateless);
+    registerHandler("payment", []() { return std::make_unique<PaymentWebhookHandler>(); },
+                    HandlerLifecycle::Stateless);
+    registerHandler("ServiceA", []() {
+        return std::make_unique<ServiceAWebhookHandler>(std::make_unique<CommonWebhookResponse>());
+    }, HandlerLifecycle::Stateless);
+    compileRoutes();
+}
+
+void WebhookHandlerFactory::registerHandler(const std::string& type, HandlerCreator creator,
+                                            HandlerLifecycle lifecycle) {
+    handlers.registerRoute(type, std::make_shared<HandlerPool>(std::move(creator), lifecycle));
+}
+
+void WebhookHandlerFactory::compileRoutes() {
+    handlers.compile();
+}
+
+HandlerLease WebhookHandlerFactory::createHandler(std::string_view type) const {
+    if (const std::shared_ptr<HandlerPool>* pool = handlers.find(type)) {
+        return HandlerLease(*pool, (*pool)->acquire());
+    }
+    return HandlerLease();
+}
@@ -0,0 +1,32 @@
+#ifndef WEBHOOKHANDLERFACTORY_H
+#define WEBHOOKHANDLERFACTORY_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "HandlerPool.h"
+#include "WebhookHandler.h"
+#include "WebhookRouter.h"
+
+// WebhookHandlerFactory to create appropriate handler based on type
+class WebhookHandlerFactory {
+public:
+    using HandlerCreator = HandlerPool::HandlerCreator;
+
+    WebhookHandlerFactory();
+
+    // Types registered after compileRoutes() are served from the router's fallback
+    void registerHandler(const std::string& type, HandlerCreator creator,
+                         HandlerLifecycle lifecycle = HandlerLifecycle::Stateful);
+    void compileRoutes();
+
+    // Borrows a handler for one webhook; an empty lease means the type is unknown
+    HandlerLease createHandler(std::string_view type) const;
+
+private:
+    WebhookRouter<std::shared_ptr<HandlerPool>> handlers;
+};
+
+#endif // WEBHOOKHANDLERFACTORY_H
@@ -0,0 +1,387 @@
+#include "WebhookHttpServer.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t readChunk = 64 * 1024;
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+const char* reasonPhrase(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 429: return "Too Many Requests";
+    case 501: return "Not Implemented";
+    default: return "Error";
+    }
+}
+
+} // namespace
+
+WebhookHttpServer::WebhookHttpServer(WebhookSink sink, HttpServerOptions options)
+    : sink(std::move(sink)), options(std::move(options)), readBuffer(readChunk) {}
+
+WebhookHttpServer::WebhookHttpServer(WebhookDispatcher& dispatcher, HttpServerOptions options)
+    : WebhookHttpServer([&dispatcher](std::string_view event, const Payload& payload) {
+          return dispatcher.handleWebhook(event, payload);
+      }, std::move(options)) {}
+
+WebhookHttpServer::~WebhookHttpServer() {
+    stop();
+}
+
+bool WebhookHttpServer::start() {
+    listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        return false;
+    }
+    int reuse = 1;
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(options.port);
+    socklen_t length = sizeof(address);
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0 ||
+        ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    port = ntohs(address.sin_port);
+
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event listenEvent{};
+    listenEvent.events = EPOLLIN | EPOLLET;
+    listenEvent.data.fd = listenFd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &listenEvent);
+    epoll_event wakeEvent{};
+    wakeEvent.events = EPOLLIN;
+    wakeEvent.data.fd = wakeFd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wakeEvent);
+
+    eventThread = std::thread(&WebhookHttpServer::runEventLoop, this);
+    return true;
+}
+
+void WebhookHttpServer::stop() {
+    if (!eventThread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+    eventThread.join();
+    for (auto& entry : connections) {
+        ::close(entry.first);
+    }
+    connections.clear();
+    ::close(listenFd);
+    ::close(epollFd);
+    ::close(wakeFd);
+}
+
+void WebhookHttpServer::runEventLoop() {
+    epoll_event events[256];
+    for (;;) {
+        int ready = ::epoll_wait(epollFd, events, 256, -1);
+        if (ready < 0 && errno != EINTR) {
+            return;
+        }
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                return;
+            }
+            if (fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection& connection = *found->second;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                onReadable(connection); // may close the connection
+            }
+            found = connections.find(fd);
+            if (found != connections.end() && (events[i].events & EPOLLOUT)) {
+                onWritable(*found->second);
+            }
+        }
+    }
+}
+
+void WebhookHttpServer::acceptConnections() {
+    // Edge-triggered: drain the whole accept queue, which matters during connection storms
+    for (;;) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return; // EAGAIN, or out of descriptors until some close
+        }
+        int noDelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = fd;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        connections[fd] = std::move(connection);
+    }
+}
+
+void WebhookHttpServer::onReadable(Connection& connection) {
+    bool peerClosed = false; // the client shut down its sending side
+    bool failed = false;
+    for (;;) {
+        ssize_t received = ::recv(connection.fd, readBuffer.data(), readBuffer.size(), 0);
+        if (received > 0) {
+            // Once a reply ends the connection, whatever the client sent after it is drained unread
+            if (!connection.closeAfterWrite) {
+                processRequests(connection, std::string_view(readBuffer.data(), static_cast<size_t>(received)));
+            }
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        peerClosed = received == 0;
+        failed = received < 0 && errno != EAGAIN && errno != EWOULDBLOCK;
+        break;
+    }
+
+    if (failed) {
+        closeConnection(connection);
+        return;
+    }
+    if (peerClosed) {
+        // A half-closed client still reads: answer what it sent, then close
+        connection.closeAfterWrite = true;
+    }
+    onWritable(connection);
+}
+
+void WebhookHttpServer::onWritable(Connection& connection) {
+    while (connection.outOffset < connection.out.size()) {
+        ssize_t written = ::send(connection.fd, connection.out.data() + connection.outOffset,
+                                 connection.out.size() - connection.outOffset, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return; // resumed on the next EPOLLOUT edge
+            }
+            closeConnection(connection);
+            return;
+        }
+        connection.outOffset += static_cast<size_t>(written);
+    }
+    connection.out.clear();
+    connection.outOffset = 0;
+    if (connection.closeAfterWrite) {
+        closeConnection(connection);
+    }
+}
+
+void WebhookHttpServer::closeConnection(Connection& connection) {
+    int fd = connection.fd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections.erase(fd);
+}
+
+bool WebhookHttpServer::parseRequest(std::string_view data, size_t offset, size_t scanFrom, ParsedRequest& request) const {
+    request = ParsedRequest();
+    size_t headerEnd = data.find("\r\n\r\n", scanFrom > offset ? scanFrom : offset);
+    if (headerEnd == std::string_view::npos) {
+        if (data.size() - offset > options.maxRequestBytes) {
+            request.start = offset;
+            request.errorStatus = 413;
+            return true;
+        }
+        return false;
+    }
+
+    request.start = offset;
+    request.bodyOffset = headerEnd + 4;
+
+    // Request line: METHOD SP PATH SP VERSION
+    size_t lineEnd = data.find("\r\n", offset);
+    std::string_view requestLine = data.substr(offset, lineEnd - offset);
+    size_t methodEnd = requestLine.find(' ');
+    size_t pathEnd = methodEnd == std::string_view::npos ? methodEnd : requestLine.find(' ', methodEnd + 1);
+    if (pathEnd == std::string_view::npos) {
+        request.errorStatus = 400;
+        return true;
+    }
+    request.isPost = requestLine.substr(0, methodEnd) == "POST";
+    request.pathOffset = offset + methodEnd + 1;
+    request.pathLength = pathEnd - methodEnd - 1;
+    request.keepAlive = requestLine.substr(pathEnd + 1) != "HTTP/1.0";
+
+    size_t contentLength = 0;
+    for (size_t lineStart = lineEnd + 2; lineStart < headerEnd;) {
+        size_t end = data.find("\r\n", lineStart);
+        std::string_view line = data.substr(lineStart, end - lineStart);
+        lineStart = end + 2;
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view name = trim(line.substr(0, colon));
+        std::string_view value = trim(line.substr(colon + 1));
+        if (equalsIgnoreCase(name, "content-length")) {
+            contentLength = std::strtoull(std::string(value).c_str(), nullptr, 10);
+        } else if (equalsIgnoreCase(name, "connection")) {
+            if (equalsIgnoreCase(value, "close")) {
+                request.keepAlive = false;
+            } else if (equalsIgnoreCase(value, "keep-alive")) {
+                request.keepAlive = true;
+            }
+        } else if (equalsIgnoreCase(name, "transfer-encoding") && !equalsIgnoreCase(value, "identity")) {
+            request.errorStatus = 501;
+            return true;
+        }
+    }
+
+    if (contentLength > options.maxRequestBytes) {
+        request.errorStatus = 413;
+        return true;
+    }
+    if (data.size() - request.bodyOffset < contentLength) {
+        return false; // body still arriving
+    }
+    request.bodyLength = contentLength;
+    request.length = request.bodyOffset + contentLength - offset;
+    return true;
+}
+
+void WebhookHttpServer::processRequests(Connection& connection, std::string_view received) {
+    // Parse straight from the read buffer unless an earlier read left part of a request
+    std::string_view data = received;
+    if (!connection.in.empty()) {
+        connection.in.append(received);
+        data = connection.in;
+    }
+
+    parsed.clear();
+    size_t offset = 0;
+    ParsedRequest request;
+    while (offset < data.size() && parseRequest(data, offset, connection.scanFrom, request)) {
+        parsed.push_back(request);
+        if (request.errorStatus != 0) {
+            break; // the connection is closed after a malformed request
+        }
+        offset += request.length;
+        connection.scanFrom = 0;
+    }
+    if (parsed.empty()) {
+        if (connection.in.empty()) {
+            connection.in.assign(received);
+        }
+        // Resume the header search where this one stopped, minus a partial
+        // "\r\n\r\n", or at the end of headers whose body is still arriving
+        connection.scanFrom = request.bodyOffset != 0 ? request.bodyOffset - 4
+                                                      : (connection.in.size() > 3 ? connection.in.size() - 3 : 0);
+        return;
+    }
+
+    // The completed requests get one buffer of exactly their size, and bodies
+    // are dispatched as slices of it; what follows waits in `in`
+    Payload requests = Payload::copyOf(data.substr(0, offset));
+    if (connection.in.empty()) {
+        connection.in.assign(received.substr(offset));
+    } else {
+        connection.in.erase(0, offset);
+    }
+    if (connection.in.empty() && connection.in.capacity() > readChunk) {
+        std::string().swap(connection.in); // let go of the room a large request needed
+    }
+    connection.scanFrom = 0;
+
+    for (const ParsedRequest& parsedRequest : parsed) {
+        if (parsedRequest.errorStatus != 0) {
+            appendReply(connection.out, parsedRequest.errorStatus, false);
+            connection.closeAfterWrite = true;
+            connection.in.clear();
+            break;
+        }
+
+        std::string_view path = requests.view().substr(parsedRequest.pathOffset, parsedRequest.pathLength);
+        path = path.substr(0, path.find('?'));
+        int status = 404;
+        if (!parsedRequest.isPost) {
+            status = 405;
+        } else if (path.compare(0, options.pathPrefix.size(), options.pathPrefix) == 0) {
+            std::string_view event = path.substr(options.pathPrefix.size());
+            switch (sink(event, requests.slice(parsedRequest.bodyOffset, parsedRequest.bodyLength))) {
+            case DispatchResult::Handled: status = 202; break;
+            case DispatchResult::Duplicate: status = 200; break;
+            case DispatchResult::NoHandler: status = 404; break;
+            case DispatchResult::Rejected: status = 429; break;
+            case DispatchResult::Unauthorized: status = 401; break;
+            }
+        }
+        served.fetch_add(1, std::memory_order_relaxed);
+        appendReply(connection.out, status, parsedRequest.keepAlive);
+        if (!parsedRequest.keepAlive) {
+            connection.closeAfterWrite = true;
+            connection.in.clear();
+            break;
+        }
+    }
+}
+
+void WebhookHttpServer::appendReply(std::string& out, int status, bool keepAlive) {
+    out += "HTTP/1.1 ";
+    out += std::to_string(status);
+    out += ' ';
+    out += reasonPhrase(status);
+    out += keepAlive ? "\r\nContent-Length: 0\r\n\r\n" : "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+}
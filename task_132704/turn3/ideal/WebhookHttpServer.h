@@ -0,0 +1,93 @@
+#ifndef WEBHOOKHTTPSERVER_H
+#define WEBHOOKHTTPSERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "WebhookDispatcher.h"
+
+struct HttpServerOptions {
+    uint16_t port = 0;                       // 0 picks an ephemeral port
+    std::string pathPrefix = "/webhooks/";   // POST <prefix><event>
+    size_t maxRequestBytes = 8 * 1024 * 1024;
+};
+
+// Single-threaded HTTP/1.1 ingestion front-end on an edge-triggered epoll
+// loop. Requests are parsed incrementally as bytes arrive, keep-alive and
+// pipelined requests are served in order. Each read goes into one reused
+// buffer; the requests it completes are copied once into a buffer of exactly
+// their size, and each body is handed to the sink as a Payload slice of it.
+// Replies: 202 when handled, 200 for a duplicate delivery, 404 for an unknown
+// event, 429 when the sink sheds load, 4xx for malformed requests. Chunked
+// request bodies are not supported.
+class WebhookHttpServer {
+public:
+    using WebhookSink = std::function<DispatchResult(std::string_view event, const Payload& payload)>;
+
+    explicit WebhookHttpServer(WebhookSink sink, HttpServerOptions options = HttpServerOptions());
+    explicit WebhookHttpServer(WebhookDispatcher& dispatcher, HttpServerOptions options = HttpServerOptions());
+    ~WebhookHttpServer();
+
+    WebhookHttpServer(const WebhookHttpServer&) = delete;
+    WebhookHttpServer& operator=(const WebhookHttpServer&) = delete;
+
+    // Binds to 127.0.0.1 and starts the event loop thread; returns false if the socket setup fails
+    bool start();
+    void stop();
+
+    uint16_t getPort() const { return port; }
+    size_t requestsServed() const { return served.load(std::memory_order_relaxed); }
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string in;         // start of a request whose remaining bytes have not arrived
+        size_t scanFrom = 0;    // where to resume looking for the end of the headers
+        std::string out;        // replies waiting for the socket to accept them
+        size_t outOffset = 0;
+        bool closeAfterWrite = false;
+    };
+
+    // Offsets are relative to the start of the connection's receive buffer
+    struct ParsedRequest {
+        size_t start = 0;
+        size_t length = 0;      // header plus body bytes
+        size_t pathOffset = 0;
+        size_t pathLength = 0;
+        size_t bodyOffset = 0;
+        size_t bodyLength = 0;
+        bool isPost = false;
+        bool keepAlive = true;
+        int errorStatus = 0;    // non-zero when the request must be rejected
+    };
+
+    void runEventLoop();
+    void acceptConnections();
+    void onReadable(Connection& connection);
+    void onWritable(Connection& connection);
+    void closeConnection(Connection& connection);
+    bool parseRequest(std::string_view data, size_t offset, size_t scanFrom, ParsedRequest& request) const;
+    void processRequests(Connection& connection, std::string_view received);
+    static void appendReply(std::string& out, int status, bool keepAlive);
+
+    WebhookSink sink;
+    HttpServerOptions options;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    uint16_t port = 0;
+    std::atomic<size_t> served{0};
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<ParsedRequest> parsed; // scratch space reused by processRequests
+    std::vector<char> readBuffer;      // every recv lands here first
+    std::thread eventThread;
+};
+
+#endif // WEBHOOKHTTPSERVER_H
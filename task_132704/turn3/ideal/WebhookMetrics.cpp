@@ -0,0 +1,286 @@
+#include "WebhookMetrics.h"
+
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+std::atomic<uint64_t> nextInstanceId{1};
+
+// Single-writer counter update: the owning thread is the only writer, so a
+// relaxed load and store is enough and avoids a locked instruction
+inline void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct AtomicHistogram {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maximum{0};
+    std::atomic<uint64_t> buckets[LatencyHistogram::bucketCount] = {};
+
+    void record(uint64_t nanos) {
+        bump(buckets[LatencyHistogram::bucketIndex(nanos)]);
+        bump(count);
+        bump(sum, nanos);
+        if (nanos > maximum.load(std::memory_order_relaxed)) {
+            maximum.store(nanos, std::memory_order_relaxed);
+        }
+    }
+};
+
+void appendMicros(std::ostringstream& out, uint64_t nanos) {
+    out << std::round(nanos / 100.0) / 10.0;
+}
+
+void appendHistogramText(std::ostringstream& out, const char* name, const LatencyHistogram& histogram) {
+    out << ' ' << name << " p50=";
+    appendMicros(out, histogram.percentile(0.5));
+    out << " p99=";
+    appendMicros(out, histogram.percentile(0.99));
+    out << " p999=";
+    appendMicros(out, histogram.percentile(0.999));
+    out << " max=";
+    appendMicros(out, histogram.max());
+}
+
+void appendHistogramJson(std::ostringstream& out, const char* name, const LatencyHistogram& histogram) {
+    out << "\"" << name << "\": {\"count\": " << histogram.count() << ", \"mean\": " << std::llround(histogram.mean())
+        << ", \"p50\": " << histogram.percentile(0.5) << ", \"p99\": " << histogram.percentile(0.99)
+        << ", \"p999\": " << histogram.percentile(0.999) << ", \"max\": " << histogram.max() << "}";
+}
+
+void appendJsonString(std::ostringstream& out, const std::string& value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+double MetricsClock::nanosPerTick() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double scale = [] {
+        auto begin = std::chrono::steady_clock::now();
+        uint64_t beginTicks = now();
+        while (std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(10)) {
+        }
+        uint64_t ticks = now() - beginTicks;
+        double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        return ticks ? nanos / ticks : 1.0;
+    }();
+    return scale;
+#else
+    return 1.0;
+#endif
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t index) {
+    if (index < (1u << subBucketBits)) {
+        return index;
+    }
+    int magnitude = static_cast<int>(index >> subBucketBits) + subBucketBits - 1;
+    uint64_t subBucket = index & ((1u << subBucketBits) - 1);
+    uint64_t width = uint64_t(1) << (magnitude - subBucketBits);
+    return (((uint64_t(1) << subBucketBits) + subBucket) << (magnitude - subBucketBits)) + width / 2;
+}
+
+void LatencyHistogram::record(uint64_t nanos, uint64_t times) {
+    buckets[bucketIndex(nanos)] += times;
+    total += times;
+    sum += nanos * times;
+    if (nanos > maximum) {
+        maximum = nanos;
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < bucketCount; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    if (other.maximum > maximum) {
+        maximum = other.maximum;
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * total));
+    rank = rank == 0 ? 1 : rank;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(bucketValue(i), maximum);
+        }
+    }
+    return maximum;
+}
+
+std::string MetricsSnapshot::toText() const {
+    std::ostringstream out;
+    for (const EventMetrics& event : events) {
+        out << event.event << " handled=" << event.handled << " errors=" << event.errors;
+        appendHistogramText(out, "handler_us", event.handlerTime);
+        if (event.queueWait.count() > 0) {
+            appendHistogramText(out, "queue_wait_us", event.queueWait);
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+std::string MetricsSnapshot::toJson() const {
+    std::ostringstream out;
+    out << "{\"events\": [";
+    for (size_t i = 0; i < events.size(); ++i) {
+        const EventMetrics& event = events[i];
+        out << (i ? ", " : "") << "{\"event\": ";
+        appendJsonString(out, event.event);
+        out << ", \"handled\": " << event.handled << ", \"errors\": " << event.errors << ", ";
+        appendHistogramJson(out, "handler_ns", event.handlerTime);
+        out << ", ";
+        appendHistogramJson(out, "queue_wait_ns", event.queueWait);
+        out << "}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+struct alignas(64) WebhookMetrics::EventRecorder {
+    explicit EventRecorder(uint32_t interval) : untilTimed(interval) {}
+
+    uint32_t untilTimed; // owner-only countdown to the next timed call
+    std::atomic<uint64_t> handled{0};
+    std::atomic<uint64_t> errors{0};
+    AtomicHistogram queueWait;
+    AtomicHistogram handlerTime;
+};
+
+struct WebhookMetrics::ThreadRecorder {
+    std::atomic<EventRecorder*> events[maxEvents] = {};
+
+    ~ThreadRecorder() {
+        for (auto& event : events) {
+            delete event.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+WebhookMetrics::WebhookMetrics(uint32_t timingSampleInterval)
+    : instanceId(nextInstanceId.fetch_add(1)), nanosPerTick(MetricsClock::nanosPerTick()),
+      timingSampleInterval(timingSampleInterval ? timingSampleInterval : 1) {}
+
+WebhookMetrics::~WebhookMetrics() = default;
+
+size_t WebhookMetrics::registerEvent(std::string_view event) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto found = eventIds.find(std::string(event));
+    if (found != eventIds.end()) {
+        return found->second;
+    }
+    if (eventNames.size() >= maxEvents) {
+        return maxEvents - 1;
+    }
+    eventNames.emplace_back(event);
+    eventIds.emplace(std::string(event), eventNames.size() - 1);
+    return eventNames.size() - 1;
+}
+
+WebhookMetrics::EventRecorder* WebhookMetrics::localRecorder(size_t eventId) {
+    // A few (metrics instance, recorder) pairs are cached per thread, so the
+    // registry is only consulted the first time a thread records
+    struct CacheEntry {
+        uint64_t instanceId = 0;
+        ThreadRecorder* recorder = nullptr;
+    };
+    thread_local CacheEntry cache[4];
+    thread_local size_t nextVictim = 0;
+
+    ThreadRecorder* recorder = nullptr;
+    for (const CacheEntry& entry : cache) {
+        if (entry.instanceId == instanceId) {
+            recorder = entry.recorder;
+            break;
+        }
+    }
+    if (!recorder) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        std::unique_ptr<ThreadRecorder>& owned = recorders[std::this_thread::get_id()];
+        if (!owned) {
+            owned = std::make_unique<ThreadRecorder>();
+        }
+        recorder = owned.get();
+        cache[nextVictim++ % 4] = CacheEntry{instanceId, recorder};
+    }
+
+    std::atomic<EventRecorder*>& slot = recorder->events[eventId < maxEvents ? eventId : maxEvents - 1];
+    EventRecorder* event = slot.load(std::memory_order_relaxed);
+    if (!event) {
+        event = new EventRecorder(1); // a thread's first call is always timed
+        slot.store(event, std::memory_order_release);
+    }
+    return event;
+}
+
+WebhookMetrics::Scope::Scope(WebhookMetrics& metrics, size_t eventId, uint64_t enqueuedAt)
+    : recorder(metrics.localRecorder(eventId)), nanosPerTick(metrics.nanosPerTick), enqueuedAt(enqueuedAt) {
+    if (--recorder->untilTimed == 0) {
+        recorder->untilTimed = metrics.timingSampleInterval;
+        startedAt = MetricsClock::now();
+    }
+}
+
+WebhookMetrics::Scope::~Scope() {
+    bump(failed ? recorder->errors : recorder->handled);
+    if (startedAt == 0) {
+        return;
+    }
+    uint64_t finishedAt = MetricsClock::now();
+    recorder->handlerTime.record(static_cast<uint64_t>((finishedAt - startedAt) * nanosPerTick));
+    if (enqueuedAt != 0 && startedAt > enqueuedAt) {
+        recorder->queueWait.record(static_cast<uint64_t>((startedAt - enqueuedAt) * nanosPerTick));
+    }
+}
+
+MetricsSnapshot WebhookMetrics::snapshot() const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    MetricsSnapshot snapshot;
+    snapshot.events.resize(eventNames.size());
+    for (size_t id = 0; id < eventNames.size(); ++id) {
+        EventMetrics& metrics = snapshot.events[id];
+        metrics.event = eventNames[id];
+        for (const auto& entry : recorders) {
+            const EventRecorder* event = entry.second->events[id].load(std::memory_order_acquire);
+            if (!event) {
+                continue;
+            }
+            metrics.handled += event->handled.load(std::memory_order_relaxed);
+            metrics.errors += event->errors.load(std::memory_order_relaxed);
+            for (auto pair : {std::make_pair(&event->queueWait, &metrics.queueWait),
+                              std::make_pair(&event->handlerTime, &metrics.handlerTime)}) {
+                const AtomicHistogram& source = *pair.first;
+                LatencyHistogram& target = *pair.second;
+                for (size_t i = 0; i < LatencyHistogram::bucketCount; ++i) {
+                    target.buckets[i] += source.buckets[i].load(std::memory_order_relaxed);
+                }
+                target.total += source.count.load(std::memory_order_relaxed);
+                target.sum += source.sum.load(std::memory_order_relaxed);
+                target.maximum = std::max(target.maximum, source.maximum.load(std::memory_order_relaxed));
+            }
+        }
+    }
+    return snapshot;
+}
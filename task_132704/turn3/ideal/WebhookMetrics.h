@@ -0,0 +1,156 @@
+#ifndef WEBHOOKMETRICS_H
+#define WEBHOOKMETRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Timestamps for latency recording: the TSC where available (calibrated
+// against steady_clock once), steady_clock nanoseconds otherwise
+class MetricsClock {
+public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static double nanosPerTick();
+};
+
+// Log-linear latency histogram in the style of HdrHistogram: values below 32
+// ns are exact, above that every power of two is split into 32 buckets, so a
+// reported value is within about 3% of the recorded one. Values from 2^37 ns
+// (~2 minutes) up share the last bucket.
+class LatencyHistogram {
+public:
+    static constexpr int subBucketBits = 5;
+    static constexpr int maxMagnitude = 36;
+    static constexpr size_t bucketCount = (maxMagnitude - subBucketBits + 2) << subBucketBits;
+
+    static size_t bucketIndex(uint64_t nanos) {
+        if (nanos < (1u << subBucketBits)) {
+            return static_cast<size_t>(nanos);
+        }
+        int magnitude = 63 - __builtin_clzll(nanos);
+        if (magnitude > maxMagnitude) {
+            return bucketCount - 1;
+        }
+        size_t subBucket = static_cast<size_t>(nanos >> (magnitude - subBucketBits)) & ((1u << subBucketBits) - 1);
+        return (static_cast<size_t>(magnitude - subBucketBits + 1) << subBucketBits) + subBucket;
+    }
+
+    // Midpoint of the values that land in bucket `index`
+    static uint64_t bucketValue(size_t index);
+
+    LatencyHistogram() : buckets(bucketCount, 0) {}
+
+    void record(uint64_t nanos, uint64_t times = 1);
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maximum; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0; }
+
+    // Smallest recorded value at or above the given fraction of samples
+    uint64_t percentile(double fraction) const;
+
+private:
+    friend class WebhookMetrics;
+
+    std::vector<uint64_t> buckets;
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t maximum = 0;
+};
+
+struct EventMetrics {
+    std::string event;
+    uint64_t handled = 0;
+    uint64_t errors = 0;     // handler calls that threw
+    LatencyHistogram queueWait;   // enqueue to handler start, for queued dispatchers
+    LatencyHistogram handlerTime; // handler execution
+};
+
+struct MetricsSnapshot {
+    std::vector<EventMetrics> events;
+
+    // One line per event type: counts plus p50/p99/p999/max latencies in microseconds
+    std::string toText() const;
+    std::string toJson() const;
+};
+
+// Per-event-type counters and latency histograms for the dispatchers. Every
+// recording thread writes only to its own recorder (relaxed atomic stores, no
+// read-modify-write and no shared cache lines), and snapshot() merges all
+// recorders, so recording never contends with other threads or with a scrape.
+// Counts are exact. Reading the clock costs more than the rest of a recording,
+// so each thread times one call in `timingSampleInterval` per event type; the
+// histograms are a uniform sample, and an interval of 1 times every call.
+class WebhookMetrics {
+    struct EventRecorder;
+    struct ThreadRecorder;
+
+public:
+    // Event types beyond this share the last id
+    static constexpr size_t maxEvents = 1024;
+
+    explicit WebhookMetrics(uint32_t timingSampleInterval = 8);
+    ~WebhookMetrics();
+
+    WebhookMetrics(const WebhookMetrics&) = delete;
+    WebhookMetrics& operator=(const WebhookMetrics&) = delete;
+
+    // Returns the id recordings for `event` use; the same name always maps to the same id
+    size_t registerEvent(std::string_view event);
+
+    // Counts, and when sampled times, one handler call for `eventId`. `enqueuedAt` is
+    // the MetricsClock reading taken when the webhook was queued, or 0 for synchronous dispatch.
+    class Scope {
+    public:
+        Scope(WebhookMetrics& metrics, size_t eventId, uint64_t enqueuedAt = 0);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // Counts the call as an error instead of a success
+        void fail() { failed = true; }
+
+    private:
+        EventRecorder* recorder;
+        double nanosPerTick;
+        uint64_t enqueuedAt;
+        uint64_t startedAt = 0; // 0 when this call is not timed
+        bool failed = false;
+    };
+
+    MetricsSnapshot snapshot() const;
+
+private:
+    EventRecorder* localRecorder(size_t eventId);
+
+    const uint64_t instanceId;
+    const double nanosPerTick;
+    const uint32_t timingSampleInterval;
+    mutable std::mutex registryMutex;
+    std::unordered_map<std::string, size_t> eventIds;
+    std::vector<std::string> eventNames;
+    std::unordered_map<std::thread::id, std::unique_ptr<ThreadRecorder>> recorders;
+};
+
+#endif // WEBHOOKMETRICS_H
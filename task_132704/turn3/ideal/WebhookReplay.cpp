@@ -0,0 +1,227 @@
+#include "WebhookReplay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "WebhookMetrics.h"
+
+namespace {
+
+const char traceHeader[] = "webhook-trace 1";
+
+std::string makeSyntheticPayload(const std::string& event, size_t sequence, size_t targetBytes) {
+    std::string payload = "{\"delivery_id\": \"dlv_" + std::to_string(sequence) + "\", \"order_id\": " +
+                          std::to_string(sequence % 9973) + ", \"event\": \"" + event + "\", \"data\": \"";
+    size_t closing = 2; // the data string's quote and the closing brace
+    if (payload.size() + closing < targetBytes) {
+        payload.append(targetBytes - payload.size() - closing, 'x');
+    }
+    payload += "\"}";
+    return payload;
+}
+
+void waitUntil(std::chrono::steady_clock::time_point deadline) {
+    auto remaining = deadline - std::chrono::steady_clock::now();
+    if (remaining > std::chrono::microseconds(200)) {
+        std::this_thread::sleep_for(remaining - std::chrono::microseconds(100));
+    }
+    while (std::chrono::steady_clock::now() < deadline) {
+    }
+}
+
+} // namespace
+
+WebhookTrace WebhookTrace::synthesize(const TraceProfile& profile, size_t count) {
+    WebhookTrace trace;
+    trace.traceEvents.reserve(count);
+    if (profile.eventMix.empty() || profile.eventsPerSecond <= 0) {
+        return trace;
+    }
+
+    std::mt19937_64 random(profile.seed);
+    std::vector<double> weights;
+    for (const EventShare& share : profile.eventMix) {
+        weights.push_back(share.weight);
+    }
+    std::discrete_distribution<size_t> pickEvent(weights.begin(), weights.end());
+    std::lognormal_distribution<double> pickSize(std::log(static_cast<double>(profile.medianPayloadBytes ? profile.medianPayloadBytes : 1)),
+                                                 profile.payloadSizeSpread);
+
+    // Arrivals are Poisson at burstFactor times the mean rate, but only during
+    // the first 1/burstFactor of every burst period, which keeps the mean rate
+    const double burstFactor = std::max(1.0, profile.burstFactor);
+    std::exponential_distribution<double> pickGap(profile.eventsPerSecond * burstFactor);
+    const double periodSeconds = std::chrono::duration<double>(profile.burstPeriod).count();
+    const double activeSeconds = periodSeconds / burstFactor;
+
+    double activeTime = 0;
+    for (size_t i = 0; i < count; ++i) {
+        activeTime += pickGap(random);
+        double wallTime = activeTime;
+        if (burstFactor > 1 && activeSeconds > 0) {
+            double periods = std::floor(activeTime / activeSeconds);
+            wallTime = periods * periodSeconds + (activeTime - periods * activeSeconds);
+        }
+        const std::string& event = profile.eventMix[pickEvent(random)].event;
+        size_t bytes = std::min(profile.maxPayloadBytes, static_cast<size_t>(pickSize(random)));
+        trace.traceEvents.push_back(TraceEvent{std::chrono::nanoseconds(static_cast<int64_t>(wallTime * 1e9)), event,
+                                               makeSyntheticPayload(event, i, bytes)});
+    }
+    return trace;
+}
+
+// Format: a header line, then per event "<offset ns> <event> <payload bytes>\n"
+// followed by the raw payload and a newline
+bool WebhookTrace::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    out << traceHeader << '\n';
+    for (const TraceEvent& event : traceEvents) {
+        out << event.offset.count() << ' ' << event.event << ' ' << event.payload.size() << '\n';
+        out.write(event.payload.data(), static_cast<std::streamsize>(event.payload.size()));
+        out << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+bool WebhookTrace::load(const std::string& path, WebhookTrace& trace) {
+    std::ifstream in(path, std::ios::binary);
+    std::string header;
+    if (!std::getline(in, header) || header != traceHeader) {
+        return false;
+    }
+    WebhookTrace loaded;
+    int64_t offset = 0;
+    std::string event;
+    size_t bytes = 0;
+    while (in >> offset >> event >> bytes) {
+        in.get(); // newline before the payload
+        std::string payload(bytes, '\0');
+        if (!in.read(&payload[0], static_cast<std::streamsize>(bytes))) {
+            return false;
+        }
+        in.get();
+        loaded.append(TraceEvent{std::chrono::nanoseconds(offset), event, std::move(payload)});
+    }
+    if (!in.eof()) {
+        return false;
+    }
+    trace = std::move(loaded);
+    return true;
+}
+
+DispatchResult TraceRecorder::operator()(std::string_view event, const Payload& payload) {
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        auto now = std::chrono::steady_clock::now();
+        if (recorded.size() == 0) {
+            start = now;
+        }
+        recorded.append(TraceEvent{now - start, std::string(event), payload});
+    }
+    return target ? target(event, payload) : DispatchResult::Handled;
+}
+
+WebhookTrace TraceRecorder::trace() const {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    return recorded;
+}
+
+std::string ReplayReport::toText() const {
+    std::ostringstream out;
+    out << events << " events in " << seconds << " s: " << static_cast<long>(eventsPerSecond) << " events/s, latency p50 "
+        << p50Ns / 1000.0 << " us, p99 " << p99Ns / 1000.0 << " us, p999 " << p999Ns / 1000.0 << " us, max "
+        << maxNs / 1000.0 << " us";
+    if (notHandled > 0) {
+        out << ", " << notHandled << " not handled";
+    }
+    if (allocationsPerEvent >= 0) {
+        out << ", " << allocationsPerEvent << " allocations/event";
+    }
+    return out.str();
+}
+
+std::string ReplayReport::toJson() const {
+    std::ostringstream out;
+    out << "{\"events\": " << events << ", \"handled\": " << handled << ", \"not_handled\": " << notHandled
+        << ", \"seconds\": " << seconds << ", \"events_per_second\": " << eventsPerSecond << ", \"p50_ns\": " << p50Ns
+        << ", \"p99_ns\": " << p99Ns << ", \"p999_ns\": " << p999Ns << ", \"max_ns\": " << maxNs;
+    if (allocationsPerEvent >= 0) {
+        out << ", \"allocations_per_event\": " << allocationsPerEvent;
+    }
+    out << "}";
+    return out.str();
+}
+
+ReplayReport replayTrace(const WebhookTrace& trace, const ReplayTarget& target, const ReplayOptions& options) {
+    using Clock = std::chrono::steady_clock;
+    const size_t threadCount = std::max<size_t>(options.threads, 1);
+    const std::vector<TraceEvent>& events = trace.events();
+
+    // Everything the replay threads touch is allocated up front, so the
+    // allocation count only sees what the target does
+    std::vector<LatencyHistogram> latencies(threadCount);
+    std::vector<size_t> handled(threadCount, 0);
+    std::atomic<bool> go{false};
+    std::atomic<size_t> ready{0};
+    Clock::time_point start;
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            LatencyHistogram& histogram = latencies[t];
+            size_t handledHere = 0;
+            for (size_t i = t; i < events.size(); i += threadCount) {
+                const TraceEvent& event = events[i];
+                Clock::time_point sentAt;
+                if (options.speed > 0) {
+                    sentAt = start + std::chrono::duration_cast<Clock::duration>(event.offset / options.speed);
+                    waitUntil(sentAt);
+                } else {
+                    sentAt = Clock::now();
+                }
+                handledHere += target(event.event, event.payload) == DispatchResult::Handled;
+                histogram.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sentAt).count()));
+            }
+            handled[t] = handledHere;
+        });
+    }
+    while (ready.load() < threadCount) {
+        std::this_thread::yield();
+    }
+
+    size_t allocationsBefore = options.allocationCounter ? options.allocationCounter->load() : 0;
+    start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t allocations = options.allocationCounter ? options.allocationCounter->load() - allocationsBefore : 0;
+
+    LatencyHistogram merged;
+    ReplayReport report;
+    for (size_t t = 0; t < threadCount; ++t) {
+        merged.merge(latencies[t]);
+        report.handled += handled[t];
+    }
+    report.events = events.size();
+    report.notHandled = report.events - report.handled;
+    report.seconds = seconds;
+    report.eventsPerSecond = seconds > 0 ? report.events / seconds : 0;
+    report.p50Ns = merged.percentile(0.5);
+    report.p99Ns = merged.percentile(0.99);
+    report.p999Ns = merged.percentile(0.999);
+    report.maxNs = merged.max();
+    if (options.allocationCounter && report.events > 0) {
+        report.allocationsPerEvent = static_cast<double>(allocations) / report.events;
+    }
+    return report;
+}
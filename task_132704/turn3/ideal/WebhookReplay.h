@@ -0,0 +1,108 @@
+#ifndef WEBHOOKREPLAY_H
+#define WEBHOOKREPLAY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Payload.h"
+#include "WebhookDispatcher.h"
+
+struct EventShare {
+    std::string event;
+    double weight;
+};
+
+// Shape of a synthetic webhook trace
+struct TraceProfile {
+    std::vector<EventShare> eventMix = {{"order_placed", 6}, {"payment_received", 3}, {"refund_issued", 1}};
+    double eventsPerSecond = 50000;        // mean arrival rate
+    double burstFactor = 1;                // > 1 packs arrivals into bursts this much denser than the mean
+    std::chrono::milliseconds burstPeriod{100};
+    size_t medianPayloadBytes = 256;       // payload sizes are log-normal around this median
+    double payloadSizeSpread = 0.6;        // sigma of the log-normal
+    size_t maxPayloadBytes = 64 * 1024;
+    uint64_t seed = 42;
+};
+
+struct TraceEvent {
+    std::chrono::nanoseconds offset; // arrival time relative to the start of the trace
+    std::string event;
+    Payload payload;
+};
+
+// An ordered sequence of webhooks with their arrival times, either synthesised
+// from a profile or recorded from live traffic, that can be saved and replayed
+class WebhookTrace {
+public:
+    static WebhookTrace synthesize(const TraceProfile& profile, size_t count);
+
+    // Returns false when the file cannot be read or is not a trace
+    static bool load(const std::string& path, WebhookTrace& trace);
+    bool save(const std::string& path) const;
+
+    void append(TraceEvent event) { traceEvents.push_back(std::move(event)); }
+
+    const std::vector<TraceEvent>& events() const { return traceEvents; }
+    size_t size() const { return traceEvents.size(); }
+    std::chrono::nanoseconds duration() const {
+        return traceEvents.empty() ? std::chrono::nanoseconds(0) : traceEvents.back().offset;
+    }
+
+private:
+    std::vector<TraceEvent> traceEvents;
+};
+
+using ReplayTarget = std::function<DispatchResult(std::string_view event, const Payload& payload)>;
+
+// Captures the webhooks passing through it into a trace, e.g. as the sink of
+// a WebhookHttpServer in front of the real dispatcher
+class TraceRecorder {
+public:
+    explicit TraceRecorder(ReplayTarget target) : target(std::move(target)) {}
+
+    DispatchResult operator()(std::string_view event, const Payload& payload);
+
+    WebhookTrace trace() const;
+
+private:
+    ReplayTarget target;
+    mutable std::mutex traceMutex;
+    WebhookTrace recorded;
+    std::chrono::steady_clock::time_point start;
+};
+
+struct ReplayOptions {
+    double speed = 0;   // multiplier on the trace's timing; 0 replays as fast as possible
+    size_t threads = 1; // event i is replayed by thread i % threads
+    // Running count of operator new calls, when the program provides one
+    const std::atomic<size_t>* allocationCounter = nullptr;
+};
+
+struct ReplayReport {
+    size_t events = 0;
+    size_t handled = 0;
+    size_t notHandled = 0;  // NoHandler, Duplicate or Rejected
+    double seconds = 0;
+    double eventsPerSecond = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t p999Ns = 0;
+    uint64_t maxNs = 0;
+    double allocationsPerEvent = -1; // negative when no allocation counter was given
+
+    std::string toText() const;
+    std::string toJson() const;
+};
+
+// Replays `trace` into `target`. Paced replays measure latency from each
+// event's scheduled arrival rather than from when it was actually sent, so a
+// stalled target is charged for the events queued up behind it.
+ReplayReport replayTrace(const WebhookTrace& trace, const ReplayTarget& target, const ReplayOptions& options = ReplayOptions());
+
+#endif // WEBHOOKREPLAY_H
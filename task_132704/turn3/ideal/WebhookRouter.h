@@ -0,0 +1,194 @@
+#ifndef WEBHOOKROUTER_H
+#define WEBHOOKROUTER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Routing table from webhook event type to Value.
+//
+// Routes registered before compile() are folded into a perfect-hash table: one
+// seeded hash picks exactly one slot per key and a lookup confirms it with a
+// length check followed by memcmp, so a hit costs one hash and one compare.
+// Routes added after compile(), and any key the perfect hash cannot place, go
+// to a small linear-probing fallback table that is only consulted on a miss.
+template <typename Value>
+class WebhookRouter {
+public:
+    void registerRoute(const std::string& event, Value value) {
+        if (Slot* slot = findSlot(table, event, seed)) {
+            slot->value = std::move(value);
+            return;
+        }
+        insertFallback(event, std::move(value));
+    }
+
+    // Rebuilds the perfect-hash table from every route known so far.
+    void compile() {
+        std::vector<Slot> routes;
+        collect(table, routes);
+        collect(fallback, routes);
+        table.clear();
+        fallback.clear();
+        fallbackCount = 0;
+        if (routes.empty()) {
+            return;
+        }
+
+        size_t bestSize = 0;
+        uint64_t bestSeed = 0;
+        size_t bestPlaced = 0;
+        std::vector<uint8_t> used;
+        for (size_t size = tableSizeFor(routes.size()); size <= tableSizeFor(routes.size()) * 4 && bestPlaced < routes.size(); size *= 2) {
+            for (uint64_t candidate = 1; candidate <= maxSeedAttempts; ++candidate) {
+                used.assign(size, 0);
+                size_t placed = 0;
+                for (const Slot& route : routes) {
+                    uint8_t& mark = used[hash(route.key, candidate) & (size - 1)];
+                    placed += mark == 0;
+                    mark = 1;
+                }
+                if (placed > bestPlaced) {
+                    bestPlaced = placed;
+                    bestSeed = candidate;
+                    bestSize = size;
+                }
+                if (placed == routes.size()) {
+                    break;
+                }
+            }
+        }
+
+        seed = bestSeed;
+        table.resize(bestSize);
+        for (Slot& route : routes) {
+            Slot& slot = table[hash(route.key, seed) & (bestSize - 1)];
+            if (!slot.occupied) {
+                slot = std::move(route);
+            } else {
+                insertFallback(route.key, std::move(route.value));
+            }
+        }
+    }
+
+    const Value* find(std::string_view event) const {
+        if (const Slot* slot = findSlot(table, event, seed)) {
+            return &slot->value;
+        }
+        if (fallbackCount == 0) {
+            return nullptr;
+        }
+        const Slot* slot = findSlot(fallback, event, 0);
+        return slot ? &slot->value : nullptr;
+    }
+
+    size_t compiledRoutes() const { return countOccupied(table); }
+    size_t fallbackRoutes() const { return fallbackCount; }
+
+private:
+    struct Slot {
+        std::string key;
+        Value value{};
+        bool occupied = false;
+    };
+
+    static constexpr uint64_t maxSeedAttempts = 256;
+
+    // Mixes the length with the first and last eight bytes of the key. Webhook
+    // event names are short identifiers that differ at one of the two ends.
+    static uint64_t hash(std::string_view key, uint64_t seed) {
+        const size_t n = key.size();
+        uint64_t head = 0;
+        uint64_t tail = 0;
+        std::memcpy(&head, key.data(), n < 8 ? n : 8);
+        if (n > 8) {
+            std::memcpy(&tail, key.data() + n - 8, 8);
+        }
+        uint64_t h = (head ^ seed) * 0x9E3779B97F4A7C15ull;
+        h ^= (tail ^ (static_cast<uint64_t>(n) << 56)) * 0xC2B2AE3D27D4EB4Full;
+        return h ^ (h >> 32);
+    }
+
+    static size_t tableSizeFor(size_t routes) {
+        size_t size = 1;
+        while (size < routes * 2) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    static bool matches(const Slot& slot, std::string_view event) {
+        return slot.occupied && slot.key.size() == event.size() &&
+               std::memcmp(slot.key.data(), event.data(), event.size()) == 0;
+    }
+
+    // Perfect-hash tables are probed once; the fallback (seed 0) probes linearly.
+    template <typename Table>
+    static auto findSlot(Table& slots, std::string_view event, uint64_t slotSeed) -> decltype(&slots[0]) {
+        if (slots.empty()) {
+            return nullptr;
+        }
+        const size_t mask = slots.size() - 1;
+        size_t index = hash(event, slotSeed) & mask;
+        if (slotSeed != 0) {
+            return matches(slots[index], event) ? &slots[index] : nullptr;
+        }
+        while (slots[index].occupied) {
+            if (matches(slots[index], event)) {
+                return &slots[index];
+            }
+            index = (index + 1) & mask;
+        }
+        return nullptr;
+    }
+
+    void insertFallback(const std::string& event, Value value) {
+        if (Slot* slot = findSlot(fallback, event, 0)) {
+            slot->value = std::move(value);
+            return;
+        }
+        if ((fallbackCount + 1) * 2 > fallback.size()) {
+            std::vector<Slot> old;
+            old.swap(fallback);
+            fallback.resize(old.empty() ? 8 : old.size() * 2);
+            fallbackCount = 0;
+            for (Slot& slot : old) {
+                if (slot.occupied) {
+                    insertFallback(slot.key, std::move(slot.value));
+                }
+            }
+        }
+        size_t index = hash(event, 0) & (fallback.size() - 1);
+        while (fallback[index].occupied) {
+            index = (index + 1) & (fallback.size() - 1);
+        }
+        fallback[index] = Slot{event, std::move(value), true};
+        ++fallbackCount;
+    }
+
+    static void collect(std::vector<Slot>& slots, std::vector<Slot>& out) {
+        for (Slot& slot : slots) {
+            if (slot.occupied) {
+                out.push_back(std::move(slot));
+            }
+        }
+    }
+
+    static size_t countOccupied(const std::vector<Slot>& slots) {
+        size_t count = 0;
+        for (const Slot& slot : slots) {
+            count += slot.occupied;
+        }
+        return count;
+    }
+
+    std::vector<Slot> table;
+    uint64_t seed = 0;
+    std::vector<Slot> fallback;
+    size_t fallbackCount = 0;
+};
+
+#endif // WEBHOOKROUTER_H
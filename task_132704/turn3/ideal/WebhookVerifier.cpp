@@ -0,0 +1,93 @@
+#include "WebhookVerifier.h"
+
+#include <algorithm>
+
+WebhookVerifier::WebhookVerifier(size_t workerCount) {
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&WebhookVerifier::runWorker, this);
+    }
+}
+
+WebhookVerifier::~WebhookVerifier() {
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        stop = true;
+    }
+    workCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WebhookVerifier::registerProvider(const std::string& provider, std::string_view secret) {
+    std::lock_guard<std::mutex> lock(batchMutex);
+    if (const size_t* index = providers.find(provider)) {
+        keys[*index] = HmacSha256(secret);
+        return;
+    }
+    providers.registerRoute(provider, keys.size());
+    keys.emplace_back(secret);
+    providers.compile();
+}
+
+bool WebhookVerifier::verify(const SignedWebhook& webhook) const {
+    const size_t* index = providers.find(webhook.provider);
+    return index && keys[*index].verify(webhook.payload.view(), webhook.signature);
+}
+
+void WebhookVerifier::verifyBatch(const SignedWebhook* batch, size_t count, uint8_t* valid) {
+    std::lock_guard<std::mutex> batchLock(batchMutex);
+    if (workers.empty() || count <= chunkSize) {
+        for (size_t i = 0; i < count; ++i) {
+            valid[i] = verify(batch[i]);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(workMutex);
+        this->batch = batch;
+        this->valid = valid;
+        batchSize = count;
+        nextIndex.store(0, std::memory_order_relaxed);
+        busyWorkers = workers.size();
+        ++generation;
+    }
+    workCondition.notify_all();
+    verifyChunks();
+
+    std::unique_lock<std::mutex> lock(workMutex);
+    doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+// Claims chunks of the current batch until none are left
+void WebhookVerifier::verifyChunks() {
+    for (;;) {
+        size_t begin = nextIndex.fetch_add(chunkSize, std::memory_order_relaxed);
+        if (begin >= batchSize) {
+            return;
+        }
+        size_t end = std::min(begin + chunkSize, batchSize);
+        for (size_t i = begin; i < end; ++i) {
+            valid[i] = verify(batch[i]);
+        }
+    }
+}
+
+void WebhookVerifier::runWorker() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(workMutex);
+    for (;;) {
+        workCondition.wait(lock, [&] { return stop || generation != seen; });
+        if (stop) {
+            return;
+        }
+        seen = generation;
+        lock.unlock();
+        verifyChunks();
+        lock.lock();
+        if (--busyWorkers == 0) {
+            doneCondition.notify_one();
+        }
+    }
+}
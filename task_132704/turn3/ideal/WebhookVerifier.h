@@ -0,0 +1,85 @@
+#ifndef WEBHOOKVERIFIER_H
+#define WEBHOOKVERIFIER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Payload.h"
+#include "Sha256.h"
+#include "WebhookDispatcher.h"
+#include "WebhookRouter.h"
+
+struct SignedWebhook {
+    std::string_view provider;  // whose secret signed the payload
+    std::string_view event;
+    Payload payload;
+    std::string_view signature; // hex HMAC-SHA256 of the payload, optionally prefixed "sha256="
+};
+
+// Signature check in front of the dispatcher. Each provider's HMAC key
+// schedule is computed once at registration, and batches are verified on a
+// pool of worker threads together with the calling thread, so a forged or
+// corrupted webhook is rejected before any handler sees it.
+class WebhookVerifier {
+public:
+    // workerCount extra threads share each batch with the caller; 0 verifies on the caller only
+    explicit WebhookVerifier(size_t workerCount = 0);
+    ~WebhookVerifier();
+
+    WebhookVerifier(const WebhookVerifier&) = delete;
+    WebhookVerifier& operator=(const WebhookVerifier&) = delete;
+
+    // Providers must be registered before webhooks start flowing
+    void registerProvider(const std::string& provider, std::string_view secret);
+
+    // False for an unknown provider or a signature that does not match
+    bool verify(const SignedWebhook& webhook) const;
+
+    // Sets valid[i] for each of the `count` webhooks. One batch runs at a time.
+    void verifyBatch(const SignedWebhook* batch, size_t count, uint8_t* valid);
+
+    // Verifies the batch, then hands the valid webhooks to `dispatch` in order.
+    // results[i] is the dispatch result, or Unauthorized for a bad signature.
+    template <typename Dispatch>
+    void dispatchBatch(const std::vector<SignedWebhook>& batch, Dispatch&& dispatch, std::vector<DispatchResult>& results) {
+        validScratch.resize(batch.size());
+        verifyBatch(batch.data(), batch.size(), validScratch.data());
+        results.resize(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            results[i] = validScratch[i] ? dispatch(batch[i].event, batch[i].payload) : DispatchResult::Unauthorized;
+        }
+    }
+
+    size_t getWorkerCount() const { return workers.size(); }
+
+private:
+    static constexpr size_t chunkSize = 16;
+
+    void runWorker();
+    void verifyChunks();
+
+    std::vector<HmacSha256> keys;
+    WebhookRouter<size_t> providers;
+
+    std::mutex batchMutex; // one batch at a time
+    std::mutex workMutex;
+    std::condition_variable workCondition;
+    std::condition_variable doneCondition;
+    const SignedWebhook* batch = nullptr;
+    uint8_t* valid = nullptr;
+    size_t batchSize = 0;
+    std::atomic<size_t> nextIndex{0};
+    uint64_t generation = 0;
+    size_t busyWorkers = 0;
+    bool stop = false;
+    std::vector<uint8_t> validScratch;
+    std::vector<std::thread> workers;
+};
+
+#endif // WEBHOOKVERIFIER_H
@@ -0,0 +1,1795 @@
+#include "AllocationCounter.h"
+#include "WebhookDispatcher.h"
+#include "WebhookHandlerFactory.h"
+#include "ShardedWebhookDispatcher.h"
+#include "BatchingWebhookDispatcher.h"
+#include "AsyncWebhookResponse.h"
+#include "PriorityWebhookDispatcher.h"
+#include "WebhookHttpServer.h"
+#include "WebhookReplay.h"
+#include "WebhookVerifier.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Handler with per-webhook state, recycled through the factory's pool
+class AuditWebhookHandler : public WebhookHandler {
+public:
+    void handleWebhook(const Payload& payload) override { bytesSeen += payload.size(); }
+    void reset() override { bytesSeen = 0; }
+
+private:
+    size_t bytesSeen = 0;
+};
+
+class ChecksumWebhookHandler : public WebhookHandler {
+public:
+    void handleWebhook(const Payload& payload) override {
+        for (char c : payload.view()) {
+            checksum = checksum * 31 + static_cast<unsigned char>(c);
+        }
+    }
+
+private:
+    std::atomic<size_t> checksum{0};
+};
+
+// Times `lookup` over the event mix and returns nanoseconds per lookup.
+template <typename Lookup>
+double timeLookups(const std::vector<std::string>& events, int rounds, Lookup lookup) {
+    size_t hits = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (const std::string& event : events) {
+            hits += lookup(event);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    volatile size_t sink = hits;
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (static_cast<double>(rounds) * events.size());
+}
+
+void benchmarkRouting() {
+    const std::vector<std::string> eventTypes = {
+        "order", "payment", "order_placed", "payment_received", "order_cancelled",
+        "payment_refunded", "customer_created", "customer_updated", "invoice_paid", "shipment_dispatched",
+    };
+
+    std::map<std::string, int> orderedMap;
+    std::unordered_map<std::string, int> hashMap;
+    WebhookRouter<int> router;
+    for (size_t i = 0; i < eventTypes.size(); ++i) {
+        orderedMap[eventTypes[i]] = static_cast<int>(i);
+        hashMap[eventTypes[i]] = static_cast<int>(i);
+        router.registerRoute(eventTypes[i], static_cast<int>(i));
+    }
+    router.compile();
+
+    // Mostly hits with a few unknown events, like real webhook traffic
+    std::vector<std::string> traffic;
+    for (int i = 0; i < 1024; ++i) {
+        traffic.push_back(i % 16 == 15 ? "unknown_event" : eventTypes[(i * 7) % eventTypes.size()]);
+    }
+
+    const int rounds = 2000;
+    double mapNs = timeLookups(traffic, rounds, [&](const std::string& e) { return orderedMap.find(e) != orderedMap.end(); });
+    double hashNs = timeLookups(traffic, rounds, [&](const std::string& e) { return hashMap.find(e) != hashMap.end(); });
+    double routerNs = timeLookups(traffic, rounds, [&](const std::string& e) { return router.find(e) != nullptr; });
+
+    std::cout << "Routing lookup (" << router.compiledRoutes() << " compiled, " << router.fallbackRoutes() << " fallback routes):\n"
+              << "  std::map           " << mapNs << " ns/lookup\n"
+              << "  std::unordered_map " << hashNs << " ns/lookup\n"
+              << "  WebhookRouter      " << routerNs << " ns/lookup\n";
+}
+
+// Simulates a CPU-bound handler and checks that each order's events arrive in sequence
+class SequencedWebhookHandler : public WebhookHandler {
+public:
+    explicit SequencedWebhookHandler(size_t orders) : lastSequence(orders, -1), orderMutexes(orders) {}
+
+    void handleWebhook(const Payload& payload) override {
+        size_t order = std::stoul(std::string(extractJsonField(payload.view(), "order_id")));
+        long sequence = std::stol(std::string(extractJsonField(payload.view(), "seq")));
+
+        volatile double work = 0;
+        for (int i = 0; i < 2000; ++i) {
+            work = work + i * 0.5;
+        }
+
+        std::lock_guard<std::mutex> lock(orderMutexes[order]);
+        if (sequence <= lastSequence[order]) {
+            outOfOrder.fetch_add(1);
+        }
+        lastSequence[order] = sequence;
+    }
+
+    std::atomic<size_t> outOfOrder{0};
+
+private:
+    std::vector<long> lastSequence;
+    std::vector<std::mutex> orderMutexes;
+};
+
+void benchmarkShardedDispatch() {
+    const size_t orders = 512;
+    const size_t eventsPerOrder = 200;
+    std::vector<Payload> payloads;
+    for (size_t seq = 0; seq < eventsPerOrder; ++seq) {
+        for (size_t order = 0; order < orders; ++order) {
+            payloads.push_back("{\"order_id\": " + std::to_string(order) + ", \"seq\": " + std::to_string(seq) + "}");
+        }
+    }
+
+    const size_t maxShards = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::cout << "Sharded dispatch throughput (" << payloads.size() << " events, " << maxShards << " hardware threads):\n";
+    double baseline = 0;
+    for (size_t shards = 1; shards <= std::max<size_t>(maxShards, 4); shards *= 2) {
+        ShardedWebhookDispatcher dispatcher(shards);
+        auto handler = std::make_unique<SequencedWebhookHandler>(orders);
+        SequencedWebhookHandler* sequenced = handler.get();
+        dispatcher.registerHandler("order_updated", std::move(handler));
+        dispatcher.compileRoutes();
+
+        size_t peakDepth = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < payloads.size(); ++i) {
+            dispatcher.handleWebhook("order_updated", payloads[i]);
+            if (i % 4096 == 0) {
+                for (size_t shard = 0; shard < shards; ++shard) {
+                    peakDepth = std::max(peakDepth, dispatcher.queueDepth(shard));
+                }
+            }
+        }
+        dispatcher.drain();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        double eventsPerSecond = payloads.size() / seconds;
+        if (shards == 1) {
+            baseline = eventsPerSecond;
+        }
+        std::cout << "  " << shards << " shards: " << static_cast<long>(eventsPerSecond) << " events/s, speedup "
+                  << eventsPerSecond / baseline << "x, peak shard depth " << peakDepth
+                  << ", out-of-order " << sequenced->outOfOrder.load() << "\n";
+    }
+}
+
+// Handler that rejects every payload carrying "fail"
+class FailingWebhookHandler : public WebhookHandler {
+public:
+    void handleWebhook(const Payload& payload) override {
+        if (payload.view().find("fail") != std::string_view::npos) {
+            throw std::runtime_error("rejected " + std::string(payload.view()));
+        }
+        handled.fetch_add(1);
+    }
+
+    std::atomic<size_t> handled{0};
+};
+
+// A throwing handler must not take down its shard: the shard counts the
+// failure, keeps handling the queue behind it, and drain() still returns
+bool checkShardedHandlerFailure() {
+    ShardedWebhookDispatcher dispatcher(2);
+    auto handler = std::make_unique<FailingWebhookHandler>();
+    FailingWebhookHandler* failing = handler.get();
+    dispatcher.registerHandler("order_updated", std::move(handler));
+    dispatcher.compileRoutes();
+    for (int order = 0; order < 100; ++order) {
+        const char* outcome = order % 25 == 0 ? "fail" : "ok";
+        dispatcher.handleWebhook("order_updated", "{\"order_id\": " + std::to_string(order) + ", \"outcome\": \"" + outcome + "\"}");
+    }
+    dispatcher.drain();
+    bool ok = dispatcher.failedWebhooks() == 4 && failing->handled.load() == 96;
+    std::cout << "  throwing handler: " << dispatcher.failedWebhooks() << " failed, " << failing->handled.load()
+              << " handled, " << (ok ? "ok" : "WRONG") << "\n";
+    return ok;
+}
+
+// Response strategy that keeps the payload for later delivery, as an async sender would
+class RetainingWebhookResponse : public WebhookResponseStrategy {
+public:
+    void sendResponse(const std::string& url, const Payload& payload) override { lastPayload = payload; }
+    Payload lastPayload;
+};
+
+// Builds an HTTP request carrying a payment batch of roughly `bodySize` bytes
+std::string makePaymentBatchRequest(size_t bodySize) {
+    std::string body = "{\"batch_id\": 42, \"payments\": [";
+    for (int i = 0; body.size() < bodySize; ++i) {
+        body += "{\"payment_id\": " + std::to_string(i) + ", \"amount\": 1999, \"currency\": \"EUR\"},";
+    }
+    body.back() = ']';
+    body += "}";
+    return "POST /webhooks/payment_batch HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+void benchmarkPayloadCopies() {
+    const std::string request = makePaymentBatchRequest(300 * 1024);
+    const size_t bodyOffset = request.find("\r\n\r\n") + 4;
+    const int webhooks = 500;
+
+    // Old pipeline: the body is copied out of the socket buffer, again into the
+    // dispatch queue, and once more by the response strategy
+    size_t copiedBytes = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < webhooks; ++i) {
+        std::string receiveBuffer = request;
+        std::string body = receiveBuffer.substr(bodyOffset);
+        std::string queued = body;
+        std::string retained = queued;
+        copiedBytes += retained.size();
+    }
+    double copyUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() / webhooks;
+
+    auto strategy = std::make_unique<RetainingWebhookResponse>();
+    RetainingWebhookResponse* retaining = strategy.get();
+    WebhookDispatcher dispatcher;
+    dispatcher.registerHandler("payment_batch", std::make_unique<ServiceAWebhookHandler>(std::move(strategy)));
+    dispatcher.compileRoutes();
+
+    std::cout.setstate(std::ios::failbit); // silence the per-webhook response log
+    bool zeroCopy = true;
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < webhooks; ++i) {
+        Payload receiveBuffer = std::string(request); // stands in for the bytes read off the socket
+        Payload body = receiveBuffer.slice(bodyOffset);
+        dispatcher.handleWebhook("payment_batch", body);
+        zeroCopy = zeroCopy && retaining->lastPayload.sharesBufferWith(receiveBuffer) &&
+                   retaining->lastPayload.data() == receiveBuffer.data() + bodyOffset;
+    }
+    double sliceUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() / webhooks;
+    std::cout.clear();
+
+    std::cout << "Payment batch pipeline (" << request.size() - bodyOffset << " byte body):\n"
+              << "  std::string copies " << copyUs << " us/webhook (" << copiedBytes / webhooks << " bytes retained)\n"
+              << "  Payload slices     " << sliceUs << " us/webhook, zero-copy " << (zeroCopy ? "yes" : "no") << "\n";
+}
+
+// Minimal DOM parser used as the full-parse baseline for JsonFieldScanner
+struct JsonValue {
+    std::string text; // string contents or scalar spelling
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+};
+
+class JsonDomParser {
+public:
+    explicit JsonDomParser(std::string_view json) : json(json) {}
+
+    JsonValue parse() {
+        JsonValue value;
+        parseValue(value);
+        return value;
+    }
+
+private:
+    void skipWhitespace() {
+        while (pos < json.size() && std::isspace(static_cast<unsigned char>(json[pos]))) {
+            ++pos;
+        }
+    }
+
+    std::string parseString() {
+        std::string out;
+        for (++pos; pos < json.size() && json[pos] != '"'; ++pos) {
+            if (json[pos] == '\\' && pos + 1 < json.size()) {
+                ++pos;
+            }
+            out += json[pos];
+        }
+        ++pos;
+        return out;
+    }
+
+    void parseValue(JsonValue& value) {
+        skipWhitespace();
+        if (pos >= json.size()) {
+            return;
+        }
+        if (json[pos] == '{') {
+            for (++pos;;) {
+                skipWhitespace();
+                if (pos >= json.size() || json[pos] == '}') {
+                    ++pos;
+                    return;
+                }
+                if (json[pos] == ',') {
+                    ++pos;
+                    continue;
+                }
+                std::string key = parseString();
+                skipWhitespace();
+                ++pos; // ':'
+                value.members.emplace_back(std::move(key), JsonValue());
+                parseValue(value.members.back().second);
+            }
+        } else if (json[pos] == '[') {
+            for (++pos;;) {
+                skipWhitespace();
+                if (pos >= json.size() || json[pos] == ']') {
+                    ++pos;
+                    return;
+                }
+                if (json[pos] == ',') {
+                    ++pos;
+                    continue;
+                }
+                value.items.emplace_back();
+                parseValue(value.items.back());
+            }
+        } else if (json[pos] == '"') {
+            value.text = parseString();
+        } else {
+            size_t start = pos;
+            while (pos < json.size() && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' &&
+                   !std::isspace(static_cast<unsigned char>(json[pos]))) {
+                ++pos;
+            }
+            value.text = std::string(json.substr(start, pos - start));
+        }
+    }
+
+    std::string_view json;
+    size_t pos = 0;
+};
+
+// Synthesises provider-style payloads: small order events, payments with nested
+// decoy keys, and payment batches whose routing keys trail a large array
+std::vector<Payload> makeWebhookCorpus(size_t count) {
+    std::mt19937 rng(7);
+    std::vector<Payload> corpus;
+    for (size_t i = 0; i < count; ++i) {
+        std::string id = std::to_string(rng() % 100000);
+        std::string delivery = "\"dlv_" + std::to_string(rng()) + "\"";
+        std::string json;
+        switch (i % 3) {
+        case 0:
+            json = "{\"event\": \"order_placed\", \"order_id\": " + id + ", \"delivery_id\": " + delivery +
+                   ", \"amount\": 2599, \"currency\": \"EUR\"}";
+            break;
+        case 1:
+            json = "{\"event\": \"payment_received\", \"customer\": {\"id\": 17, \"order_id\": 999, "
+                   "\"name\": \"Ann \\\"Quote\\\" O'Neil\", \"tags\": [\"vip\", \"{not json}\"]}, \"items\": [";
+            for (int item = 0; item < 8; ++item) {
+                json += "{\"sku\": \"SKU-" + std::to_string(item) + "\", \"qty\": 2, \"price\": 1299},";
+            }
+            json.back() = ']';
+            json += ", \"order_id\": " + id + ", \"delivery_id\": " + delivery + "}";
+            break;
+        default:
+            json = "{\"event\": \"payment_batch\", \"payments\": [";
+            for (int payment = 0; payment < 150; ++payment) {
+                json += "{\"payment_id\": " + std::to_string(payment) + ", \"amount\": 1999, \"note\": \"refund, partial\"},";
+            }
+            json.back() = ']';
+            json += ", \"order_id\": " + id + ", \"delivery_id\": " + delivery + "}";
+            break;
+        }
+        corpus.emplace_back(std::move(json));
+    }
+    return corpus;
+}
+
+bool benchmarkFieldScanner() {
+    const std::vector<Payload> corpus = makeWebhookCorpus(3000);
+    const std::vector<std::string> keys = {"event", "order_id", "delivery_id"};
+    size_t corpusBytes = 0;
+    for (const Payload& payload : corpus) {
+        corpusBytes += payload.size();
+    }
+
+    // The scanner must agree with the full parse on every routing field
+    JsonFieldScanner scanner(keys);
+    JsonFieldScanner scalarScanner(keys, false);
+    size_t mismatches = 0;
+    for (const Payload& payload : corpus) {
+        JsonValue document = JsonDomParser(payload.view()).parse();
+        std::string_view values[3];
+        std::string_view scalarValues[3];
+        scanner.scan(payload.view(), values);
+        scalarScanner.scan(payload.view(), scalarValues);
+        for (size_t k = 0; k < keys.size(); ++k) {
+            std::string expected;
+            for (const auto& member : document.members) {
+                if (member.first == keys[k]) {
+                    expected = member.second.text;
+                }
+            }
+            mismatches += values[k] != expected || scalarValues[k] != expected;
+        }
+    }
+
+    const int rounds = 20;
+    auto timeCorpus = [&](auto extract) {
+        size_t found = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            for (const Payload& payload : corpus) {
+                found += extract(payload);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        volatile size_t sink = found;
+        (void)sink;
+        return corpusBytes * rounds / seconds / 1e6;
+    };
+
+    double domMBs = timeCorpus([&](const Payload& payload) {
+        JsonValue document = JsonDomParser(payload.view()).parse();
+        size_t found = 0;
+        for (const auto& member : document.members) {
+            for (const std::string& key : keys) {
+                found += member.first == key;
+            }
+        }
+        return found;
+    });
+    double scalarMBs = timeCorpus([&](const Payload& payload) {
+        std::string_view values[3];
+        return scalarScanner.scan(payload.view(), values);
+    });
+    double simdMBs = timeCorpus([&](const Payload& payload) {
+        std::string_view values[3];
+        return scanner.scan(payload.view(), values);
+    });
+
+    std::cout << "Routing field extraction (" << corpus.size() << " payloads, " << corpusBytes / 1024 << " KB):\n"
+              << "  full DOM parse  " << domMBs << " MB/s\n"
+              << "  scalar scanner  " << scalarMBs << " MB/s\n"
+              << "  SIMD scanner    " << simdMBs << " MB/s, mismatches " << mismatches << "\n";
+    return mismatches == 0;
+}
+
+// Busy-waits to model a fixed cost that sleeping is too coarse to reproduce
+void spinFor(std::chrono::nanoseconds duration) {
+    auto until = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < until) {
+    }
+}
+
+// Models a handler writing rows to a database: every call pays one round trip,
+// and handleBatch writes the whole batch in a single multi-row statement
+class DatabaseWebhookHandler : public WebhookHandler {
+public:
+    DatabaseWebhookHandler(std::vector<std::chrono::steady_clock::time_point>& enqueuedAt, std::vector<double>& latenciesUs)
+        : enqueuedAt(enqueuedAt), latenciesUs(latenciesUs) {}
+
+    void handleWebhook(const Payload& payload) override {
+        spinFor(roundTrip + perRow);
+        record(payload);
+    }
+
+    void handleBatch(const std::vector<Payload>& payloads) override {
+        spinFor(roundTrip + perRow * payloads.size());
+        for (const Payload& payload : payloads) {
+            record(payload);
+        }
+    }
+
+private:
+    void record(const Payload& payload) {
+        size_t seq = std::stoul(std::string(extractJsonField(payload.view(), "seq")));
+        latenciesUs[seq] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - enqueuedAt[seq]).count();
+    }
+
+    static constexpr std::chrono::nanoseconds roundTrip{20000};
+    static constexpr std::chrono::nanoseconds perRow{300};
+    std::vector<std::chrono::steady_clock::time_point>& enqueuedAt;
+    std::vector<double>& latenciesUs;
+};
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void benchmarkBatching() {
+    const size_t events = 20000;
+    const double offeredPerSecond = 20000;
+    std::vector<Payload> payloads;
+    for (size_t seq = 0; seq < events; ++seq) {
+        payloads.push_back("{\"order_id\": " + std::to_string(seq % 97) + ", \"seq\": " + std::to_string(seq) + "}");
+    }
+
+    std::cout << "Batched handling (20 us round trip + 0.3 us/row, 2 ms max delay):\n";
+    for (size_t batchLimit : {1, 16, 64, 256}) {
+        std::vector<std::chrono::steady_clock::time_point> enqueuedAt(events);
+        std::vector<double> latenciesUs(events);
+
+        // Closed loop: submit everything as fast as possible for peak throughput
+        double throughput = 0;
+        {
+            BatchingWebhookDispatcher dispatcher(BatchPolicy{batchLimit, std::chrono::microseconds(2000)});
+            dispatcher.registerHandler("order_updated", std::make_unique<DatabaseWebhookHandler>(enqueuedAt, latenciesUs));
+            dispatcher.compileRoutes();
+            auto begin = std::chrono::steady_clock::now();
+            for (size_t seq = 0; seq < events; ++seq) {
+                enqueuedAt[seq] = std::chrono::steady_clock::now();
+                dispatcher.handleWebhook("order_updated", payloads[seq]);
+            }
+            dispatcher.flush();
+            throughput = events / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        }
+
+        // Open loop at a fixed offered rate to see the latency batching adds
+        std::string p99 = "overloaded";
+        double p50 = 0;
+        if (throughput > offeredPerSecond * 1.2) {
+            BatchingWebhookDispatcher dispatcher(BatchPolicy{batchLimit, std::chrono::microseconds(2000)});
+            dispatcher.registerHandler("order_updated", std::make_unique<DatabaseWebhookHandler>(enqueuedAt, latenciesUs));
+            dispatcher.compileRoutes();
+            const size_t burst = 50;
+            auto next = std::chrono::steady_clock::now();
+            for (size_t seq = 0; seq < events; ++seq) {
+                if (seq % burst == 0) {
+                    std::this_thread::sleep_until(next);
+                    next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(burst / offeredPerSecond));
+                }
+                enqueuedAt[seq] = std::chrono::steady_clock::now();
+                dispatcher.handleWebhook("order_updated", payloads[seq]);
+            }
+            dispatcher.flush();
+            p50 = percentile(latenciesUs, 0.5);
+            p99 = std::to_string(static_cast<long>(percentile(latenciesUs, 0.99))) + " us";
+        }
+
+        std::cout << "  batch " << batchLimit << ": " << static_cast<long>(throughput) << " events/s peak; at "
+                  << static_cast<long>(offeredPerSecond) << "/s offered p50 " << static_cast<long>(p50) << " us, p99 " << p99 << "\n";
+    }
+}
+
+// A batch whose handler throws is counted as failed; later batches are still
+// delivered and flush() still returns
+bool checkBatchingHandlerFailure() {
+    BatchingWebhookDispatcher dispatcher(BatchPolicy{10, std::chrono::microseconds(1000000)});
+    auto handler = std::make_unique<FailingWebhookHandler>();
+    FailingWebhookHandler* failing = handler.get();
+    dispatcher.registerHandler("order_updated", std::move(handler));
+    dispatcher.compileRoutes();
+    for (int order = 0; order < 50; ++order) {
+        const char* outcome = order == 0 ? "fail" : "ok";
+        dispatcher.handleWebhook("order_updated", "{\"order_id\": " + std::to_string(order) + ", \"outcome\": \"" + outcome + "\"}");
+    }
+    dispatcher.flush();
+    bool ok = dispatcher.failedWebhooks() == 10 && failing->handled.load() == 40;
+    std::cout << "  throwing handler: " << dispatcher.failedWebhooks() << " failed, " << failing->handled.load()
+              << " handled, " << (ok ? "ok" : "WRONG") << "\n";
+    return ok;
+}
+
+// The batching dispatcher reports the same results as the others: unknown
+// events, repeated delivery IDs and webhooks beyond maxQueued are refused,
+// and a failed batch's delivery IDs are accepted again on retry
+bool checkBatchingDispatchResults() {
+    IdempotencyCache cache(1024);
+    BatchingWebhookDispatcher dispatcher(BatchPolicy{10, std::chrono::microseconds(1000000), 20});
+    auto handler = std::make_unique<FailingWebhookHandler>();
+    FailingWebhookHandler* failing = handler.get();
+    dispatcher.registerHandler("order_updated", std::move(handler));
+    dispatcher.compileRoutes();
+    dispatcher.setIdempotencyCache(&cache);
+
+    auto delivery = [](int id, const char* outcome) {
+        return "{\"delivery_id\": \"d" + std::to_string(id) + "\", \"outcome\": \"" + outcome + "\"}";
+    };
+    bool ok = dispatcher.handleWebhook("order_refunded", delivery(0, "ok")) == DispatchResult::NoHandler;
+    // The first batch of ten fails; the second is handled
+    for (int id = 0; id < 20; ++id) {
+        ok = ok && dispatcher.handleWebhook("order_updated", delivery(id, id == 0 ? "fail" : "ok")) == DispatchResult::Handled;
+    }
+    ok = ok && dispatcher.handleWebhook("order_updated", delivery(20, "ok")) == DispatchResult::Rejected;
+    dispatcher.flush();
+    ok = ok && dispatcher.handleWebhook("order_updated", delivery(15, "ok")) == DispatchResult::Duplicate &&
+         dispatcher.handleWebhook("order_updated", delivery(5, "ok")) == DispatchResult::Handled &&
+         dispatcher.handleWebhook("order_updated", delivery(20, "ok")) == DispatchResult::Handled;
+    dispatcher.flush();
+    ok = ok && dispatcher.failedWebhooks() == 10 && failing->handled.load() == 12;
+    std::cout << "  dispatch results: " << (ok ? "ok" : "WRONG") << "\n";
+    return ok;
+}
+
+// Loopback HTTP/1.1 server that acknowledges every request with 200 OK,
+// including pipelined ones, and counts the webhooks it receives
+class LoopbackHttpStub {
+public:
+    LoopbackHttpStub() {
+        listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        ::listen(listenFd, 64);
+        socklen_t length = sizeof(address);
+        ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+        port = ntohs(address.sin_port);
+        acceptThread = std::thread([this] { acceptLoop(); });
+    }
+
+    ~LoopbackHttpStub() {
+        ::shutdown(listenFd, SHUT_RDWR);
+        ::close(listenFd);
+        acceptThread.join();
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        for (int fd : connectionFds) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        for (std::thread& thread : connectionThreads) {
+            thread.join();
+        }
+    }
+
+    std::string url(const std::string& path) const { return "http://127.0.0.1:" + std::to_string(port) + path; }
+
+    std::atomic<size_t> requests{0};
+    std::atomic<size_t> webhooks{0};
+
+private:
+    void acceptLoop() {
+        for (;;) {
+            int fd = ::accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+            int noDelay = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            connectionFds.push_back(fd);
+            connectionThreads.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+
+    void serve(int fd) {
+        static const char reply[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+        std::string buffer;
+        std::string replies;
+        char chunk[65536];
+        for (;;) {
+            ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                break;
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+
+            size_t consumed = 0;
+            for (;;) {
+                size_t headerEnd = buffer.find("\r\n\r\n", consumed);
+                if (headerEnd == std::string::npos) {
+                    break;
+                }
+                std::string headers = buffer.substr(consumed, headerEnd - consumed);
+                size_t lengthPos = headers.find("Content-Length: ");
+                size_t contentLength = lengthPos == std::string::npos ? 0 : std::stoul(headers.substr(lengthPos + 16));
+                if (buffer.size() < headerEnd + 4 + contentLength) {
+                    break;
+                }
+                size_t countPos = headers.find("X-Webhook-Count: ");
+                webhooks += countPos == std::string::npos ? 1 : std::stoul(headers.substr(countPos + 17));
+                ++requests;
+                replies += reply;
+                consumed = headerEnd + 4 + contentLength;
+            }
+            buffer.erase(0, consumed);
+            if (!replies.empty()) {
+                ::send(fd, replies.data(), replies.size(), MSG_NOSIGNAL);
+                replies.clear();
+            }
+        }
+        ::close(fd);
+    }
+
+    int listenFd = -1;
+    int port = 0;
+    std::thread acceptThread;
+    std::mutex connectionMutex;
+    std::vector<int> connectionFds;
+    std::vector<std::thread> connectionThreads;
+};
+
+void benchmarkAsyncResponses() {
+    LoopbackHttpStub stub;
+    const std::vector<std::string> urls = {stub.url("/service-a/webhook"), stub.url("/service-b/webhook")};
+    const size_t responses = 50000;
+    const Payload payload = "{\"status\": \"processed\", \"order_id\": 123, \"note\": \"acknowledged by service\"}";
+
+    struct Mode {
+        const char* name;
+        size_t coalesce;
+        size_t pipelineDepth;
+    };
+    std::cout << "Async response delivery to loopback stub (" << responses << " responses, 2 URLs):\n";
+    for (const Mode& mode : {Mode{"request/reply   ", 1, 1}, Mode{"pipelined       ", 1, 32}, Mode{"coalesced+piped ", 64, 32}}) {
+        size_t webhooksBefore = stub.webhooks.load();
+        size_t requestsBefore = stub.requests.load();
+        AsyncResponseOptions options;
+        options.maxCoalesce = mode.coalesce;
+        options.maxPipelineDepth = mode.pipelineDepth;
+        options.queueCapacity = 8192;
+        AsyncWebhookResponse sender(options);
+
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < responses; ++i) {
+            sender.sendResponse(urls[i % urls.size()], payload);
+        }
+        sender.flush();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        AsyncResponseStats stats = sender.getStats();
+        std::cout << "  " << mode.name << static_cast<long>(responses / seconds) << " responses/s, p99 enqueue-to-send "
+                  << static_cast<long>(stats.p99EnqueueToSendUs) << " us, " << stats.requests << " requests over "
+                  << stats.connections << " connections, delivered " << stats.delivered << ", failed " << stats.failed
+                  << ", stub saw " << stub.webhooks.load() - webhooksBefore << " webhooks in "
+                  << stub.requests.load() - requestsBefore << " requests\n";
+    }
+}
+
+int connectLoopback(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+// Sends three responses to `url` and reports how long flush() took
+AsyncResponseStats sendToStalledDestination(const std::string& url, double& seconds) {
+    AsyncResponseOptions options;
+    options.connectTimeout = std::chrono::milliseconds(200);
+    options.replyTimeout = std::chrono::milliseconds(200);
+    AsyncWebhookResponse sender(options);
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < 3; ++i) {
+        sender.sendResponse(url, "{\"status\": \"processed\"}");
+    }
+    sender.flush();
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return sender.getStats();
+}
+
+// Destinations that never reply, or never finish the TCP handshake, must cost
+// one timeout rather than a stalled sender: flush() returns and the responses fail
+bool checkStalledDestinations() {
+    bool ok = true;
+    for (const char* stall : {"no reply", "no handshake"}) {
+        // Nobody accepts or reads. With a backlog of 0 and one connection already
+        // queued, the kernel also ignores further SYNs.
+        bool noHandshake = std::strcmp(stall, "no handshake") == 0;
+        int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        ::listen(listenFd, noHandshake ? 0 : 8);
+        socklen_t length = sizeof(address);
+        ::getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+        int fillerFd = noHandshake ? connectLoopback(ntohs(address.sin_port)) : -1;
+        const std::string url = "http://127.0.0.1:" + std::to_string(ntohs(address.sin_port)) + "/stalled";
+
+        double seconds = 0;
+        AsyncResponseStats stats = sendToStalledDestination(url, seconds);
+        if (fillerFd >= 0) {
+            ::close(fillerFd);
+        }
+        ::close(listenFd);
+
+        bool passed = stats.failed == 3 && stats.delivered == 0 && stats.timeouts >= 1 && seconds < 2.0;
+        ok = ok && passed;
+        std::cout << "  " << stall << ": flushed in " << static_cast<long>(seconds * 1000) << " ms, failed "
+                  << stats.failed << ", timeouts " << stats.timeouts << ", " << (passed ? "ok" : "WRONG") << "\n";
+    }
+    return ok;
+}
+
+// Handler that throws for its first `failures` calls, like a downstream outage
+class FlakyWebhookHandler : public WebhookHandler {
+public:
+    explicit FlakyWebhookHandler(int failures) : failuresLeft(failures) {}
+
+    void handleWebhook(const Payload&) override {
+        if (failuresLeft.fetch_sub(1) > 0) {
+            throw std::runtime_error("downstream unavailable");
+        }
+        handled.fetch_add(1);
+    }
+
+    std::atomic<int> failuresLeft;
+    std::atomic<size_t> handled{0};
+};
+
+// A delivery whose handler threw must be accepted when the provider retries it,
+// and only then count as a duplicate
+bool checkRetryAfterHandlerFailure() {
+    Payload delivery = "{\"delivery_id\": \"dlv_7\", \"payment_id\": 456}";
+
+    IdempotencyCache cache(size_t(1) << 10);
+    WebhookDispatcher dispatcher;
+    auto flaky = std::make_unique<FlakyWebhookHandler>(1);
+    FlakyWebhookHandler* handler = flaky.get();
+    dispatcher.registerHandler("payment_received", std::move(flaky));
+    dispatcher.compileRoutes();
+    dispatcher.setIdempotencyCache(&cache);
+    bool threw = false;
+    try {
+        dispatcher.handleWebhook("payment_received", delivery);
+    } catch (const std::exception&) {
+        threw = true;
+    }
+    bool syncOk = threw && dispatcher.handleWebhook("payment_received", delivery) == DispatchResult::Handled &&
+                  dispatcher.handleWebhook("payment_received", delivery) == DispatchResult::Duplicate &&
+                  handler->handled.load() == 1;
+
+    IdempotencyCache shardedCache(size_t(1) << 10);
+    ShardedWebhookDispatcher sharded(2);
+    auto shardedFlaky = std::make_unique<FlakyWebhookHandler>(1);
+    FlakyWebhookHandler* shardedHandler = shardedFlaky.get();
+    sharded.registerHandler("payment_received", std::move(shardedFlaky));
+    sharded.compileRoutes();
+    sharded.setIdempotencyCache(&shardedCache);
+    bool shardedOk = sharded.handleWebhook("payment_received", delivery) == DispatchResult::Handled;
+    sharded.drain();
+    shardedOk = shardedOk && sharded.handleWebhook("payment_received", delivery) == DispatchResult::Handled;
+    sharded.drain();
+    shardedOk = shardedOk && sharded.handleWebhook("payment_received", delivery) == DispatchResult::Duplicate &&
+                sharded.failedWebhooks() == 1 && shardedHandler->handled.load() == 1;
+
+    std::cout << "  retry after handler failure: synchronous " << (syncOk ? "ok" : "FAILED") << ", sharded "
+              << (shardedOk ? "ok" : "FAILED") << "\n";
+    return syncOk && shardedOk;
+}
+
+bool benchmarkIdempotency() {
+    // Window behaviour: repeats are rejected until the window has passed
+    IdempotencyCache shortWindow(1024, std::chrono::milliseconds(80));
+    bool windowOk = shortWindow.insertIfAbsent("dlv_1") && !shortWindow.insertIfAbsent("dlv_1") &&
+                    shortWindow.insertIfAbsent("dlv_2");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    windowOk = windowOk && shortWindow.insertIfAbsent("dlv_1");
+
+    // End to end: a retried delivery never reaches the handler twice
+    IdempotencyCache cache(size_t(1) << 16);
+    WebhookDispatcher dispatcher;
+    auto audit = std::make_unique<AuditWebhookHandler>();
+    dispatcher.registerHandler("payment_received", std::move(audit));
+    dispatcher.compileRoutes();
+    dispatcher.setIdempotencyCache(&cache);
+    Payload delivery = "{\"delivery_id\": \"dlv_42\", \"payment_id\": 456}";
+    bool dispatchOk = dispatcher.handleWebhook("payment_received", delivery) == DispatchResult::Handled &&
+                      dispatcher.handleWebhook("payment_received", delivery) == DispatchResult::Duplicate;
+
+    // Throughput with many ingest threads; a third of deliveries are retries
+    const size_t capacity = size_t(1) << 22;
+    const size_t perThread = 400000;
+    const size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 4);
+    std::cout << "Idempotency cache (" << capacity << " IDs, fixed " << IdempotencyCache(capacity).memoryBytes() / (1024 * 1024)
+              << " MB):\n";
+    bool countsOk = true;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        IdempotencyCache shared(capacity);
+        std::vector<std::vector<std::string>> ids(threads);
+        for (size_t t = 0; t < threads; ++t) {
+            for (size_t i = 0; i < perThread; ++i) {
+                size_t unique = i - i / 3; // every third delivery repeats the previous ID
+                ids[t].push_back("dlv_" + std::to_string(t) + "_" + std::to_string(unique));
+            }
+        }
+
+        std::atomic<size_t> accepted{0};
+        std::vector<std::thread> workers;
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                size_t local = 0;
+                for (const std::string& id : ids[t]) {
+                    local += shared.insertIfAbsent(id);
+                }
+                accepted += local;
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        size_t expected = threads * (perThread - perThread / 3);
+        countsOk = countsOk && accepted.load() == expected;
+        std::cout << "  " << threads << " threads: " << static_cast<long>(threads * perThread / seconds / 1e3)
+                  << "k checks/s, accepted " << accepted.load() << " of " << expected << " unique\n";
+    }
+
+    // Racing inserts: every thread offers the same IDs in the same order, so
+    // same-ID inserts collide; each ID must still be accepted exactly once
+    const size_t racingIds = 200000;
+    const size_t racingThreads = 4;
+    IdempotencyCache racing(racingIds * 16); // roomy, so no bucket overflows and evicts
+    std::atomic<size_t> racingAccepted{0};
+    std::vector<std::thread> racers;
+    for (size_t t = 0; t < racingThreads; ++t) {
+        racers.emplace_back([&] {
+            size_t local = 0;
+            for (size_t i = 0; i < racingIds; ++i) {
+                local += racing.insertIfAbsent("race_" + std::to_string(i));
+            }
+            racingAccepted += local;
+        });
+    }
+    for (std::thread& racer : racers) {
+        racer.join();
+    }
+    bool racingOk = racingAccepted.load() == racingIds;
+
+    std::cout << "  window expiry " << (windowOk ? "ok" : "FAILED") << ", dispatcher dedup "
+              << (dispatchOk ? "ok" : "FAILED") << ", racing inserts accepted " << racingAccepted.load() << " of "
+              << racingIds << std::endl;
+    countsOk = countsOk && racingOk;
+    bool retryOk = checkRetryAfterHandlerFailure();
+    return windowOk && dispatchOk && countsOk && retryOk;
+}
+
+bool benchmarkHotDeploy() {
+    const size_t readerThreads = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+    const size_t deployments = 200;
+    std::vector<std::string> events;
+    for (size_t i = 0; i < deployments; ++i) {
+        events.push_back("deployed_event_" + std::to_string(i));
+    }
+    const Payload payload = "{\"order_id\": 123, \"amount\": 4999}";
+
+    auto run = [&](bool deployWhileRunning, bool& routable) {
+        WebhookDispatcher dispatcher;
+        dispatcher.registerHandler("order_placed", std::make_unique<ChecksumWebhookHandler>());
+        dispatcher.compileRoutes();
+
+        std::atomic<size_t> deployed{0};
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> dispatched{0};
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < readerThreads; ++t) {
+            readers.emplace_back([&, t] {
+                size_t local = 0;
+                for (size_t i = t; !stop.load(std::memory_order_relaxed); ++i) {
+                    size_t live = deployed.load(std::memory_order_acquire);
+                    if (live == 0 || i % 2 == 0) {
+                        dispatcher.handleWebhook("order_placed", payload);
+                    } else {
+                        dispatcher.handleWebhook(events[i % live], payload);
+                    }
+                    ++local;
+                }
+                dispatched += local;
+            });
+        }
+
+        // Hot-deploy new event types and swap the order handler under load
+        routable = true;
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < deployments; ++i) {
+            if (deployWhileRunning) {
+                dispatcher.registerHandler(events[i], std::make_unique<ChecksumWebhookHandler>());
+                if (i % 50 == 49) {
+                    dispatcher.registerHandler("order_placed", std::make_unique<ChecksumWebhookHandler>());
+                    dispatcher.compileRoutes();
+                }
+                routable = routable && dispatcher.handleWebhook(events[i], payload) == DispatchResult::Handled;
+                deployed.store(i + 1, std::memory_order_release);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        stop = true;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        return dispatched.load() / seconds;
+    };
+
+    bool unused = true;
+    bool routable = true;
+    double steadyRate = run(false, unused);
+    double deployRate = run(true, routable);
+    std::cout << "Hot deploy (" << readerThreads << " dispatch threads, " << deployments << " registrations):\n"
+              << "  no registrations    " << static_cast<long>(steadyRate) << " webhooks/s\n"
+              << "  registering live    " << static_cast<long>(deployRate) << " webhooks/s, new types routable "
+              << (routable ? "immediately" : "FAILED") << "\n";
+    return routable;
+}
+
+// Sends `request` and half-closes the connection, as a client that has nothing
+// more to say does; returns how many replies with `status` arrive before the server closes
+size_t sendThenHalfClose(uint16_t port, const std::string& request, int status) {
+    int fd = connectLoopback(port);
+    if (fd < 0) {
+        return 0;
+    }
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    ::shutdown(fd, SHUT_WR);
+    std::string replies;
+    char chunk[4096];
+    for (;;) {
+        ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            break;
+        }
+        replies.append(chunk, static_cast<size_t>(received));
+    }
+    ::close(fd);
+    size_t count = 0;
+    const std::string statusLine = "HTTP/1.1 " + std::to_string(status) + " ";
+    for (size_t at = replies.find(statusLine); at != std::string::npos; at = replies.find(statusLine, at + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+// Sends one request on a fresh connection and returns the reply's status code
+int sendSingleRequest(uint16_t port, const std::string& request) {
+    int fd = connectLoopback(port);
+    if (fd < 0) {
+        return 0;
+    }
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    std::string reply;
+    char chunk[4096];
+    while (reply.find("\r\n\r\n") == std::string::npos) {
+        ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            break;
+        }
+        reply.append(chunk, static_cast<size_t>(received));
+    }
+    ::close(fd);
+    return reply.size() > 12 ? std::atoi(reply.c_str() + 9) : 0;
+}
+
+// Sends `request` in two writes `pause` apart, so the server reads it in more
+// than one piece; returns the reply's status code, or 0 if none comes within 2 s
+int sendInPieces(uint16_t port, const std::string& request, size_t splitAt, std::chrono::milliseconds pause) {
+    int fd = connectLoopback(port);
+    if (fd < 0) {
+        return 0;
+    }
+    timeval timeout{2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::send(fd, request.data(), splitAt, MSG_NOSIGNAL);
+    std::this_thread::sleep_for(pause);
+    ::send(fd, request.data() + splitAt, request.size() - splitAt, MSG_NOSIGNAL);
+    std::string reply;
+    char chunk[4096];
+    while (reply.find("\r\n\r\n") == std::string::npos) {
+        ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            break;
+        }
+        reply.append(chunk, static_cast<size_t>(received));
+    }
+    ::close(fd);
+    return reply.size() > 12 ? std::atoi(reply.c_str() + 9) : 0;
+}
+
+std::string makeHttpRequest(const std::string& method, const std::string& path, const std::string& body,
+                            bool keepAlive = true) {
+    return method + " " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/json\r\nContent-Length: " +
+           std::to_string(body.size()) + (keepAlive ? "" : "\r\nConnection: close") + "\r\n\r\n" + body;
+}
+
+bool benchmarkHttpIngestion() {
+    WebhookDispatcher dispatcher;
+    dispatcher.registerHandler("order_placed", std::make_unique<ChecksumWebhookHandler>());
+    dispatcher.compileRoutes();
+
+    std::atomic<size_t> bodyBytes{0};
+    std::atomic<bool> afterCloseDispatched{false};
+    const std::string largeBody = "{\"blob\": \"" + std::string(200 * 1024, 'x') + "\"}";
+    WebhookHttpServer server([&](std::string_view event, const Payload& payload) {
+        if (event == "large_body") {
+            return payload == largeBody ? DispatchResult::Handled : DispatchResult::Rejected;
+        }
+        if (event == "after_close") {
+            afterCloseDispatched = true;
+            return DispatchResult::NoHandler;
+        }
+        if (event == "stall") {
+            // Holds up the event loop so a client's data and FIN arrive before it next reads
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            return DispatchResult::NoHandler;
+        }
+        bodyBytes.fetch_add(payload.size(), std::memory_order_relaxed);
+        return dispatcher.handleWebhook(event, payload);
+    });
+    if (!server.start()) {
+        std::cout << "HTTP ingestion: could not bind a loopback port" << std::endl;
+        return false;
+    }
+    const uint16_t port = server.getPort();
+
+    const std::string body = "{\"order_id\": 123, \"amount\": 4999, \"currency\": \"EUR\", \"customer\": \"c_829\"}";
+    bool statusOk = sendSingleRequest(port, makeHttpRequest("POST", "/webhooks/order_placed", body, false)) == 202 &&
+                    sendSingleRequest(port, makeHttpRequest("POST", "/webhooks/unknown_event", body, false)) == 404 &&
+                    sendSingleRequest(port, makeHttpRequest("GET", "/webhooks/order_placed", "", false)) == 405 &&
+                    sendSingleRequest(port, "POST /webhooks/order_placed HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n") == 501;
+
+    // Bodies larger than one read, and bodies whose headers arrive well before them, still complete
+    const std::string largeRequest = makeHttpRequest("POST", "/webhooks/large_body", largeBody, false);
+    size_t headerBytes = largeRequest.size() - largeBody.size();
+    bool largeBodyOk = sendInPieces(port, largeRequest, headerBytes + 100, std::chrono::milliseconds(50)) == 202 &&
+                       sendInPieces(port, largeRequest, largeRequest.size() / 2, std::chrono::milliseconds(50)) == 202;
+
+    // A client that pipelines requests and then shuts down its sending side still gets every reply
+    const size_t halfClosedRequests = 3;
+    std::string halfClosed;
+    for (size_t i = 0; i < halfClosedRequests; ++i) {
+        halfClosed += makeHttpRequest("POST", "/webhooks/order_placed", body);
+    }
+    std::thread stall([&] { sendSingleRequest(port, makeHttpRequest("POST", "/webhooks/stall", "", false)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    bool halfCloseOk = sendThenHalfClose(port, halfClosed, 202) == halfClosedRequests;
+    stall.join();
+
+    // A request sent after one asking to close, while the server is still busy
+    // with it, is never dispatched
+    const std::string closing = makeHttpRequest("POST", "/webhooks/stall", "", false);
+    bool closeOk = sendInPieces(port, closing + makeHttpRequest("POST", "/webhooks/after_close", body), closing.size(),
+                                std::chrono::milliseconds(20)) == 404 &&
+                   !afterCloseDispatched.load();
+
+    // Closed-loop load: each client keeps a window of pipelined requests in flight
+    const size_t clients = 8;
+    const size_t window = 16;
+    const auto duration = std::chrono::milliseconds(1000);
+    std::string windowBytes;
+    for (size_t i = 0; i < window; ++i) {
+        windowBytes += makeHttpRequest("POST", "/webhooks/order_placed", body);
+    }
+
+    std::vector<std::vector<double>> latencies(clients);
+    std::atomic<size_t> accepted{0};
+    std::atomic<size_t> rejected{0};
+    std::vector<std::thread> threads;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            int fd = connectLoopback(port);
+            if (fd < 0) {
+                rejected += 1;
+                return;
+            }
+            std::string replies;
+            char chunk[65536];
+            while (std::chrono::steady_clock::now() - begin < duration) {
+                auto sentAt = std::chrono::steady_clock::now();
+                if (::send(fd, windowBytes.data(), windowBytes.size(), MSG_NOSIGNAL) < 0) {
+                    break;
+                }
+                size_t pending = window;
+                while (pending > 0) {
+                    ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+                    if (received <= 0) {
+                        pending = 0;
+                        break;
+                    }
+                    replies.append(chunk, static_cast<size_t>(received));
+                    auto arrivedAt = std::chrono::steady_clock::now();
+                    size_t end;
+                    while (pending > 0 && (end = replies.find("\r\n\r\n")) != std::string::npos) {
+                        (replies.compare(9, 3, "202") == 0 ? accepted : rejected) += 1;
+                        latencies[c].push_back(std::chrono::duration<double, std::micro>(arrivedAt - sentAt).count());
+                        replies.erase(0, end + 4);
+                        --pending;
+                    }
+                }
+            }
+            ::close(fd);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::vector<double> all;
+    for (const std::vector<double>& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    server.stop();
+
+    bool countsOk = rejected.load() == 0 &&
+                    bodyBytes.load() == (accepted.load() + 2 + halfClosedRequests) * body.size() &&
+                    server.requestsServed() == accepted.load() + 7 + halfClosedRequests;
+    std::cout << "HTTP ingestion (" << clients << " keep-alive clients, " << window << " pipelined requests each):\n"
+              << "  " << static_cast<long>(accepted.load() / seconds) << " requests/s, latency p50 "
+              << static_cast<long>(percentile(all, 0.5)) << " us, p99 " << static_cast<long>(percentile(all, 0.99))
+              << " us, p999 " << static_cast<long>(percentile(all, 0.999)) << " us\n"
+              << "  status codes " << (statusOk ? "ok" : "FAILED") << ", split large bodies "
+              << (largeBodyOk ? "ok" : "FAILED") << ", half-closed client "
+              << (halfCloseOk ? "ok" : "FAILED") << ", requests after close "
+              << (closeOk ? "dropped" : "FAILED") << ", request accounting " << (countsOk ? "ok" : "FAILED") << std::endl;
+    return statusOk && largeBodyOk && halfCloseOk && closeOk && countsOk;
+}
+
+// Spends `serviceTime` per webhook and records how long each one waited since
+// the "sent_ns" timestamp its producer embedded in the payload
+class LatencyRecordingHandler : public WebhookHandler {
+public:
+    explicit LatencyRecordingHandler(std::chrono::nanoseconds serviceTime) : serviceTime(serviceTime) {}
+
+    void handleWebhook(const Payload& payload) override {
+        spinFor(serviceTime);
+        long long sentNs = std::stoll(std::string(extractJsonField(payload.view(), "sent_ns")));
+        long long nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::lock_guard<std::mutex> lock(samplesMutex);
+        latenciesUs.push_back((nowNs - sentNs) / 1e3);
+    }
+
+    std::vector<double> samples() {
+        std::lock_guard<std::mutex> lock(samplesMutex);
+        return latenciesUs;
+    }
+
+private:
+    std::chrono::nanoseconds serviceTime;
+    std::mutex samplesMutex;
+    std::vector<double> latenciesUs;
+};
+
+std::string makeTimestampedPayload(const char* idField, size_t id) {
+    long long nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return "{\"" + std::string(idField) + "\": " + std::to_string(id) + ", \"sent_ns\": " + std::to_string(nowNs) + "}";
+}
+
+bool benchmarkPriorityLanes() {
+    const auto serviceTime = std::chrono::microseconds(20);
+    const auto duration = std::chrono::milliseconds(1500);
+
+    struct Scenario {
+        const char* name;
+        bool orderFlood;
+        bool separateLanes;
+    };
+    struct Outcome {
+        double paymentP50 = 0;
+        double paymentP99 = 0;
+        LaneStats payments;
+        LaneStats orders;
+    };
+
+    auto run = [&](const Scenario& scenario) {
+        PriorityWebhookDispatcher dispatcher(2);
+        size_t paymentLane = 0;
+        size_t orderLane = 0;
+        if (scenario.separateLanes) {
+            paymentLane = dispatcher.addLane("payments", LanePolicy{16, 4096, OverflowPolicy::RejectNew});
+            orderLane = dispatcher.addLane("orders", LanePolicy{1, 1024, OverflowPolicy::RejectNew});
+        } else {
+            paymentLane = orderLane = dispatcher.addLane("fifo", LanePolicy{1, 4096, OverflowPolicy::RejectNew});
+        }
+        auto payments = std::make_unique<LatencyRecordingHandler>(serviceTime);
+        LatencyRecordingHandler* paymentHandler = payments.get();
+        dispatcher.registerHandler("payment_received", std::move(payments), paymentLane);
+        dispatcher.registerHandler("order_updated", std::make_unique<LatencyRecordingHandler>(serviceTime), orderLane);
+        dispatcher.compileRoutes();
+
+        // Orders arrive in bursts well above what the workers can handle; payments trickle in
+        std::atomic<bool> stop{false};
+        std::thread orderProducer([&] {
+            for (size_t id = 0; scenario.orderFlood && !stop.load(); ) {
+                for (int i = 0; i < 200; ++i, ++id) {
+                    dispatcher.handleWebhook("order_updated", makeTimestampedPayload("order_id", id));
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        });
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t id = 0; std::chrono::steady_clock::now() - begin < duration; ++id) {
+            dispatcher.handleWebhook("payment_received", makeTimestampedPayload("payment_id", id));
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        stop = true;
+        orderProducer.join();
+        dispatcher.drain();
+
+        Outcome outcome;
+        std::vector<double> latencies = paymentHandler->samples();
+        outcome.paymentP50 = percentile(latencies, 0.5);
+        outcome.paymentP99 = percentile(latencies, 0.99);
+        outcome.payments = dispatcher.getLaneStats(paymentLane);
+        outcome.orders = dispatcher.getLaneStats(orderLane);
+        return outcome;
+    };
+
+    std::cout << "Priority lanes (2 workers, 20 us per webhook, orders offered at ~100k/s):\n";
+    Outcome outcomes[3];
+    const Scenario scenarios[3] = {Scenario{"payments alone ", false, true}, Scenario{"single FIFO    ", true, false},
+                                   Scenario{"priority lanes ", true, true}};
+    for (int i = 0; i < 3; ++i) {
+        outcomes[i] = run(scenarios[i]);
+        const Outcome& outcome = outcomes[i];
+        std::cout << "  " << scenarios[i].name << "payment p50 " << static_cast<long>(outcome.paymentP50) << " us, p99 "
+                  << static_cast<long>(outcome.paymentP99) << " us";
+        if (scenarios[i].separateLanes) {
+            std::cout << ", payments rejected " << outcome.payments.rejected << ", orders accepted "
+                      << outcome.orders.accepted << " rejected " << outcome.orders.rejected;
+        } else {
+            std::cout << ", lane accepted " << outcome.orders.accepted << " rejected " << outcome.orders.rejected;
+        }
+        std::cout << "\n";
+    }
+
+    const Outcome& lanes = outcomes[2];
+    bool ok = lanes.payments.rejected == 0 && lanes.orders.rejected > 0 && lanes.paymentP99 < outcomes[1].paymentP99;
+    std::cout << "  payments isolated from order overload " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+class ThrowingWebhookHandler : public WebhookHandler {
+public:
+    void handleWebhook(const Payload&) override { throw std::runtime_error("downstream unavailable"); }
+};
+
+bool benchmarkMetrics() {
+    const Payload payload = "{\"order_id\": 123, \"amount\": 4999}";
+    WebhookMetrics metrics;
+    WebhookDispatcher plain;
+    WebhookDispatcher instrumented;
+    instrumented.setMetrics(&metrics);
+    for (WebhookDispatcher* dispatcher : {&plain, &instrumented}) {
+        dispatcher->registerHandler("order_placed", std::make_unique<ChecksumWebhookHandler>());
+        dispatcher->registerHandler("payment_received", std::make_unique<ChecksumWebhookHandler>());
+        dispatcher->compileRoutes();
+    }
+    instrumented.registerHandler("refund_failed", std::make_unique<ThrowingWebhookHandler>());
+
+    // Best of several rounds, so scheduling noise does not show up as overhead
+    const int perRound = 1000000;
+    auto nanosPerEvent = [&](WebhookDispatcher& dispatcher) {
+        double best = 1e9;
+        for (int round = 0; round < 5; ++round) {
+            auto begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < perRound; ++i) {
+                dispatcher.handleWebhook("order_placed", payload);
+            }
+            best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / perRound);
+        }
+        return best;
+    };
+    double plainNs = nanosPerEvent(plain);
+    double instrumentedNs = nanosPerEvent(instrumented);
+
+    // Concurrent recorders are merged exactly on scrape
+    const size_t threads = 4;
+    const size_t perThread = 100000;
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (size_t i = 0; i < perThread; ++i) {
+                instrumented.handleWebhook("payment_received", payload);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    size_t thrown = 0;
+    for (int i = 0; i < 3; ++i) {
+        try {
+            instrumented.handleWebhook("refund_failed", payload);
+        } catch (const std::exception&) {
+            ++thrown;
+        }
+    }
+
+    MetricsSnapshot snapshot = metrics.snapshot();
+    bool countsOk = snapshot.events.size() == 3 && thrown == 3;
+    for (const EventMetrics& event : snapshot.events) {
+        if (event.event == "order_placed") {
+            countsOk = countsOk && event.handled == 5u * perRound && event.handlerTime.count() == 5u * perRound / 8;
+        } else if (event.event == "payment_received") {
+            countsOk = countsOk && event.handled == threads * perThread;
+        } else {
+            countsOk = countsOk && event.handled == 0 && event.errors == 3;
+        }
+    }
+    std::string json = snapshot.toJson();
+    countsOk = countsOk && json.find("\"event\": \"refund_failed\", \"handled\": 0, \"errors\": 3") != std::string::npos;
+
+    std::cout << "Handler metrics (thread-local recorders, merged on scrape):\n"
+              << "  dispatch " << plainNs << " ns plain, " << instrumentedNs << " ns instrumented, overhead "
+              << instrumentedNs - plainNs << " ns/event\n";
+    std::string text = snapshot.toText();
+    for (size_t start = 0, end; (end = text.find('\n', start)) != std::string::npos; start = end + 1) {
+        std::cout << "  " << text.substr(start, end - start) << "\n";
+    }
+    std::cout << "  counts across " << threads << " threads " << (countsOk ? "ok" : "FAILED") << std::endl;
+    return countsOk;
+}
+
+// Dispatcher with a checksum handler for every event type in `trace`
+std::unique_ptr<WebhookDispatcher> makeReplayDispatcher(const WebhookTrace& trace) {
+    auto dispatcher = std::make_unique<WebhookDispatcher>();
+    std::vector<std::string> seen;
+    for (const TraceEvent& event : trace.events()) {
+        if (std::find(seen.begin(), seen.end(), event.event) == seen.end()) {
+            seen.push_back(event.event);
+            dispatcher->registerHandler(event.event, std::make_unique<ChecksumWebhookHandler>());
+        }
+    }
+    dispatcher->compileRoutes();
+    return dispatcher;
+}
+
+bool benchmarkReplay() {
+    TraceProfile profile;
+    profile.burstFactor = 4;
+    WebhookTrace trace = WebhookTrace::synthesize(profile, 100000);
+    std::unique_ptr<WebhookDispatcher> dispatcher = makeReplayDispatcher(trace);
+    ReplayTarget target = [&](std::string_view event, const Payload& payload) {
+        return dispatcher->handleWebhook(event, payload);
+    };
+
+    ReplayOptions unpaced;
+    unpaced.allocationCounter = &allocationCount;
+    ReplayReport fast = replayTrace(trace, target, unpaced);
+    ReplayOptions paced = unpaced;
+    paced.speed = 1;
+    ReplayReport timed = replayTrace(trace, target, paced);
+
+    // Record live traffic, save it and load it back
+    TraceRecorder recorder(target);
+    for (size_t i = 0; i < 100; ++i) {
+        recorder(trace.events()[i].event, trace.events()[i].payload);
+    }
+    WebhookTrace recorded = recorder.trace();
+    std::string path = "/tmp/webhook_trace_" + std::to_string(::getpid()) + ".bin";
+    WebhookTrace reloaded;
+    bool roundTripOk = recorded.save(path) && WebhookTrace::load(path, reloaded) && reloaded.size() == recorded.size();
+    for (size_t i = 0; roundTripOk && i < reloaded.size(); ++i) {
+        roundTripOk = reloaded.events()[i].event == recorded.events()[i].event &&
+                      reloaded.events()[i].payload == recorded.events()[i].payload.view() &&
+                      reloaded.events()[i].offset == recorded.events()[i].offset;
+    }
+    std::remove(path.c_str());
+
+    std::cout << "Trace replay (" << trace.size() << " synthetic events, 50k/s mean, 4x bursts, "
+              << std::chrono::duration<double>(trace.duration()).count() << " s):\n"
+              << "  as fast as possible: " << fast.toText() << "\n"
+              << "  at recorded pace:    " << timed.toText() << "\n"
+              << "  record/save/load " << (roundTripOk ? "ok" : "FAILED") << std::endl;
+    return roundTripOk && fast.handled == trace.size() && timed.handled == trace.size() && fast.allocationsPerEvent == 0;
+}
+
+// webhook replay [--events N] [--rate R] [--burst B] [--size BYTES] [--speed S]
+//                [--threads T] [--trace PATH] [--save PATH] [--json]
+int runReplayTool(int argc, char** argv) {
+    TraceProfile profile;
+    ReplayOptions options;
+    options.allocationCounter = &allocationCount;
+    size_t events = 200000;
+    std::string tracePath;
+    std::string savePath;
+    bool json = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string flag = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (flag == "--json") {
+            json = true;
+            continue;
+        }
+        if (!value) {
+            std::cout << "Missing value for " << flag << std::endl;
+            return 2;
+        }
+        ++i;
+        if (flag == "--events") {
+            events = std::strtoul(value, nullptr, 10);
+        } else if (flag == "--rate") {
+            profile.eventsPerSecond = std::atof(value);
+        } else if (flag == "--burst") {
+            profile.burstFactor = std::atof(value);
+        } else if (flag == "--size") {
+            profile.medianPayloadBytes = std::strtoul(value, nullptr, 10);
+        } else if (flag == "--speed") {
+            options.speed = std::atof(value);
+        } else if (flag == "--threads") {
+            options.threads = std::strtoul(value, nullptr, 10);
+        } else if (flag == "--trace") {
+            tracePath = value;
+        } else if (flag == "--save") {
+            savePath = value;
+        } else {
+            std::cout << "Unknown option " << flag << std::endl;
+            return 2;
+        }
+    }
+
+    WebhookTrace trace;
+    if (tracePath.empty()) {
+        trace = WebhookTrace::synthesize(profile, events);
+    } else if (!WebhookTrace::load(tracePath, trace)) {
+        std::cout << "Could not read trace " << tracePath << std::endl;
+        return 1;
+    }
+    if (!savePath.empty() && !trace.save(savePath)) {
+        std::cout << "Could not write trace " << savePath << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<WebhookDispatcher> dispatcher = makeReplayDispatcher(trace);
+    ReplayReport report = replayTrace(trace, [&](std::string_view event, const Payload& payload) {
+        return dispatcher->handleWebhook(event, payload);
+    }, options);
+    std::cout << (json ? report.toJson() : report.toText()) << std::endl;
+    return 0;
+}
+
+bool benchmarkSignatureVerification() {
+    // Known answers: FIPS 180-2 "abc" and RFC 4231 test cases 2 and 6
+    uint8_t digest[Sha256::digestSize];
+    Sha256 abc;
+    abc.update("abc");
+    abc.finish(digest);
+    bool vectorsOk = digest[0] == 0xba && digest[1] == 0x78 && digest[31] == 0xad &&
+                     HmacSha256("Jefe").signHex("what do ya want for nothing?") ==
+                         "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" &&
+                     HmacSha256(std::string(131, '\xaa')).signHex("Test Using Larger Than Block-Size Key - Hash Key First") ==
+                         "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54";
+
+    // A non-hex digit in an otherwise correct signature is rejected
+    const HmacSha256 jefe("Jefe");
+    const std::string jefeMessage = "what do ya want for nothing?";
+    std::string nonHex = jefe.signHex(jefeMessage);
+    nonHex[0] = 'g';
+    vectorsOk = vectorsOk && jefe.verify(jefeMessage, jefe.signHex(jefeMessage)) && !jefe.verify(jefeMessage, nonHex);
+
+    // Signed corpus from two providers; every tenth signature is corrupted
+    const std::vector<std::pair<std::string, std::string>> secrets = {{"stripe", "whsec_5f2b9e0c7a14d3"},
+                                                                      {"shopify", "shpss_91c4e07f2ab8d6"}};
+    TraceProfile profile;
+    WebhookTrace trace = WebhookTrace::synthesize(profile, 100000);
+    std::vector<std::string> signatures;
+    std::vector<SignedWebhook> batch;
+    size_t forged = 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const auto& secret = secrets[i % secrets.size()];
+        std::string signature = "sha256=" + HmacSha256(secret.second).signHex(trace.events()[i].payload.view());
+        if (i % 10 == 7) {
+            signature[20] = signature[20] == '0' ? '1' : '0';
+            ++forged;
+        }
+        signatures.push_back(std::move(signature));
+    }
+    for (size_t i = 0; i < trace.size(); ++i) {
+        batch.push_back(SignedWebhook{secrets[i % secrets.size()].first, trace.events()[i].event,
+                                      trace.events()[i].payload, signatures[i]});
+    }
+
+    auto rate = [&](auto verifyAll) {
+        double best = 0;
+        for (int round = 0; round < 3; ++round) {
+            auto begin = std::chrono::steady_clock::now();
+            verifyAll();
+            best = std::max(best, batch.size() / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        }
+        return best;
+    };
+
+    // Baseline: the key schedule is rebuilt for every webhook
+    size_t naiveValid = 0;
+    double naiveRate = rate([&] {
+        naiveValid = 0;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            naiveValid += HmacSha256(secrets[i % secrets.size()].second).verify(batch[i].payload.view(), batch[i].signature);
+        }
+    });
+
+    WebhookVerifier single;
+    const size_t cores = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+    WebhookVerifier pooled(cores - 1);
+    for (WebhookVerifier* verifier : {&single, &pooled}) {
+        for (const auto& secret : secrets) {
+            verifier->registerProvider(secret.first, secret.second);
+        }
+    }
+    std::vector<uint8_t> valid(batch.size());
+    auto countValid = [&] { return static_cast<size_t>(std::count(valid.begin(), valid.end(), 1)); };
+    double cachedRate = rate([&] { single.verifyBatch(batch.data(), batch.size(), valid.data()); });
+    size_t cachedValid = countValid();
+    size_t allocationsBefore = allocationCount.load();
+    double pooledRate = rate([&] { pooled.verifyBatch(batch.data(), batch.size(), valid.data()); });
+    size_t batchAllocations = allocationCount.load() - allocationsBefore;
+    size_t pooledValid = countValid();
+
+    // Forged webhooks never reach a handler
+    WebhookDispatcher dispatcher;
+    for (const EventShare& share : profile.eventMix) {
+        dispatcher.registerHandler(share.event, std::make_unique<ChecksumWebhookHandler>());
+    }
+    dispatcher.compileRoutes();
+    std::vector<DispatchResult> results;
+    pooled.dispatchBatch(batch, [&](std::string_view event, const Payload& payload) {
+        return dispatcher.handleWebhook(event, payload);
+    }, results);
+    size_t handled = static_cast<size_t>(std::count(results.begin(), results.end(), DispatchResult::Handled));
+    size_t unauthorized = static_cast<size_t>(std::count(results.begin(), results.end(), DispatchResult::Unauthorized));
+
+    size_t expectedValid = batch.size() - forged;
+    bool countsOk = naiveValid == expectedValid && cachedValid == expectedValid && pooledValid == expectedValid &&
+                    handled == expectedValid && unauthorized == forged && batchAllocations == 0;
+    std::cout << "HMAC-SHA256 verification (" << batch.size() << " webhooks, median " << profile.medianPayloadBytes
+              << " B, "
+#if defined(__SHA__) && defined(__SSE4_1__)
+              << "SHA extensions"
+#else
+              << "portable SHA-256"
+#endif
+              << "):\n"
+              << "  key setup per webhook  " << static_cast<long>(naiveRate) << " verified/s\n"
+              << "  cached key schedule    " << static_cast<long>(cachedRate) << " verified/s per core\n"
+              << "  batched, " << cores << " threads     " << static_cast<long>(pooledRate) << " verified/s, "
+              << static_cast<long>(pooledRate / cores) << " per core\n"
+              << "  test vectors " << (vectorsOk ? "ok" : "FAILED") << ", " << unauthorized << " forged rejected before dispatch, "
+              << "accounting " << (countsOk ? "ok" : "FAILED") << std::endl;
+    return vectorsOk && countsOk;
+}
+
+// Returns the number of operator new calls made by `webhooks` warm dispatches
+template <typename Dispatch>
+size_t countSteadyStateAllocations(int webhooks, Dispatch dispatch) {
+    dispatch(); // warm up pools and lazily initialised state
+    size_t before = allocationCount.load();
+    for (int i = 0; i < webhooks; ++i) {
+        dispatch();
+    }
+    return allocationCount.load() - before;
+}
+
+bool checkZeroAllocationDispatch() {
+    WebhookHandlerFactory factory;
+    factory.registerHandler("audit", []() { return std::make_unique<AuditWebhookHandler>(); });
+    factory.registerHandler("checksum", []() { return std::make_unique<ChecksumWebhookHandler>(); },
+                            HandlerLifecycle::Stateless);
+    factory.compileRoutes();
+
+    WebhookMetrics metrics;
+    WebhookDispatcher dispatcher;
+    dispatcher.setMetrics(&metrics);
+    dispatcher.registerHandler("checksum", std::make_unique<ChecksumWebhookHandler>());
+    dispatcher.compileRoutes();
+    dispatcher.setRoutingKeyField("order_id");
+
+    const std::string event = "audit";
+    const Payload payload = "{\"order_id\": 123, \"amount\": 4999, \"currency\": \"EUR\"}";
+    size_t factoryAllocations = countSteadyStateAllocations(10000, [&]() {
+        factory.createHandler(event)->handleWebhook(payload);
+        factory.createHandler("checksum")->handleWebhook(payload);
+    });
+    size_t dispatcherAllocations = countSteadyStateAllocations(10000, [&]() {
+        dispatcher.handleWebhook("checksum", payload);
+    });
+
+    std::cout << "Steady-state allocations: factory " << factoryAllocations
+              << ", dispatcher " << dispatcherAllocations << std::endl;
+    return factoryAllocations == 0 && dispatcherAllocations == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "replay") == 0) {
+        return runReplayTool(argc, argv);
+    }
+
+    WebhookHandlerFactory factory;
+    for (const std::string type : {"order", "payment", "ServiceA", "refund"}) {
+        if (auto handler = factory.createHandler(type)) {
+            handler->handleWebhook("{\"order_id\": 123}");
+        } else {
+            std::cout << "Invalid webhook type: " << type << std::endl;
+        }
+    }
+
+    WebhookDispatcher dispatcher;
+    dispatcher.registerHandler("order_placed", std::make_unique<OrderPlacedHandler>());
+    dispatcher.registerHandler("payment_received", std::make_unique<PaymentReceivedHandler>());
+    dispatcher.compileRoutes();
+
+    // Added after compilation, so it is routed through the fallback table
+    dispatcher.registerHandler("order", std::make_unique<OrderWebhookHandler>());
+
+    dispatcher.handleWebhook("order_placed", "{\"order_id\": 123}");
+    dispatcher.handleWebhook("payment_received", "{\"payment_id\": 456}");
+    dispatcher.handleWebhook("order", "{\"order_id\": 789}");
+    dispatcher.handleWebhook("unknown_event", "{}");
+
+    benchmarkRouting();
+    benchmarkShardedDispatch();
+    if (!checkShardedHandlerFailure()) {
+        std::cout << "FAILED: a throwing handler stalled or miscounted a shard" << std::endl;
+        return 1;
+    }
+    benchmarkPayloadCopies();
+    benchmarkBatching();
+    if (!checkBatchingHandlerFailure()) {
+        std::cout << "FAILED: a throwing batch handler stalled or miscounted delivery" << std::endl;
+        return 1;
+    }
+    if (!checkBatchingDispatchResults()) {
+        std::cout << "FAILED: batching dispatcher misreported a dispatch result" << std::endl;
+        return 1;
+    }
+    benchmarkAsyncResponses();
+    if (!checkStalledDestinations()) {
+        std::cout << "FAILED: a stalled destination blocked the async sender" << std::endl;
+        return 1;
+    }
+
+    if (!benchmarkFieldScanner()) {
+        std::cout << "FAILED: field scanner disagrees with the full parse" << std::endl;
+        return 1;
+    }
+    if (!benchmarkIdempotency()) {
+        std::cout << "FAILED: idempotency cache let a duplicate through or dropped a new delivery" << std::endl;
+        return 1;
+    }
+    if (!benchmarkHotDeploy()) {
+        std::cout << "FAILED: a hot-deployed event type was not routable" << std::endl;
+        return 1;
+    }
+    if (!benchmarkHttpIngestion()) {
+        std::cout << "FAILED: HTTP front-end returned a wrong status or lost a request" << std::endl;
+        return 1;
+    }
+    if (!benchmarkPriorityLanes()) {
+        std::cout << "FAILED: order overload leaked into the payment lane" << std::endl;
+        return 1;
+    }
+    if (!benchmarkMetrics()) {
+        std::cout << "FAILED: metrics lost or miscounted events" << std::endl;
+        return 1;
+    }
+    if (!benchmarkReplay()) {
+        std::cout << "FAILED: trace replay dropped events or allocated per event" << std::endl;
+        return 1;
+    }
+    if (!benchmarkSignatureVerification()) {
+        std::cout << "FAILED: signature verification accepted a forgery or rejected a valid webhook" << std::endl;
+        return 1;
+    }
+    if (!checkZeroAllocationDispatch()) {
+        std::cout << "FAILED: steady-state dispatch allocated memory" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,243 @@
+#include "BetaDiversity.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Species per chunk: one chunk of a 64-site tile's rows stays in L2. A
+// chunk's sum is an int, twice as many lanes wide as an int64_t, whenever
+// every count is below 2^31 / 512; larger counts take the int64_t loop.
+const int species_chunk = 512;
+
+// True when a Bray-Curtis chunk sum can overflow an int
+bool needs_wide_sums(const SpeciesMatrix& sites, BetaMetric metric) {
+    if (metric != BetaMetric::BrayCurtis) {
+        return false;
+    }
+    int largest = 0;
+    for (int site = 0; site < sites.num_sites(); site++) {
+        const int* row = sites.row(site);
+        for (int k = 0; k < sites.num_species(); k++) {
+            largest = std::max(largest, row[k]);
+        }
+    }
+    return largest > std::numeric_limits<int>::max() / species_chunk;
+}
+
+// Per-site totals the metrics divide by: individuals for Bray-Curtis, species present for Jaccard
+std::vector<long long> site_totals(const SpeciesMatrix& sites, BetaMetric metric) {
+    std::vector<long long> totals(sites.num_sites());
+    for (int site = 0; site < sites.num_sites(); site++) {
+        const int* row = sites.row(site);
+        long long total = 0;
+        for (int k = 0; k < sites.num_species(); k++) {
+            total += metric == BetaMetric::BrayCurtis ? row[k] : row[k] > 0;
+        }
+        totals[site] = total;
+    }
+    return totals;
+}
+
+float finish_distance(BetaMetric metric, long long shared, long long total_a, long long total_b) {
+    if (metric == BetaMetric::BrayCurtis) {
+        long long both = total_a + total_b;
+        return both == 0 ? 0.0f : static_cast<float>(1.0 - 2.0 * shared / both);
+    }
+    long long either = total_a + total_b - shared;
+    return either == 0 ? 0.0f : static_cast<float>(1.0 - static_cast<double>(shared) / either);
+}
+
+// Fills `shared` with sum(min) or shared presence for each pair of the tile,
+// summing each chunk in a `Sum`
+template <BetaMetric metric, typename Sum>
+void accumulate_tile(const SpeciesMatrix& sites, int i_first, int i_last, int j_first, int j_last, int tile,
+                     long long* shared) {
+    int num_species = sites.num_species();
+    for (int chunk = 0; chunk < num_species; chunk += species_chunk) {
+        int length = std::min(species_chunk, num_species - chunk);
+        for (int i = i_first; i < i_last; i++) {
+            const int* a = sites.row(i) + chunk;
+            for (int j = std::max(j_first, i + 1); j < j_last; j++) {
+                const int* b = sites.row(j) + chunk;
+                Sum sum = 0;
+                if (metric == BetaMetric::BrayCurtis) {
+                    #pragma omp simd reduction(+:sum)
+                    for (int k = 0; k < length; k++) {
+                        sum += static_cast<Sum>(std::min(a[k], b[k]));
+                    }
+                } else {
+                    #pragma omp simd reduction(+:sum)
+                    for (int k = 0; k < length; k++) {
+                        sum += (a[k] > 0) & (b[k] > 0);
+                    }
+                }
+                shared[(i - i_first) * tile + (j - j_first)] += sum;
+            }
+        }
+    }
+}
+
+void tile_with_totals(const SpeciesMatrix& sites, BetaMetric metric, const std::vector<long long>& totals,
+                      bool wide_sums, int i_first, int j_first, int tile, float* out, std::vector<long long>& shared) {
+    int i_last = std::min(sites.num_sites(), i_first + tile);
+    int j_last = std::min(sites.num_sites(), j_first + tile);
+    shared.assign(static_cast<size_t>(tile) * tile, 0);
+    if (metric == BetaMetric::Jaccard) {
+        accumulate_tile<BetaMetric::Jaccard, int>(sites, i_first, i_last, j_first, j_last, tile, shared.data());
+    } else if (wide_sums) {
+        accumulate_tile<BetaMetric::BrayCurtis, int64_t>(sites, i_first, i_last, j_first, j_last, tile,
+                                                         shared.data());
+    } else {
+        accumulate_tile<BetaMetric::BrayCurtis, int>(sites, i_first, i_last, j_first, j_last, tile, shared.data());
+    }
+    for (int i = i_first; i < i_last; i++) {
+        for (int j = std::max(j_first, i + 1); j < j_last; j++) {
+            size_t slot = static_cast<size_t>(i - i_first) * tile + (j - j_first);
+            out[slot] = finish_distance(metric, shared[slot], totals[i], totals[j]);
+        }
+    }
+}
+
+// Upper-triangle tiles (row tile <= column tile), in row-major order
+std::vector<std::pair<int, int>> upper_tiles(int num_sites, int tile) {
+    std::vector<std::pair<int, int>> tiles;
+    for (int i = 0; i < num_sites; i += tile) {
+        for (int j = i; j < num_sites; j += tile) {
+            tiles.emplace_back(i, j);
+        }
+    }
+    return tiles;
+}
+
+} // namespace
+
+float beta_distance_reference(const int* a, const int* b, int num_species, BetaMetric metric) {
+    long long shared = 0;
+    long long total_a = 0;
+    long long total_b = 0;
+    for (int k = 0; k < num_species; k++) {
+        if (metric == BetaMetric::BrayCurtis) {
+            shared += std::min(a[k], b[k]);
+            total_a += a[k];
+            total_b += b[k];
+        } else {
+            shared += a[k] > 0 && b[k] > 0;
+            total_a += a[k] > 0;
+            total_b += b[k] > 0;
+        }
+    }
+    return finish_distance(metric, shared, total_a, total_b);
+}
+
+std::vector<float> distance_matrix(const SpeciesMatrix& sites, BetaMetric metric, int tile) {
+    if (sites.num_species() < 0) {
+        throw std::logic_error("distance_matrix needs rows of equal length");
+    }
+    size_t n = sites.num_sites();
+    std::vector<float> distances(n * (n - (n > 0)) / 2);
+    std::vector<long long> totals = site_totals(sites, metric);
+    bool wide_sums = needs_wide_sums(sites, metric);
+    std::vector<std::pair<int, int>> tiles = upper_tiles(sites.num_sites(), tile);
+
+    #pragma omp parallel
+    {
+        std::vector<float> out(static_cast<size_t>(tile) * tile);
+        std::vector<long long> shared;
+        #pragma omp for schedule(dynamic)
+        for (size_t t = 0; t < tiles.size(); t++) {
+            int i_first = tiles[t].first;
+            int j_first = tiles[t].second;
+            tile_with_totals(sites, metric, totals, wide_sums, i_first, j_first, tile, out.data(), shared);
+            int i_last = std::min(sites.num_sites(), i_first + tile);
+            int j_last = std::min(sites.num_sites(), j_first + tile);
+            for (int i = i_first; i < i_last; i++) {
+                int j_begin = std::max(j_first, i + 1);
+                if (j_begin < j_last) {
+                    std::copy(&out[static_cast<size_t>(i - i_first) * tile + (j_begin - j_first)],
+                              &out[static_cast<size_t>(i - i_first) * tile + (j_last - j_first)],
+                              &distances[condensed_index(n, i, j_begin)]);
+                }
+            }
+        }
+    }
+    return distances;
+}
+
+DistanceRunStats write_distance_matrix(const SpeciesMatrix& sites, BetaMetric metric, const std::string& path,
+                                       MPI_Comm comm, int tile) {
+    if (sites.num_species() < 0) {
+        throw std::logic_error("write_distance_matrix needs rows of equal length");
+    }
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    MPI_File file;
+    if (MPI_File_open(comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        throw std::runtime_error("cannot create " + path);
+    }
+    size_t n = sites.num_sites();
+    // A failed write on any rank fails the call on every rank, once all have finished
+    bool ok = MPI_File_set_size(file, static_cast<MPI_Offset>(n * (n - (n > 0)) / 2 * sizeof(float))) ==
+              MPI_SUCCESS;
+
+    std::vector<long long> totals = site_totals(sites, metric);
+    bool wide_sums = needs_wide_sums(sites, metric);
+    std::vector<std::pair<int, int>> all_tiles = upper_tiles(sites.num_sites(), tile);
+    std::vector<std::pair<int, int>> tiles;
+    for (size_t t = rank; t < all_tiles.size(); t += size) {
+        tiles.push_back(all_tiles[t]);
+    }
+
+    // Tiles are computed a round at a time on every thread, then written from
+    // this thread, so MPI never needs to be called from OpenMP threads
+    DistanceRunStats stats;
+    const size_t tiles_per_round = 256;
+    std::vector<float> results(tiles_per_round * tile * tile);
+    for (size_t round = 0; round < tiles.size(); round += tiles_per_round) {
+        size_t round_tiles = std::min(tiles_per_round, tiles.size() - round);
+        #pragma omp parallel
+        {
+            std::vector<long long> shared;
+            #pragma omp for schedule(dynamic)
+            for (size_t t = 0; t < round_tiles; t++) {
+                tile_with_totals(sites, metric, totals, wide_sums, tiles[round + t].first, tiles[round + t].second,
+                                 tile, &results[t * tile * tile], shared);
+            }
+        }
+        for (size_t t = 0; t < round_tiles; t++) {
+            int i_first = tiles[round + t].first;
+            int j_first = tiles[round + t].second;
+            int i_last = std::min(sites.num_sites(), i_first + tile);
+            int j_last = std::min(sites.num_sites(), j_first + tile);
+            for (int i = i_first; i < i_last; i++) {
+                int j_begin = std::max(j_first, i + 1);
+                if (j_begin >= j_last) {
+                    continue;
+                }
+                // Each row of a tile is one contiguous run of the condensed triangle
+                MPI_Status status;
+                int written = 0;
+                ok = ok &&
+                     MPI_File_write_at(file, static_cast<MPI_Offset>(condensed_index(n, i, j_begin) * sizeof(float)),
+                                       &results[t * tile * tile + static_cast<size_t>(i - i_first) * tile +
+                                                (j_begin - j_first)],
+                                       j_last - j_begin, MPI_FLOAT, &status) == MPI_SUCCESS &&
+                     MPI_Get_count(&status, MPI_FLOAT, &written) == MPI_SUCCESS && written == j_last - j_begin;
+                stats.pairs += j_last - j_begin;
+            }
+            stats.tiles++;
+        }
+    }
+    ok = MPI_File_close(&file) == MPI_SUCCESS && ok;
+    int local_ok = ok ? 1 : 0;
+    int all_ok = 0;
+    MPI_Allreduce(&local_ok, &all_ok, 1, MPI_INT, MPI_MIN, comm);
+    if (all_ok != 1) {
+        throw std::runtime_error("failed writing " + path);
+    }
+    return stats;
+}
@@ -0,0 +1,44 @@
+#ifndef BETA_DIVERSITY_H
+#define BETA_DIVERSITY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+#include "SpeciesMatrix.h"
+
+enum class BetaMetric {
+    BrayCurtis, // 1 - 2 * sum(min(a_k, b_k)) / (sum(a) + sum(b))
+    Jaccard     // 1 - shared species / species at either site
+};
+
+// Pairs of sites are stored as a condensed upper triangle: the n(n-1)/2
+// distances (i, j), i < j, row by row, so pair (i, j) is at
+// i * n - i * (i + 1) / 2 + (j - i - 1). Two sites with no individuals are at distance 0.
+inline size_t condensed_index(size_t num_sites, size_t i, size_t j) {
+    return i * num_sites - i * (i + 1) / 2 + (j - i - 1);
+}
+
+// One pair compared species by species; the accuracy reference for the tiles
+float beta_distance_reference(const int* a, const int* b, int num_species, BetaMetric metric);
+
+// Distance matrix of every pair of sites, in condensed form, on one rank.
+// Pairs are computed a 64 x 64 tile of sites at a time, with the species taken
+// in cache-sized chunks and each chunk of a pair as one SIMD loop.
+std::vector<float> distance_matrix(const SpeciesMatrix& sites, BetaMetric metric, int tile = 64);
+
+struct DistanceRunStats {
+    size_t tiles = 0;  // tiles computed by this rank
+    size_t pairs = 0;  // pairs computed by this rank
+};
+
+// Collective: computes the condensed distance matrix across ranks and writes
+// it to `path` as float32, with MPI-IO. The upper triangle of tiles is dealt
+// round-robin to ranks and each rank's tiles run on OpenMP threads. Every rank
+// must pass the full site matrix. Throws std::runtime_error on every rank if
+// any rank's write fails or comes back short.
+DistanceRunStats write_distance_matrix(const SpeciesMatrix& sites, BetaMetric metric, const std::string& path,
+                                       MPI_Comm comm, int tile = 64);
+
+#endif // BETA_DIVERSITY_H
@@ -0,0 +1,43 @@
+#include "ChunkScheduler.h"
+
+#include <algorithm>
+
+ChunkSchedule guided_chunks(int num_sites, int ranks, int min_chunk) {
+    ChunkSchedule schedule;
+    schedule.first.push_back(0);
+    int max_chunk = std::max(min_chunk, (num_sites + 8 * ranks - 1) / (8 * ranks));
+    int assigned = 0;
+    while (assigned < num_sites) {
+        int remaining = num_sites - assigned;
+        int chunk = std::clamp((remaining + 2 * ranks - 1) / (2 * ranks), min_chunk, max_chunk);
+        assigned += std::min(chunk, remaining);
+        schedule.first.push_back(assigned);
+    }
+    return schedule;
+}
+
+ChunkCounter::ChunkCounter(int root, MPI_Comm comm) : root(root) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Aint bytes = rank == root ? sizeof(int) : 0;
+    MPI_Win_allocate(bytes, sizeof(int), MPI_INFO_NULL, comm, &value, &window);
+    if (rank == root) {
+        *value = 0;
+    }
+    // Nobody may take a chunk before the root has zeroed the counter
+    MPI_Barrier(comm);
+    MPI_Win_lock_all(0, window);
+}
+
+ChunkCounter::~ChunkCounter() {
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+}
+
+int ChunkCounter::next() {
+    const int one = 1;
+    int chunk = 0;
+    MPI_Fetch_and_op(&one, &chunk, MPI_INT, root, 0, MPI_SUM, window);
+    MPI_Win_flush(root, window);
+    return chunk;
+}
@@ -0,0 +1,43 @@
+#ifndef CHUNK_SCHEDULER_H
+#define CHUNK_SCHEDULER_H
+
+#include <vector>
+#include <mpi.h>
+
+// Sites cut into chunks that shrink as the work runs out, in the manner of
+// OpenMP's guided schedule: each chunk takes 1/(2 * ranks) of the sites still
+// unassigned, but never fewer than min_chunk. Chunks are also capped at
+// 1/(8 * ranks) of all sites, so that when costly sites sit together at the
+// start they are still shared out. Every rank computes the same schedule, so
+// chunks can be referred to by number alone.
+struct ChunkSchedule {
+    std::vector<int> first; // chunk c covers sites [first[c], first[c + 1])
+
+    int num_chunks() const { return static_cast<int>(first.size()) - 1; }
+    int begin(int chunk) const { return first[chunk]; }
+    int end(int chunk) const { return first[chunk + 1]; }
+};
+
+ChunkSchedule guided_chunks(int num_sites, int ranks, int min_chunk = 16);
+
+// Shared counter handing out chunk numbers, kept on `root` and advanced with
+// MPI_Fetch_and_op, so ranks take the next chunk without a coordinator having
+// to answer. Construction and destruction are collective.
+class ChunkCounter {
+public:
+    ChunkCounter(int root, MPI_Comm comm);
+    ~ChunkCounter();
+
+    ChunkCounter(const ChunkCounter&) = delete;
+    ChunkCounter& operator=(const ChunkCounter&) = delete;
+
+    // Next unclaimed chunk number; keeps counting past the end of the schedule
+    int next();
+
+private:
+    MPI_Win window;
+    int* value = nullptr;
+    int root;
+};
+
+#endif // CHUNK_SCHEDULER_H
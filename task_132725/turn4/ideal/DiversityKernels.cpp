@@ -0,0 +1,127 @@
+#include "DiversityKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+const double ln2 = 0.69314718055994530942;
+const double sqrt2 = 1.41421356237309504880;
+
+// Counts below this take n * ln n from a table that stays in L1
+const int table_size = 2048;
+// Counts are processed in blocks; a block whose counts all fit the table skips the log entirely
+const size_t block_size = 64;
+
+struct NLogNTable {
+    double values[table_size];
+
+    NLogNTable() {
+        values[0] = 0.0;
+        for (int n = 1; n < table_size; n++) {
+            values[n] = n * std::log(static_cast<double>(n));
+        }
+    }
+};
+
+const NLogNTable n_log_n_table;
+
+inline uint64_t double_bits(double x) {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+inline double bits_double(uint64_t bits) {
+    double x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+} // namespace
+
+#pragma omp declare simd notinbranch
+double fast_log(double x) {
+    uint64_t bits = double_bits(x);
+    // Biased exponent as a double via the 2^52 trick, so no int64 -> double conversion is needed
+    double exponent = bits_double((bits >> 52) | 0x4330000000000000ULL) - (4503599627370496.0 + 1023.0);
+    double mantissa = bits_double((bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL);
+    bool high = mantissa > sqrt2;
+    mantissa = high ? mantissa * 0.5 : mantissa;
+    exponent = high ? exponent + 1.0 : exponent;
+
+    double t = (mantissa - 1.0) / (mantissa + 1.0);
+    double t2 = t * t;
+    double series = 1.0 + t2 * (1.0 / 3 + t2 * (1.0 / 5 + t2 * (1.0 / 7 + t2 * (1.0 / 9))));
+    return exponent * ln2 + 2.0 * t * series;
+}
+
+DiversityIndices diversity_from_sums(double total, double sum_squares, double sum_n_log_n) {
+    DiversityIndices indices;
+    indices.total = total;
+    if (total <= 0.0) {
+        return indices;
+    }
+    // H = -sum(n/N * ln(n/N)) = ln N - sum(n ln n) / N
+    indices.shannon = std::log(total) - sum_n_log_n / total;
+    indices.simpson = 1.0 - sum_squares / (total * total);
+    return indices;
+}
+
+DiversityIndices calculate_diversity(const int* counts, size_t species) {
+    double total = 0.0;
+    double sum_squares = 0.0;
+    double sum_n_log_n = 0.0;
+    const double* table = n_log_n_table.values;
+    for (size_t begin = 0; begin < species; begin += block_size) {
+        size_t end = std::min(species, begin + block_size);
+        int largest = 0;
+        #pragma omp simd reduction(max:largest)
+        for (size_t i = begin; i < end; i++) {
+            largest = std::max(largest, counts[i]);
+        }
+
+        if (largest < table_size) {
+            #pragma omp simd reduction(+:total, sum_squares, sum_n_log_n)
+            for (size_t i = begin; i < end; i++) {
+                double n = static_cast<double>(counts[i]);
+                total += n;
+                sum_squares += n * n;
+                sum_n_log_n += table[counts[i]];
+            }
+        } else {
+            #pragma omp simd reduction(+:total, sum_squares, sum_n_log_n)
+            for (size_t i = begin; i < end; i++) {
+                double n = static_cast<double>(counts[i]);
+                total += n;
+                sum_squares += n * n;
+                sum_n_log_n += n * fast_log(n); // zero counts contribute 0 * finite
+            }
+        }
+    }
+    return diversity_from_sums(total, sum_squares, sum_n_log_n);
+}
+
+DiversityIndices calculate_diversity_reference(const int* counts, size_t species) {
+    double total = 0.0;
+    for (size_t i = 0; i < species; i++) {
+        total += counts[i];
+    }
+    DiversityIndices indices;
+    indices.total = total;
+    if (total <= 0.0) {
+        return indices;
+    }
+    double sum_p_squared = 0.0;
+    for (size_t i = 0; i < species; i++) {
+        if (counts[i] > 0) {
+            double p = counts[i] / total;
+            indices.shannon -= p * std::log(p);
+            sum_p_squared += p * p;
+        }
+    }
+    indices.simpson = 1.0 - sum_p_squared;
+    return indices;
+}
@@ -0,0 +1,41 @@
+#ifndef DIVERSITY_KERNELS_H
+#define DIVERSITY_KERNELS_H
+
+#include <cstddef>
+#include <vector>
+
+// Diversity indices of one site's species abundance counts
+struct DiversityIndices {
+    double total = 0.0;    // individuals observed
+    double shannon = 0.0;  // H = -sum(p_i * ln p_i)
+    double simpson = 0.0;  // Gini-Simpson 1 - sum(p_i^2)
+};
+
+// Upper bound on |fast_log(x) - ln(x)| for x >= 1. Since Shannon entropy is
+// ln N - sum(p_i * ln n_i), the same bound holds for the entropy itself.
+constexpr double fast_log_max_error = 1e-9;
+
+// Natural log for x >= 1 (and harmless for x == 0) written without branches
+// or calls so that `#pragma omp simd` loops vectorize it: the exponent is read
+// from the bits of x, and ln of the mantissa, normalised to [sqrt(1/2), sqrt(2)),
+// comes from the atanh series ln m = 2(t + t^3/3 + ... + t^9/9), t = (m-1)/(m+1).
+#pragma omp declare simd notinbranch
+double fast_log(double x);
+
+// Shannon and Simpson indices from one fused pass accumulating the total,
+// the sum of squares and sum(n * ln n) over the counts. Blocks of counts
+// below 2048 read n * ln n from a table; other blocks use fast_log. Counts
+// must be >= 0.
+DiversityIndices calculate_diversity(const int* counts, size_t species);
+
+inline DiversityIndices calculate_diversity(const std::vector<int>& species_data) {
+    return calculate_diversity(species_data.data(), species_data.size());
+}
+
+// Same indices computed term by term with std::log; the accuracy reference
+DiversityIndices calculate_diversity_reference(const int* counts, size_t species);
+
+// Indices from the accumulated sums: total, sum(n^2) and sum(n * ln n)
+DiversityIndices diversity_from_sums(double total, double sum_squares, double sum_n_log_n);
+
+#endif // DIVERSITY_KERNELS_H
@@ -0,0 +1,183 @@
+#include "IncrementalDiversity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// First entry whose species is not below `species`
+template <typename Entries>
+auto find_species(Entries& entries, int species) {
+    return std::lower_bound(entries.begin(), entries.end(), species,
+                            [](const SpeciesCount& entry, int value) { return entry.species < value; });
+}
+
+double n_log_n(long long n) {
+    return n > 0 ? n * std::log(static_cast<double>(n)) : 0.0;
+}
+
+} // namespace
+
+void IncrementalDiversity::CompensatedSum::add(double value) {
+    double next = sum + value;
+    if (std::fabs(sum) >= std::fabs(value)) {
+        compensation += (sum - next) + value;
+    } else {
+        compensation += (value - next) + sum;
+    }
+    sum = next;
+}
+
+IncrementalDiversity::IncrementalDiversity(int first_site, int num_sites, int num_species)
+    : first(first_site), species_count(num_species), sites(num_sites), occupancy(num_species, 0) {}
+
+void IncrementalDiversity::load(const SparseSpeciesMatrix& rows) {
+    // Checked before anything is reset, so a bad row leaves the engine as it was
+    for (int i = 0; i < rows.num_sites() && i < num_sites(); i++) {
+        for (SpeciesCount entry : rows.row(i)) {
+            if (entry.species < 0 || entry.species >= species_count) {
+                throw std::out_of_range("row for site " + std::to_string(first + i) + " has species " +
+                                        std::to_string(entry.species) + ", outside this engine");
+            }
+        }
+    }
+
+    sites.assign(sites.size(), SiteStatistics());
+    occupancy.assign(species_count, 0);
+    abundance = 0;
+    shannon_sum = CompensatedSum();
+    simpson_sum = CompensatedSum();
+
+    for (int i = 0; i < rows.num_sites() && i < num_sites(); i++) {
+        SiteStatistics& statistics = sites[i];
+        SparseRow row = rows.row(i);
+        statistics.entries.reserve(row.size());
+        for (SpeciesCount entry : row) {
+            if (entry.count <= 0) {
+                continue;
+            }
+            statistics.entries.push_back(entry);
+            statistics.total += entry.count;
+            statistics.sum_squares += static_cast<long long>(entry.count) * entry.count;
+            statistics.sum_n_log_n += n_log_n(entry.count);
+            occupancy[entry.species]++;
+        }
+        DiversityIndices indices = site_indices(first + i);
+        abundance += statistics.total;
+        shannon_sum.add(indices.shannon);
+        simpson_sum.add(indices.simpson);
+    }
+    species_observed = 0;
+    for (int sites_holding : occupancy) {
+        species_observed += sites_holding > 0;
+    }
+}
+
+void IncrementalDiversity::apply(const Observation* observations, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const Observation& observation = observations[i];
+        if (observation.site < first || observation.site >= first + num_sites() || observation.species < 0 ||
+            observation.species >= species_count) {
+            throw std::out_of_range("observation for site " + std::to_string(observation.site) + ", species " +
+                                    std::to_string(observation.species) + " is outside this engine");
+        }
+        long long updated = static_cast<long long>(this->count(observation.site, observation.species)) +
+                            observation.delta;
+        if (updated < 0) {
+            throw std::invalid_argument("correction would make the count of species " +
+                                        std::to_string(observation.species) + " at site " +
+                                        std::to_string(observation.site) + " negative");
+        }
+        if (updated > std::numeric_limits<int>::max()) {
+            throw std::invalid_argument("observation would overflow the count of species " +
+                                        std::to_string(observation.species) + " at site " +
+                                        std::to_string(observation.site));
+        }
+        set_count(observation.site, observation.species, static_cast<int>(updated));
+    }
+}
+
+void IncrementalDiversity::set_count(int site, int species, int value) {
+    SiteStatistics& statistics = sites[site - first];
+    auto found = find_species(statistics.entries, species);
+    bool present = found != statistics.entries.end() && found->species == species;
+    long long old_value = present ? found->count : 0;
+    if (old_value == value) {
+        return;
+    }
+    DiversityIndices before = diversity_from_sums(statistics.total, statistics.sum_squares, statistics.sum_n_log_n);
+
+    statistics.total += value - old_value;
+    statistics.sum_squares += static_cast<long long>(value) * value - old_value * old_value;
+    statistics.sum_n_log_n += n_log_n(value) - n_log_n(old_value);
+    if (statistics.total == 0) {
+        // Clears the rounding left behind once every count is gone
+        statistics.sum_n_log_n = 0.0;
+    }
+    DiversityIndices after = diversity_from_sums(statistics.total, statistics.sum_squares, statistics.sum_n_log_n);
+
+    abundance += value - old_value;
+    shannon_sum.add(after.shannon - before.shannon);
+    simpson_sum.add(after.simpson - before.simpson);
+
+    if (value == 0) {
+        statistics.entries.erase(found);
+        if (--occupancy[species] == 0) {
+            species_observed--;
+        }
+    } else if (!present) {
+        statistics.entries.insert(found, SpeciesCount{species, value});
+        if (occupancy[species]++ == 0) {
+            species_observed++;
+        }
+    } else {
+        found->count = value;
+    }
+}
+
+int IncrementalDiversity::count(int site, int species) const {
+    const std::vector<SpeciesCount>& entries = sites[site - first].entries;
+    auto found = find_species(entries, species);
+    return found != entries.end() && found->species == species ? found->count : 0;
+}
+
+DiversityIndices IncrementalDiversity::site_indices(int site) const {
+    const SiteStatistics& statistics = sites[site - first];
+    return diversity_from_sums(statistics.total, statistics.sum_squares, statistics.sum_n_log_n);
+}
+
+DiversitySummary IncrementalDiversity::local_summary() const {
+    DiversitySummary summary;
+    summary.sites = num_sites();
+    summary.abundance = abundance;
+    if (summary.sites > 0) {
+        summary.mean_shannon = shannon_sum.value() / summary.sites;
+        summary.mean_simpson = simpson_sum.value() / summary.sites;
+    }
+    summary.species_observed = species_observed;
+    return summary;
+}
+
+DiversitySummary IncrementalDiversity::global_summary(MPI_Comm comm) const {
+    double local[4] = {static_cast<double>(num_sites()), static_cast<double>(abundance), shannon_sum.value(),
+                       simpson_sum.value()};
+    double global[4];
+    MPI_Allreduce(local, global, 4, MPI_DOUBLE, MPI_SUM, comm);
+    std::vector<int> all_occupancy(species_count);
+    MPI_Allreduce(occupancy.data(), all_occupancy.data(), species_count, MPI_INT, MPI_SUM, comm);
+
+    DiversitySummary summary;
+    summary.sites = static_cast<long long>(global[0]);
+    summary.abundance = global[1];
+    if (summary.sites > 0) {
+        summary.mean_shannon = global[2] / summary.sites;
+        summary.mean_simpson = global[3] / summary.sites;
+    }
+    for (int sites_holding : all_occupancy) {
+        summary.species_observed += sites_holding > 0;
+    }
+    return summary;
+}
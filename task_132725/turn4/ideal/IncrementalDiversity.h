@@ -0,0 +1,96 @@
+#ifndef INCREMENTAL_DIVERSITY_H
+#define INCREMENTAL_DIVERSITY_H
+
+#include <cstddef>
+#include <vector>
+#include <mpi.h>
+
+#include "DiversityKernels.h"
+#include "SparseSpeciesMatrix.h"
+
+// A change to one count: new observations add, corrections subtract
+struct Observation {
+    int site;
+    int species;
+    int delta;
+};
+
+// Totals over every site, as a dashboard shows them
+struct DiversitySummary {
+    long long sites = 0;
+    double abundance = 0.0;
+    double mean_shannon = 0.0;
+    double mean_simpson = 0.0;
+    long long species_observed = 0;  // species present at one site or more
+};
+
+// Keeps each site's sufficient statistics (total, sum(n^2), sum(n * ln n))
+// next to its counts. A change to one count costs a binary search in that
+// site's entries, after which the site's Shannon and Simpson indices, and the
+// sums over all sites, are updated in constant time. A batch therefore costs
+// O(changed counts), however many sites there are. The engine holds the
+// contiguous range of sites [first_site, first_site + num_sites), so ranks can
+// each own the sites of a RowPartition.
+class IncrementalDiversity {
+public:
+    IncrementalDiversity(int first_site, int num_sites, int num_species);
+
+    // Sets the engine's sites from `rows`, whose row i is site first_site + i.
+    // Throws std::out_of_range, leaving the engine unchanged, if a row holds an
+    // unknown species.
+    void load(const SparseSpeciesMatrix& rows);
+
+    // Applies a batch of changes to sites this engine holds. Throws
+    // std::out_of_range for a site it does not hold or an unknown species, and
+    // std::invalid_argument for a change that would make a count negative or
+    // overflow an int; the changes before the bad one stay applied.
+    void apply(const Observation* observations, size_t count);
+
+    void apply(const std::vector<Observation>& observations) { apply(observations.data(), observations.size()); }
+
+    int count(int site, int species) const;
+    DiversityIndices site_indices(int site) const;
+
+    // Sums over this engine's sites, without recomputing anything
+    DiversitySummary local_summary() const;
+
+    // Collective: sums over every rank's sites; one small MPI_Allreduce plus
+    // one over per-species occupancy
+    DiversitySummary global_summary(MPI_Comm comm) const;
+
+    int first_site() const { return first; }
+    int num_sites() const { return static_cast<int>(sites.size()); }
+    int num_species() const { return species_count; }
+
+private:
+    struct SiteStatistics {
+        std::vector<SpeciesCount> entries;  // non-zero counts in increasing species order
+        long long total = 0;
+        long long sum_squares = 0;
+        double sum_n_log_n = 0.0;
+    };
+
+    // Neumaier-compensated sum, so millions of add-and-subtract updates to
+    // the index totals do not drift away from a fresh sum
+    struct CompensatedSum {
+        double sum = 0.0;
+        double compensation = 0.0;
+
+        void add(double value);
+        double value() const { return sum + compensation; }
+    };
+
+    void set_count(int site, int species, int value);
+
+    int first;
+    int species_count;
+    std::vector<SiteStatistics> sites;
+
+    long long abundance = 0;
+    CompensatedSum shannon_sum;
+    CompensatedSum simpson_sum;
+    std::vector<int> occupancy;               // sites holding each species
+    long long species_observed = 0;
+};
+
+#endif // INCREMENTAL_DIVERSITY_H
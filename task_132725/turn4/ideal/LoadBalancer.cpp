@@ -0,0 +1,292 @@
+#include "LoadBalancer.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// The balancer and worker the calling thread belongs to, if any
+thread_local const LoadBalancer* current_balancer = nullptr;
+thread_local size_t current_worker = 0;
+
+// Workers move this many externally added tasks to their own deque at a time
+const size_t injected_batch = 32;
+
+// Range tasks are split until they cost at most the queued cost over this many
+// tasks per worker
+const double split_tasks_per_worker = 4.0;
+
+// A kind's estimate averages its first runs, then follows its recent ones
+const double min_runtime_weight = 0.125;
+
+uint64_t next_random(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+} // namespace
+
+LoadBalancer::LoadBalancer(size_t num_threads, SchedulingMode mode) : mode(mode) {
+    size_t count = num_threads > 0 ? num_threads : 1;
+    for (size_t i = 0; i < count; i++) {
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->random_state = 0x9E3779B97F4A7C15ULL * (i + 1);
+    }
+}
+
+LoadBalancer::~LoadBalancer() {
+    if (started && !stop.load()) {
+        try {
+            stopWorkers();
+        } catch (...) {
+        }
+    }
+    for (Job* job : injected) {
+        delete job;
+    }
+    for (Job* job : ranked) {
+        delete job;
+    }
+}
+
+void LoadBalancer::start() {
+    started = true;
+    stop.store(false);
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->thread = std::thread([this, i] { runWorker(i); });
+    }
+}
+
+void LoadBalancer::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stop.store(true);
+    }
+    condition.notify_all();
+    for (std::unique_ptr<Worker>& worker : workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    if (first_error) {
+        std::exception_ptr error = first_error;
+        first_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void LoadBalancer::submit(Job* job) {
+    pending.fetch_add(1);
+    if (current_balancer == this) {
+        workers[current_worker]->deque.push(job);
+    } else {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        injected.push_back(job);
+        injected_count.fetch_add(1);
+    }
+    wakeSleeper();
+}
+
+void LoadBalancer::submitCosted(Job* job) {
+    if (mode != SchedulingMode::LargestFirst) {
+        submit(job);
+        return;
+    }
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        ranked.push_back(job);
+        std::push_heap(ranked.begin(), ranked.end(), [](Job* a, Job* b) { return a->cost < b->cost; });
+        ranked_cost += job->cost;
+        ranked_count.store(ranked.size());
+    }
+    wakeSleeper();
+}
+
+LoadBalancer::Job* LoadBalancer::takeCostliest() {
+    auto by_cost = [](Job* a, Job* b) { return a->cost < b->cost; };
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if (ranked.empty()) {
+        return nullptr;
+    }
+    double limit = ranked_cost / (split_tasks_per_worker * workers.size());
+    std::pop_heap(ranked.begin(), ranked.end(), by_cost);
+    Job* job = ranked.back();
+    ranked.pop_back();
+    ranked_cost -= job->cost;
+    while (job->cost > limit) {
+        Job* upper = job->split();
+        if (!upper) {
+            break;
+        }
+        pending.fetch_add(1);
+        ranked.push_back(upper);
+        std::push_heap(ranked.begin(), ranked.end(), by_cost);
+        ranked_cost += upper->cost;
+    }
+    if (ranked.empty()) {
+        ranked_cost = 0.0; // drop accumulated rounding
+    }
+    ranked_count.store(ranked.size());
+    return job;
+}
+
+double LoadBalancer::costEstimate(TaskKind kind) const {
+    std::lock_guard<std::mutex> lock(kind_mutex);
+    if (kind.id < kind_runtimes.size() && kind_runtimes[kind.id].samples > 0) {
+        return kind_runtimes[kind.id].seconds;
+    }
+    double largest = 0.0;
+    for (const KindRuntime& runtime : kind_runtimes) {
+        largest = std::max(largest, runtime.seconds);
+    }
+    return largest;
+}
+
+void LoadBalancer::recordRuntime(size_t kind, double seconds) {
+    std::lock_guard<std::mutex> lock(kind_mutex);
+    if (kind >= kind_runtimes.size()) {
+        kind_runtimes.resize(kind + 1);
+    }
+    KindRuntime& runtime = kind_runtimes[kind];
+    runtime.samples++;
+    double weight = std::max(min_runtime_weight, 1.0 / runtime.samples);
+    runtime.seconds += weight * (seconds - runtime.seconds);
+}
+
+void LoadBalancer::wakeSleeper() {
+    // Pairs with the sleeper raising `sleeping` before checking for work: one
+    // of the two sees the other, so work is never left with everyone asleep
+    // Workers still spinning will find the task themselves
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (searching.load() == 0 && sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        condition.notify_one();
+    }
+}
+
+bool LoadBalancer::hasVisibleWork() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (injected_count.load() > 0 || ranked_count.load() > 0) {
+        return true;
+    }
+    for (const std::unique_ptr<Worker>& worker : workers) {
+        if (!worker->deque.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+LoadBalancer::Job* LoadBalancer::findJob(size_t index) {
+    Worker& self = *workers[index];
+    // Costed tasks come first, ahead of this worker's own deque, which holds
+    // uncosted tasks added from tasks and batches moved over from the shared
+    // queue; ranked is only ever filled in LargestFirst mode
+    if (ranked_count.load(std::memory_order_relaxed) > 0) {
+        if (Job* job = takeCostliest()) {
+            return job;
+        }
+    }
+
+    if (Job* job = self.deque.pop()) {
+        return job;
+    }
+
+    if (injected_count.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        size_t take = std::min(injected_batch, injected.size());
+        if (take > 0) {
+            Job* first = injected.front();
+            injected.pop_front();
+            for (size_t i = 1; i < take; i++) {
+                self.deque.push(injected.front());
+                injected.pop_front();
+            }
+            injected_count.fetch_sub(take);
+            return first;
+        }
+    }
+
+    size_t count = workers.size();
+    for (size_t attempt = 0; attempt < 2 * count && count > 1; attempt++) {
+        size_t victim = next_random(self.random_state) % count;
+        if (victim == index) {
+            continue;
+        }
+        if (Job* job = workers[victim]->deque.steal()) {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void LoadBalancer::finishJob() {
+    if (pending.fetch_sub(1) == 1 && stop.load()) {
+        // The last task is done; let the sleepers see it and exit
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        condition.notify_all();
+    }
+}
+
+void LoadBalancer::runWorker(size_t index) {
+    current_balancer = this;
+    current_worker = index;
+    bool is_searching = false;
+    int idle_rounds = 0;
+    for (;;) {
+        if (Job* job = findJob(index)) {
+            if (is_searching) {
+                // The last spinning worker found work; if more is waiting, hand
+                // the search on to a sleeper
+                is_searching = false;
+                if (searching.fetch_sub(1) == 1 && hasVisibleWork()) {
+                    wakeSleeper();
+                }
+            }
+            try {
+                if (job->kind != no_kind) {
+                    auto started_at = std::chrono::steady_clock::now();
+                    job->run();
+                    recordRuntime(job->kind,
+                                  std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count());
+                } else {
+                    job->run();
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error) {
+                    first_error = std::current_exception();
+                }
+            }
+            delete job;
+            finishJob();
+            continue;
+        }
+        if (stop.load() && pending.load() == 0) {
+            break;
+        }
+        // Spin briefly, as work often turns up within microseconds, then sleep
+        if (!is_searching) {
+            is_searching = true;
+            searching.fetch_add(1);
+            idle_rounds = 0;
+        }
+        if (++idle_rounds < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+        is_searching = false;
+        searching.fetch_sub(1);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleeping.fetch_add(1);
+        condition.wait(lock, [this] { return hasVisibleWork() || (stop.load() && pending.load() == 0); });
+        sleeping.fetch_sub(1);
+    }
+    if (is_searching) {
+        searching.fetch_sub(1);
+    }
+    current_balancer = nullptr;
+}
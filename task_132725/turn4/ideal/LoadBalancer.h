@@ -0,0 +1,284 @@
+#ifndef LOAD_BALANCER_H
+#define LOAD_BALANCER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Chase-Lev work-stealing deque, with the C11 memory orderings of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP'13).
+// The owning thread pushes and pops at the bottom without locking; any other
+// thread may steal from the top. The ring grows when full; outgrown rings are
+// kept until the deque is destroyed, since a thief may still be reading one.
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(int64_t capacity = 1024) {
+        rings.push_back(std::make_unique<Ring>(capacity));
+        ring.store(rings.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only
+    void push(T* item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Ring* current = ring.load(std::memory_order_relaxed);
+        if (b - t > current->capacity - 1) {
+            current = grow(current, t, b);
+        }
+        current->put(b, item);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only; newest first. Returns nullptr when empty.
+    T* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Ring* current = ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = current->get(b);
+        if (t == b) {
+            // Last item: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread; oldest first. Returns nullptr when empty or when another thread won the item.
+    T* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        T* item = ring.load(std::memory_order_acquire)->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    bool empty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring {
+        explicit Ring(int64_t capacity) : capacity(capacity), slots(new std::atomic<T*>[capacity]) {}
+
+        T* get(int64_t index) const { return slots[index & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t index, T* item) { slots[index & (capacity - 1)].store(item, std::memory_order_relaxed); }
+
+        int64_t capacity; // power of two
+        std::unique_ptr<std::atomic<T*>[]> slots;
+    };
+
+    Ring* grow(Ring* current, int64_t t, int64_t b) {
+        rings.push_back(std::make_unique<Ring>(current->capacity * 2));
+        Ring* bigger = rings.back().get();
+        for (int64_t i = t; i < b; i++) {
+            bigger->put(i, current->get(i));
+        }
+        ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<Ring*> ring{nullptr};
+    std::vector<std::unique_ptr<Ring>> rings; // touched by the owner only
+};
+
+// Thread pool that balances tasks by work stealing. Each worker runs tasks
+// from its own deque, newest first, and when that is empty takes a batch from
+// the shared queue of tasks added from outside, then tries random victims'
+// deques. Tasks may add more tasks; from a worker thread these go straight
+// onto that worker's deque, with no lock. Tasks may be added before start(),
+// and the pool may be started again after stopWorkers().
+//
+// Tasks may carry a cost. In LargestFirst mode costed tasks wait in a shared
+// heap and each free worker takes the costliest, so long tasks start early
+// instead of trailing at the end. A range task whose cost exceeds a quarter
+// of an even share of the queued cost is split into sub-ranges on the way out.
+// Tasks without a cost run once no costed task is waiting. Costs are ignored
+// in WorkStealing mode.
+enum class SchedulingMode {
+    WorkStealing,
+    LargestFirst
+};
+
+// Tasks of one kind have similar runtimes; the balancer estimates a kind's
+// cost from the runtimes of its earlier tasks
+struct TaskKind {
+    size_t id;
+};
+
+class LoadBalancer {
+public:
+    explicit LoadBalancer(size_t num_threads, SchedulingMode mode = SchedulingMode::WorkStealing);
+    ~LoadBalancer();
+
+    LoadBalancer(const LoadBalancer&) = delete;
+    LoadBalancer& operator=(const LoadBalancer&) = delete;
+
+    template <typename TaskType>
+    void addTask(TaskType&& task) {
+        submit(new CallableJob<typename std::decay<TaskType>::type>(std::forward<TaskType>(task)));
+    }
+
+    // `cost` is an estimate in any unit, as long as all tasks use the same one
+    template <typename TaskType>
+    void addTask(TaskType&& task, double cost) {
+        Job* job = new CallableJob<typename std::decay<TaskType>::type>(std::forward<TaskType>(task));
+        job->cost = cost;
+        submitCosted(job);
+    }
+
+    // Costed by costEstimate(kind), in seconds; the task's runtime refines the estimate
+    template <typename TaskType>
+    void addTask(TaskKind kind, TaskType&& task) {
+        Job* job = new CallableJob<typename std::decay<TaskType>::type>(std::forward<TaskType>(task));
+        job->cost = costEstimate(kind);
+        job->kind = kind.id;
+        submitCosted(job);
+    }
+
+    // Runs task(first, last) over [begin, end), which costs `cost` in all. In
+    // LargestFirst mode it may run as several calls on disjoint sub-ranges,
+    // concurrently, so the task must be copyable and safe to run that way.
+    template <typename TaskType>
+    void addRangeTask(size_t begin, size_t end, double cost, TaskType&& task) {
+        Job* job = new RangeJob<typename std::decay<TaskType>::type>(std::forward<TaskType>(task), begin, end);
+        job->cost = cost;
+        submitCosted(job);
+    }
+
+    // Mean recent runtime of the kind's tasks in seconds. A kind with no
+    // finished tasks yet gets the largest estimate of any kind, so it is
+    // scheduled early and measured soon.
+    double costEstimate(TaskKind kind) const;
+
+    void start();
+
+    // Waits for every task, including those added by tasks, then joins the
+    // workers. Rethrows the first exception a task threw, if any.
+    void stopWorkers();
+
+    size_t workerCount() const { return workers.size(); }
+
+private:
+    static const size_t no_kind = static_cast<size_t>(-1);
+
+    // One allocation per task, holding the callable itself
+    struct Job {
+        virtual ~Job() = default;
+        virtual void run() = 0;
+
+        // Range tasks move their upper half into a new job and return it
+        virtual Job* split() { return nullptr; }
+
+        double cost = 0.0;
+        size_t kind = no_kind;
+    };
+
+    template <typename Callable>
+    struct CallableJob : Job {
+        explicit CallableJob(Callable&& callable) : callable(std::move(callable)) {}
+        explicit CallableJob(const Callable& callable) : callable(callable) {}
+        void run() override { callable(); }
+        Callable callable;
+    };
+
+    template <typename Callable>
+    struct RangeJob : Job {
+        template <typename C>
+        RangeJob(C&& callable, size_t begin, size_t end) : callable(std::forward<C>(callable)), begin(begin), end(end) {}
+        void run() override { callable(begin, end); }
+
+        Job* split() override {
+            if (end - begin < 2) {
+                return nullptr;
+            }
+            size_t middle = begin + (end - begin) / 2;
+            RangeJob* upper = new RangeJob(callable, middle, end);
+            upper->cost = cost * (end - middle) / (end - begin);
+            cost -= upper->cost;
+            end = middle;
+            return upper;
+        }
+
+        Callable callable;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Worker {
+        WorkStealingDeque<Job> deque;
+        uint64_t random_state = 0;
+        std::thread thread;
+    };
+
+    void submit(Job* job);
+    void submitCosted(Job* job);
+    Job* takeCostliest();
+    void recordRuntime(size_t kind, double seconds);
+    void runWorker(size_t index);
+    Job* findJob(size_t index);
+    void finishJob();
+    bool hasVisibleWork() const;
+    void wakeSleeper();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Tasks added from outside the workers; workers take them in batches
+    std::mutex queue_mutex;
+    std::deque<Job*> injected;
+    std::atomic<size_t> injected_count{0};
+
+    // LargestFirst: costed tasks in a max-heap by cost, with their total cost
+    SchedulingMode mode;
+    std::vector<Job*> ranked;
+    double ranked_cost = 0.0;
+    std::atomic<size_t> ranked_count{0};
+
+    // Per kind id: mean recent runtime and how many runs it covers
+    struct KindRuntime {
+        double seconds = 0.0;
+        size_t samples = 0;
+    };
+    mutable std::mutex kind_mutex;
+    std::vector<KindRuntime> kind_runtimes;
+
+    std::atomic<size_t> pending{0}; // added and not yet finished
+    std::atomic<bool> stop{false};
+    bool started = false;
+
+    std::mutex sleep_mutex;
+    std::condition_variable condition;
+    std::atomic<int> sleeping{0};
+    std::atomic<int> searching{0}; // idle workers still spinning for work
+
+    std::mutex error_mutex;
+    std::exception_ptr first_error;
+};
+
+#endif // LOAD_BALANCER_H
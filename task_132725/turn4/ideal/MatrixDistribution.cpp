@@ -0,0 +1,317 @@
+#include "MatrixDistribution.h"
+
+#include <algorithm>
+#include <utility>
+
+RowPartition partition_rows(int num_sites, int ranks) {
+    RowPartition partition;
+    partition.first.resize(ranks + 1);
+    int per_rank = num_sites / ranks;
+    int remainder = num_sites % ranks;
+    for (int rank = 0; rank <= ranks; rank++) {
+        partition.first[rank] = rank * per_rank + std::min(rank, remainder);
+    }
+    return partition;
+}
+
+SpeciesMatrix scatter_rows(const SpeciesMatrix& matrix, const RowPartition& partition, int root, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Row lengths first, so every rank can lay out its block before the values arrive
+    std::vector<int> all_lengths;
+    if (rank == root) {
+        all_lengths.resize(matrix.num_sites());
+        for (int site = 0; site < matrix.num_sites(); site++) {
+            all_lengths[site] = matrix.row_length(site);
+        }
+    }
+    std::vector<int> row_counts(size);
+    std::vector<int> row_displacements(size);
+    for (int r = 0; r < size; r++) {
+        row_counts[r] = partition.count(r);
+        row_displacements[r] = partition.begin(r);
+    }
+    std::vector<int> lengths(partition.count(rank));
+    MPI_Scatterv(all_lengths.data(), row_counts.data(), row_displacements.data(), MPI_INT,
+                 lengths.data(), static_cast<int>(lengths.size()), MPI_INT, root, comm);
+
+    // Value counts and displacements come from the root's row offsets
+    std::vector<int> value_counts(size);
+    std::vector<int> value_displacements(size);
+    if (rank == root) {
+        const std::vector<size_t>& offsets = matrix.row_offsets();
+        for (int r = 0; r < size; r++) {
+            value_displacements[r] = static_cast<int>(offsets[partition.begin(r)]);
+            value_counts[r] = static_cast<int>(offsets[partition.end(r)] - offsets[partition.begin(r)]);
+        }
+    }
+    SpeciesMatrix local(lengths);
+    MPI_Scatterv(matrix.data(), value_counts.data(), value_displacements.data(), MPI_INT,
+                 local.data(), static_cast<int>(local.num_values()), MPI_INT, root, comm);
+    return local;
+}
+
+SparseSpeciesMatrix scatter_rows(const SparseSpeciesMatrix& matrix, const RowPartition& partition, int root,
+                                 MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    int num_species = matrix.num_species();
+    MPI_Bcast(&num_species, 1, MPI_INT, root, comm);
+
+    // Non-zeros per row, then the entries themselves
+    std::vector<int> all_lengths;
+    std::vector<int> value_counts(size);
+    std::vector<int> value_displacements(size);
+    if (rank == root) {
+        const std::vector<size_t>& offsets = matrix.row_offsets();
+        all_lengths.resize(matrix.num_sites());
+        for (int site = 0; site < matrix.num_sites(); site++) {
+            all_lengths[site] = static_cast<int>(offsets[site + 1] - offsets[site]);
+        }
+        for (int r = 0; r < size; r++) {
+            value_displacements[r] = static_cast<int>(offsets[partition.begin(r)]);
+            value_counts[r] = static_cast<int>(offsets[partition.end(r)] - offsets[partition.begin(r)]);
+        }
+    }
+    std::vector<int> row_counts(size);
+    std::vector<int> row_displacements(size);
+    for (int r = 0; r < size; r++) {
+        row_counts[r] = partition.count(r);
+        row_displacements[r] = partition.begin(r);
+    }
+    std::vector<int> lengths(partition.count(rank));
+    MPI_Scatterv(all_lengths.data(), row_counts.data(), row_displacements.data(), MPI_INT,
+                 lengths.data(), static_cast<int>(lengths.size()), MPI_INT, root, comm);
+
+    size_t nonzeros = 0;
+    for (int length : lengths) {
+        nonzeros += length;
+    }
+    std::vector<int> species(nonzeros);
+    std::vector<int> counts(nonzeros);
+    MPI_Scatterv(matrix.species_data(), value_counts.data(), value_displacements.data(), MPI_INT,
+                 species.data(), static_cast<int>(nonzeros), MPI_INT, root, comm);
+    MPI_Scatterv(matrix.count_data(), value_counts.data(), value_displacements.data(), MPI_INT,
+                 counts.data(), static_cast<int>(nonzeros), MPI_INT, root, comm);
+
+    SparseSpeciesMatrix local(num_species);
+    size_t offset = 0;
+    for (int length : lengths) {
+        local.append_row(species.data() + offset, counts.data() + offset, length);
+        offset += length;
+    }
+    return local;
+}
+
+void broadcast_rows(SparseSpeciesMatrix& matrix, int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    unsigned long long shape[3] = {static_cast<unsigned long long>(matrix.num_sites()),
+                                   static_cast<unsigned long long>(matrix.num_species()), matrix.num_nonzeros()};
+    MPI_Bcast(shape, 3, MPI_UNSIGNED_LONG_LONG, root, comm);
+    if (rank == root) {
+        MPI_Bcast(const_cast<size_t*>(matrix.row_offsets().data()), static_cast<int>(shape[0] + 1), MPI_UINT64_T,
+                  root, comm);
+        MPI_Bcast(const_cast<int*>(matrix.species_data()), static_cast<int>(shape[2]), MPI_INT, root, comm);
+        MPI_Bcast(const_cast<int*>(matrix.count_data()), static_cast<int>(shape[2]), MPI_INT, root, comm);
+        return;
+    }
+    std::vector<size_t> offsets(shape[0] + 1);
+    std::vector<int> species(shape[2]);
+    std::vector<int> counts(shape[2]);
+    MPI_Bcast(offsets.data(), static_cast<int>(offsets.size()), MPI_UINT64_T, root, comm);
+    MPI_Bcast(species.data(), static_cast<int>(species.size()), MPI_INT, root, comm);
+    MPI_Bcast(counts.data(), static_cast<int>(counts.size()), MPI_INT, root, comm);
+    matrix = SparseSpeciesMatrix(static_cast<int>(shape[1]), std::move(offsets), std::move(species),
+                                 std::move(counts));
+}
+
+static_assert(sizeof(size_t) == sizeof(uint64_t), "row offsets are exposed as MPI_UINT64_T");
+
+RemoteSparseMatrix::RemoteSparseMatrix(const SparseSpeciesMatrix& matrix, int root, MPI_Comm comm) : root(root) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    if (size == 1) {
+        // Open MPI picks a one-sided component that cannot attach existing
+        // memory when there is a single process, and no windows are needed
+        local = &matrix;
+        sites = matrix.num_sites();
+        species = matrix.num_species();
+        return;
+    }
+    int shape[2] = {matrix.num_sites(), matrix.num_species()};
+    MPI_Bcast(shape, 2, MPI_INT, root, comm);
+    sites = shape[0];
+    species = shape[1];
+
+    // Only the root exposes memory; the windows are never written through
+    bool exposed = rank == root;
+    const std::vector<size_t>& row_offsets = matrix.row_offsets();
+    MPI_Win_create(exposed ? const_cast<size_t*>(row_offsets.data()) : nullptr,
+                   exposed ? row_offsets.size() * sizeof(size_t) : 0, sizeof(size_t), MPI_INFO_NULL, comm,
+                   &offsets_window);
+    MPI_Win_create(exposed ? const_cast<int*>(matrix.species_data()) : nullptr,
+                   exposed ? matrix.num_nonzeros() * sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, comm,
+                   &species_window);
+    MPI_Win_create(exposed ? const_cast<int*>(matrix.count_data()) : nullptr,
+                   exposed ? matrix.num_nonzeros() * sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, comm,
+                   &counts_window);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, offsets_window);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, species_window);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, counts_window);
+}
+
+RemoteSparseMatrix::~RemoteSparseMatrix() {
+    if (local) {
+        return;
+    }
+    MPI_Win_unlock_all(counts_window);
+    MPI_Win_unlock_all(species_window);
+    MPI_Win_unlock_all(offsets_window);
+    MPI_Win_free(&counts_window);
+    MPI_Win_free(&species_window);
+    MPI_Win_free(&offsets_window);
+}
+
+SparseSpeciesMatrix RemoteSparseMatrix::fetch_rows(int first, int last) {
+    SparseSpeciesMatrix rows(species);
+    if (first >= last) {
+        return rows;
+    }
+    if (local) {
+        for (int site = first; site < last; site++) {
+            SparseRow row = local->row(site);
+            rows.append_row(row.species(), row.counts(), row.size());
+        }
+        return rows;
+    }
+    // Row offsets first, to learn which entries to read
+    offsets.resize(last - first + 1);
+    MPI_Get(offsets.data(), static_cast<int>(offsets.size()), MPI_UINT64_T, root, first,
+            static_cast<int>(offsets.size()), MPI_UINT64_T, offsets_window);
+    MPI_Win_flush(root, offsets_window);
+
+    int nonzeros = static_cast<int>(offsets.back() - offsets.front());
+    species_buffer.resize(nonzeros);
+    counts_buffer.resize(nonzeros);
+    if (nonzeros > 0) {
+        MPI_Get(species_buffer.data(), nonzeros, MPI_INT, root, offsets.front(), nonzeros, MPI_INT, species_window);
+        MPI_Get(counts_buffer.data(), nonzeros, MPI_INT, root, offsets.front(), nonzeros, MPI_INT, counts_window);
+        MPI_Win_flush(root, species_window);
+        MPI_Win_flush(root, counts_window);
+    }
+
+    for (int site = 0; site < last - first; site++) {
+        size_t begin = offsets[site] - offsets.front();
+        rows.append_row(species_buffer.data() + begin, counts_buffer.data() + begin, offsets[site + 1] - offsets[site]);
+    }
+    return rows;
+}
+
+BlockStream::BlockStream(const SparseSpeciesMatrix& matrix, const RowPartition& partition, int block_sites,
+                         int root, MPI_Comm comm)
+    : matrix(matrix), partition(partition), comm(comm), root(root), block_sites(block_sites) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    num_species = matrix.num_species();
+    MPI_Bcast(&num_species, 1, MPI_INT, root, comm);
+
+    std::vector<int> all_lengths;
+    if (rank == root) {
+        const std::vector<size_t>& offsets = matrix.row_offsets();
+        all_lengths.resize(matrix.num_sites());
+        for (int site = 0; site < matrix.num_sites(); site++) {
+            all_lengths[site] = static_cast<int>(offsets[site + 1] - offsets[site]);
+        }
+    }
+    std::vector<int> row_counts(size);
+    std::vector<int> row_displacements(size);
+    int largest = 0;
+    for (int r = 0; r < size; r++) {
+        row_counts[r] = partition.count(r);
+        row_displacements[r] = partition.begin(r);
+        largest = std::max(largest, partition.count(r));
+    }
+    lengths.resize(partition.count(rank));
+    MPI_Scatterv(all_lengths.data(), row_counts.data(), row_displacements.data(), MPI_INT,
+                 lengths.data(), static_cast<int>(lengths.size()), MPI_INT, root, comm);
+    local_offsets.assign(lengths.size() + 1, 0);
+    for (size_t site = 0; site < lengths.size(); site++) {
+        local_offsets[site + 1] = local_offsets[site] + lengths[site];
+    }
+
+    rounds = (largest + block_sites - 1) / block_sites;
+    send_counts.resize(size);
+    send_displacements.resize(size);
+    if (rounds > 0) {
+        post(0);
+    }
+}
+
+BlockStream::~BlockStream() {
+    // Rounds that were posted but never taken still have to complete on every rank
+    for (Buffer& buffer : buffers) {
+        MPI_Waitall(2, buffer.requests, MPI_STATUSES_IGNORE);
+    }
+}
+
+int BlockStream::round_first(int r, int round) const {
+    return std::min(partition.end(r), partition.begin(r) + round * block_sites);
+}
+
+int BlockStream::round_last(int r, int round) const {
+    return std::min(partition.end(r), partition.begin(r) + (round + 1) * block_sites);
+}
+
+void BlockStream::post(int round) {
+    if (rank == root) {
+        const std::vector<size_t>& offsets = matrix.row_offsets();
+        for (int r = 0; r < size; r++) {
+            send_displacements[r] = static_cast<int>(offsets[round_first(r, round)]);
+            send_counts[r] = static_cast<int>(offsets[round_last(r, round)] - offsets[round_first(r, round)]);
+        }
+    }
+    int first = round_first(rank, round) - partition.begin(rank);
+    int last = round_last(rank, round) - partition.begin(rank);
+    int nonzeros = static_cast<int>(local_offsets[last] - local_offsets[first]);
+
+    Buffer& buffer = buffers[round % 2];
+    buffer.species.resize(nonzeros);
+    buffer.counts.resize(nonzeros);
+    MPI_Iscatterv(matrix.species_data(), send_counts.data(), send_displacements.data(), MPI_INT,
+                  buffer.species.data(), nonzeros, MPI_INT, root, comm, &buffer.requests[0]);
+    MPI_Iscatterv(matrix.count_data(), send_counts.data(), send_displacements.data(), MPI_INT,
+                  buffer.counts.data(), nonzeros, MPI_INT, root, comm, &buffer.requests[1]);
+}
+
+SparseSpeciesMatrix BlockStream::take(int round) {
+    Buffer& buffer = buffers[round % 2];
+    MPI_Waitall(2, buffer.requests, MPI_STATUSES_IGNORE);
+    // post() rewrites the root's send counts, which is only allowed once the
+    // round that used them has completed, as it just has
+    if (round + 1 < rounds) {
+        post(round + 1);
+    }
+
+    SparseSpeciesMatrix rows(num_species);
+    int first = round_first(rank, round) - partition.begin(rank);
+    int last = round_last(rank, round) - partition.begin(rank);
+    size_t offset = 0;
+    for (int site = first; site < last; site++) {
+        rows.append_row(buffer.species.data() + offset, buffer.counts.data() + offset, lengths[site]);
+        offset += lengths[site];
+    }
+    return rows;
+}
+
+void BlockStream::progress() {
+    int done;
+    for (Buffer& buffer : buffers) {
+        MPI_Testall(2, buffer.requests, &done, MPI_STATUSES_IGNORE);
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef MATRIX_DISTRIBUTION_H
+#define MATRIX_DISTRIBUTION_H
+
+#include <cstdint>
+#include <vector>
+#include <mpi.h>
+
+#include "SparseSpeciesMatrix.h"
+#include "SpeciesMatrix.h"
+
+// Contiguous block of sites owned by each rank: rank r owns [first[r], first[r + 1])
+struct RowPartition {
+    std::vector<int> first;
+
+    int begin(int rank) const { return first[rank]; }
+    int end(int rank) const { return first[rank + 1]; }
+    int count(int rank) const { return first[rank + 1] - first[rank]; }
+};
+
+// Splits num_sites as evenly as possible; the first num_sites % ranks ranks take one extra
+RowPartition partition_rows(int num_sites, int ranks);
+
+// Sends each rank its block of `matrix`, which only needs to be filled in on
+// `root`. Row lengths go out with one MPI_Scatterv and the counts with another,
+// straight from the matrix's flat buffer.
+SpeciesMatrix scatter_rows(const SpeciesMatrix& matrix, const RowPartition& partition, int root, MPI_Comm comm);
+
+// Same for a CSR matrix: only the non-zero entries travel, species indices and
+// counts in one MPI_Scatterv each
+SparseSpeciesMatrix scatter_rows(const SparseSpeciesMatrix& matrix, const RowPartition& partition, int root,
+                                 MPI_Comm comm);
+
+// Gives every rank a copy of `matrix` as held on `root`
+void broadcast_rows(SparseSpeciesMatrix& matrix, int root, MPI_Comm comm);
+
+// Streams each rank's block of a CSR matrix from `root` in rounds of
+// block_sites sites. Row lengths for the whole block are scattered up front;
+// after that every round's entries arrive by non-blocking MPI_Iscatterv, and
+// the next round is always in flight while the current one is processed.
+// Open MPI only advances non-blocking collectives inside MPI calls, so long
+// computations should call progress() now and then. Construction is collective,
+// and every rank must take the same number of rounds, in order.
+class BlockStream {
+public:
+    BlockStream(const SparseSpeciesMatrix& matrix, const RowPartition& partition, int block_sites, int root,
+                MPI_Comm comm);
+    ~BlockStream();
+
+    BlockStream(const BlockStream&) = delete;
+    BlockStream& operator=(const BlockStream&) = delete;
+
+    int num_rounds() const { return rounds; }
+
+    // Waits for round `round`, starts receiving the one after, and returns this rank's rows of it
+    SparseSpeciesMatrix take(int round);
+
+    void progress();
+
+private:
+    struct Buffer {
+        std::vector<int> species;
+        std::vector<int> counts;
+        MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    };
+
+    void post(int round);
+    int round_first(int rank, int round) const;
+    int round_last(int rank, int round) const;
+
+    const SparseSpeciesMatrix& matrix;
+    RowPartition partition;
+    MPI_Comm comm;
+    int root;
+    int rank = 0;
+    int size = 1;
+    int block_sites;
+    int rounds = 0;
+    int num_species = 0;
+    std::vector<int> lengths;               // non-zeros of each of this rank's sites
+    std::vector<size_t> local_offsets;      // prefix sums of lengths
+    std::vector<int> send_counts;           // root only, per round
+    std::vector<int> send_displacements;
+    Buffer buffers[2];
+};
+
+// Read-only view of a CSR matrix held on `root`, from which any rank can pull
+// a range of sites with one-sided MPI_Get calls. Lets ranks that schedule
+// their own work fetch rows without the root taking part. Construction and
+// destruction are collective; `matrix` must outlive the view.
+class RemoteSparseMatrix {
+public:
+    RemoteSparseMatrix(const SparseSpeciesMatrix& matrix, int root, MPI_Comm comm);
+    ~RemoteSparseMatrix();
+
+    RemoteSparseMatrix(const RemoteSparseMatrix&) = delete;
+    RemoteSparseMatrix& operator=(const RemoteSparseMatrix&) = delete;
+
+    int num_sites() const { return sites; }
+    int num_species() const { return species; }
+
+    // Copy of sites [first, last)
+    SparseSpeciesMatrix fetch_rows(int first, int last);
+
+private:
+    MPI_Win offsets_window = MPI_WIN_NULL;
+    MPI_Win species_window = MPI_WIN_NULL;
+    MPI_Win counts_window = MPI_WIN_NULL;
+    const SparseSpeciesMatrix* local = nullptr; // set instead of the windows when running on one rank
+    int root;
+    int sites = 0;
+    int species = 0;
+    std::vector<uint64_t> offsets;       // scratch for fetch_rows
+    std::vector<int> species_buffer;
+    std::vector<int> counts_buffer;
+};
+
+#endif // MATRIX_DISTRIBUTION_H
@@ -0,0 +1,412 @@
+#include "MatrixFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char matrix_magic[8] = {'S', 'P', 'E', 'C', 'M', 'A', 'T', '\0'};
+const uint32_t matrix_version = 1;
+
+MatrixFileHeader make_header(uint64_t num_sites, uint32_t num_species, uint64_t num_nonzeros) {
+    MatrixFileHeader header;
+    std::memcpy(header.magic, matrix_magic, sizeof(matrix_magic));
+    header.version = matrix_version;
+    header.num_species = num_species;
+    header.num_sites = num_sites;
+    header.num_nonzeros = num_nonzeros;
+    header.species_offset = sizeof(MatrixFileHeader);
+    header.counts_offset = header.species_offset + num_nonzeros * sizeof(int32_t);
+    header.rows_offset = header.counts_offset + num_nonzeros * sizeof(int32_t);
+    header.reserved = 0;
+    return header;
+}
+
+bool header_is_valid(const MatrixFileHeader& header) {
+    return std::memcmp(header.magic, matrix_magic, sizeof(matrix_magic)) == 0 && header.version == matrix_version;
+}
+
+// True when `count` elements of `size` bytes from `offset` lie inside the file
+bool section_fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t file_size) {
+    return offset % size == 0 && offset <= file_size && count <= (file_size - offset) / size;
+}
+
+// True when all three sections of the header's layout lie inside a file of `file_size` bytes
+bool layout_fits(const MatrixFileHeader& header, uint64_t file_size) {
+    return header.num_sites < static_cast<uint64_t>(std::numeric_limits<int>::max()) &&
+           header.num_species <= static_cast<uint32_t>(std::numeric_limits<int>::max()) &&
+           section_fits(header.species_offset, header.num_nonzeros, sizeof(int32_t), file_size) &&
+           section_fits(header.counts_offset, header.num_nonzeros, sizeof(int32_t), file_size) &&
+           section_fits(header.rows_offset, header.num_sites + 1, sizeof(uint64_t), file_size);
+}
+
+// True when `rows` never decreases and stays within the file's entries
+bool rows_are_valid(const uint64_t* rows, size_t count, uint64_t num_nonzeros) {
+    for (size_t i = 1; i < count; i++) {
+        if (rows[i] < rows[i - 1]) {
+            return false;
+        }
+    }
+    return rows[count - 1] <= num_nonzeros;
+}
+
+// True when every species id is in [0, num_species) and no count is negative
+bool entries_are_valid(const int* species, const int* counts, size_t count, uint32_t num_species) {
+    bool valid = true;
+    for (size_t i = 0; i < count; i++) {
+        valid &= static_cast<uint32_t>(species[i]) < num_species && counts[i] >= 0;
+    }
+    return valid;
+}
+
+// Collective: true on every rank when `ok` is true on all of them
+bool all_ranks_ok(bool ok, MPI_Comm comm) {
+    int local = ok ? 1 : 0;
+    int all = 0;
+    MPI_Allreduce(&local, &all, 1, MPI_INT, MPI_MIN, comm);
+    return all == 1;
+}
+
+// Leaves the file open on failure; the caller closes it and removes what it wrote
+void write_or_throw(std::FILE* file, const void* data, size_t bytes, const std::string& path) {
+    if (bytes > 0 && std::fwrite(data, 1, bytes, file) != bytes) {
+        throw std::runtime_error("failed writing " + path);
+    }
+}
+
+// Parses one non-negative decimal CSV field no larger than int32 can hold and
+// moves `cursor` past it; returns -1 when there is no such number
+long long parse_field(const char*& cursor) {
+    if (!std::isdigit(static_cast<unsigned char>(*cursor))) {
+        return -1;
+    }
+    char* end = nullptr;
+    errno = 0;
+    long long value = std::strtoll(cursor, &end, 10);
+    cursor = end;
+    return errno == ERANGE || value > std::numeric_limits<int32_t>::max() ? -1 : value;
+}
+
+// Only whitespace (including the '\r' of CRLF files) may follow the last field
+bool only_space_left(const char* cursor) {
+    while (std::isspace(static_cast<unsigned char>(*cursor))) {
+        cursor++;
+    }
+    return *cursor == '\0';
+}
+
+// MPI-IO counts are ints, so large ranges are read in pieces. Every rank has
+// to make the same number of collective calls, even with nothing left to read.
+// Returns false if any piece failed or came back short.
+bool read_at_all(MPI_File file, MPI_Offset offset, void* buffer, size_t count, MPI_Datatype type, size_t type_size,
+                 MPI_Comm comm) {
+    const size_t piece = size_t(1) << 28;
+    unsigned long long pieces = (count + piece - 1) / piece;
+    unsigned long long max_pieces = 0;
+    MPI_Allreduce(&pieces, &max_pieces, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm);
+    char* target = static_cast<char*>(buffer);
+    bool ok = true;
+    for (unsigned long long i = 0; i < max_pieces; i++) {
+        size_t done = std::min<size_t>(count, i * piece);
+        size_t length = std::min(piece, count - done);
+        MPI_Status status;
+        int received = 0;
+        if (MPI_File_read_at_all(file, offset + done * type_size, target + done * type_size, static_cast<int>(length),
+                                 type, &status) != MPI_SUCCESS ||
+            MPI_Get_count(&status, type, &received) != MPI_SUCCESS || received != static_cast<int>(length)) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+void write_matrix_file(const std::string& path, const SparseSpeciesMatrix& matrix) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("cannot create " + path);
+    }
+    MatrixFileHeader header = make_header(matrix.num_sites(), matrix.num_species(), matrix.num_nonzeros());
+    try {
+        write_or_throw(file, &header, sizeof(header), path);
+        write_or_throw(file, matrix.species_data(), matrix.num_nonzeros() * sizeof(int32_t), path);
+        write_or_throw(file, matrix.count_data(), matrix.num_nonzeros() * sizeof(int32_t), path);
+        write_or_throw(file, matrix.row_offsets().data(), matrix.row_offsets().size() * sizeof(uint64_t), path);
+    } catch (...) {
+        std::fclose(file);
+        std::remove(path.c_str());
+        throw;
+    }
+    if (std::fclose(file) != 0) {
+        std::remove(path.c_str());
+        throw std::runtime_error("failed writing " + path);
+    }
+}
+
+MatrixFileHeader convert_csv_to_matrix_file(const std::string& csv_path, const std::string& path) {
+    std::ifstream csv(csv_path);
+    if (!csv) {
+        throw std::runtime_error("cannot open " + csv_path);
+    }
+    // Species go straight into the output; counts wait in a side file until
+    // the number of entries, and so where the counts section starts, is known
+    std::string counts_path = path + ".counts";
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    std::FILE* counts_file = file ? std::fopen(counts_path.c_str(), "w+b") : nullptr;
+    if (!counts_file) {
+        if (file) {
+            std::fclose(file);
+            std::remove(path.c_str());
+        }
+        throw std::runtime_error("cannot create " + path);
+    }
+    // Neither file is left behind when the conversion fails part way
+    auto discard = [&]() {
+        if (file) {
+            std::fclose(file);
+        }
+        if (counts_file) {
+            std::fclose(counts_file);
+        }
+        std::remove(path.c_str());
+        std::remove(counts_path.c_str());
+    };
+    try {
+        MatrixFileHeader header = make_header(0, 0, 0);
+        write_or_throw(file, &header, sizeof(header), path);
+
+        std::vector<uint64_t> rows(1, 0);
+        std::vector<std::pair<int, int>> site_entries; // species, count of the site being read
+        std::vector<int> species_out;
+        std::vector<long long> counts_out;
+        std::vector<int> counts_written;
+        long long current_site = -1;
+        long long num_species = 0;
+
+        auto flush_site = [&]() {
+            std::sort(site_entries.begin(), site_entries.end());
+            species_out.clear();
+            counts_out.clear();
+            for (const std::pair<int, int>& entry : site_entries) {
+                if (!species_out.empty() && species_out.back() == entry.first) {
+                    counts_out.back() += entry.second;
+                } else {
+                    species_out.push_back(entry.first);
+                    counts_out.push_back(entry.second);
+                }
+            }
+            counts_written.clear();
+            for (long long count : counts_out) {
+                if (count > std::numeric_limits<int32_t>::max()) {
+                    throw std::runtime_error(csv_path + ": repeated records of site " + std::to_string(current_site) +
+                                             " add up to more than an int32 count");
+                }
+                counts_written.push_back(static_cast<int>(count));
+            }
+            write_or_throw(file, species_out.data(), species_out.size() * sizeof(int32_t), path);
+            write_or_throw(counts_file, counts_written.data(), counts_written.size() * sizeof(int32_t), counts_path);
+            rows.push_back(rows.back() + species_out.size());
+            site_entries.clear();
+        };
+
+        std::string line;
+        size_t line_number = 0;
+        while (std::getline(csv, line)) {
+            line_number++;
+            if (line.empty() || (line_number == 1 && !std::isdigit(static_cast<unsigned char>(line[0])))) {
+                continue;
+            }
+            const char* cursor = line.c_str();
+            long long site = parse_field(cursor);
+            long long species = site >= 0 && *cursor == ',' ? parse_field(++cursor) : -1;
+            long long count = species >= 0 && *cursor == ',' ? parse_field(++cursor) : -1;
+            if (count < 0 || !only_space_left(cursor)) {
+                throw std::runtime_error(csv_path + ":" + std::to_string(line_number) + ": expected site,species,count");
+            }
+            if (site < current_site) {
+                throw std::runtime_error(csv_path + ":" + std::to_string(line_number) +
+                                         ": records must be grouped by site in ascending order");
+            }
+            while (current_site < site) {
+                if (current_site >= 0) {
+                    flush_site();
+                }
+                current_site++;
+            }
+            // num_species is read back as an int, so the largest id must leave room for it
+            if (species >= std::numeric_limits<int32_t>::max()) {
+                throw std::runtime_error(csv_path + ":" + std::to_string(line_number) + ": species id too large");
+            }
+            num_species = std::max(num_species, species + 1);
+            if (count > 0) {
+                site_entries.emplace_back(static_cast<int>(species), static_cast<int>(count));
+            }
+        }
+        if (csv.bad()) {
+            throw std::runtime_error("failed reading " + csv_path);
+        }
+        if (current_site >= 0) {
+            flush_site();
+        }
+
+        // Append the counts, then the row index, then fill in the real header
+        header = make_header(rows.size() - 1, static_cast<uint32_t>(num_species), rows.back());
+        std::rewind(counts_file);
+        std::vector<char> buffer(1 << 20);
+        size_t bytes;
+        while ((bytes = std::fread(buffer.data(), 1, buffer.size(), counts_file)) > 0) {
+            write_or_throw(file, buffer.data(), bytes, path);
+        }
+        if (std::ferror(counts_file)) {
+            throw std::runtime_error("failed reading " + counts_path);
+        }
+        std::fclose(counts_file);
+        counts_file = nullptr;
+        std::remove(counts_path.c_str());
+        write_or_throw(file, rows.data(), rows.size() * sizeof(uint64_t), path);
+        std::rewind(file);
+        write_or_throw(file, &header, sizeof(header), path);
+        int closed = std::fclose(file);
+        file = nullptr;
+        if (closed != 0) {
+            throw std::runtime_error("failed writing " + path);
+        }
+        return header;
+    } catch (...) {
+        discard();
+        throw;
+    }
+}
+
+MatrixFileHeader read_matrix_header(const std::string& path, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MatrixFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    if (rank == 0) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file) {
+            if (std::fread(&header, sizeof(header), 1, file) != 1) {
+                std::memset(&header, 0, sizeof(header));
+            }
+            std::fclose(file);
+        }
+    }
+    MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, comm);
+    if (!header_is_valid(header)) {
+        throw std::runtime_error(path + " is not a species matrix file");
+    }
+    return header;
+}
+
+SparseSpeciesMatrix read_matrix_rows(const std::string& path, const MatrixFileHeader& header,
+                                     const RowPartition& partition, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_File file;
+    if (MPI_File_open(comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        throw std::runtime_error("cannot open " + path);
+    }
+
+    // Every rank sees the same size, so they all reject a bad layout together
+    MPI_Offset file_size = 0;
+    if (MPI_File_get_size(file, &file_size) != MPI_SUCCESS || !layout_fits(header, file_size)) {
+        MPI_File_close(&file);
+        throw std::runtime_error(path + " is truncated or its header is corrupt");
+    }
+
+    int first = partition.begin(rank);
+    int sites = partition.count(rank);
+    std::vector<uint64_t> rows(sites + 1);
+    bool ok = first >= 0 && sites >= 0 && static_cast<uint64_t>(first) + sites <= header.num_sites;
+    ok = read_at_all(file, header.rows_offset + first * sizeof(uint64_t), rows.data(), ok ? rows.size() : 0,
+                     MPI_UINT64_T, sizeof(uint64_t), comm) && ok;
+    // The rank holding the last site also checks that the index ends at num_nonzeros
+    ok = ok && rows_are_valid(rows.data(), rows.size(), header.num_nonzeros) &&
+         (static_cast<uint64_t>(first) + sites < header.num_sites || rows.back() == header.num_nonzeros);
+    if (!all_ranks_ok(ok, comm)) {
+        MPI_File_close(&file);
+        throw std::runtime_error(path + " has a corrupt row index");
+    }
+
+    size_t nonzeros = rows.back() - rows.front();
+    std::vector<int> species(nonzeros);
+    std::vector<int> counts(nonzeros);
+    ok = read_at_all(file, header.species_offset + rows.front() * sizeof(int32_t), species.data(), nonzeros, MPI_INT,
+                     sizeof(int32_t), comm);
+    ok = read_at_all(file, header.counts_offset + rows.front() * sizeof(int32_t), counts.data(), nonzeros, MPI_INT,
+                     sizeof(int32_t), comm) && ok;
+    MPI_File_close(&file);
+    if (!all_ranks_ok(ok, comm)) {
+        throw std::runtime_error("failed reading " + path);
+    }
+    if (!all_ranks_ok(entries_are_valid(species.data(), counts.data(), nonzeros, header.num_species), comm)) {
+        throw std::runtime_error(path + " has a species id or count out of range");
+    }
+
+    std::vector<size_t> offsets(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        offsets[i] = rows[i] - rows.front();
+    }
+    return SparseSpeciesMatrix(header.num_species, std::move(offsets), std::move(species), std::move(counts));
+}
+
+MappedMatrixFile::MappedMatrixFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(MatrixFileHeader)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::runtime_error("cannot open " + path);
+    }
+    mapped_bytes = info.st_size;
+    mapping = mmap(nullptr, mapped_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw std::runtime_error("cannot map " + path);
+    }
+    std::memcpy(&header, mapping, sizeof(header));
+    if (!header_is_valid(header)) {
+        munmap(mapping, mapped_bytes);
+        throw std::runtime_error(path + " is not a species matrix file");
+    }
+    // row() trusts the index, so it is checked once here
+    const char* base = static_cast<const char*>(mapping);
+    bool valid = layout_fits(header, mapped_bytes);
+    if (valid) {
+        rows = reinterpret_cast<const uint64_t*>(base + header.rows_offset);
+        valid = rows_are_valid(rows, header.num_sites + 1, header.num_nonzeros) &&
+                rows[header.num_sites] == header.num_nonzeros;
+    }
+    if (!valid) {
+        munmap(mapping, mapped_bytes);
+        throw std::runtime_error(path + " is truncated or its header is corrupt");
+    }
+    species = reinterpret_cast<const int*>(base + header.species_offset);
+    counts = reinterpret_cast<const int*>(base + header.counts_offset);
+    if (!entries_are_valid(species, counts, header.num_nonzeros, header.num_species)) {
+        munmap(mapping, mapped_bytes);
+        throw std::runtime_error(path + " has a species id or count out of range");
+    }
+}
+
+MappedMatrixFile::~MappedMatrixFile() {
+    munmap(mapping, mapped_bytes);
+}
@@ -0,0 +1,82 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <mpi.h>
+
+#include "MatrixDistribution.h"
+#include "SparseSpeciesMatrix.h"
+
+// On-disk CSR species matrix, in host (little-endian) byte order:
+//   header, 64 bytes
+//   species  int32[num_nonzeros]   species of every non-zero entry, site by site
+//   counts   int32[num_nonzeros]   matching counts
+//   rows     uint64[num_sites + 1] entry where each site starts
+// Any range of sites is three contiguous reads, so ranks can each read just
+// their own rows, and a mapped file can be used in place.
+struct MatrixFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_species;
+    uint64_t num_sites;
+    uint64_t num_nonzeros;
+    uint64_t species_offset;
+    uint64_t counts_offset;
+    uint64_t rows_offset;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(MatrixFileHeader) == 64, "matrix file header must stay 64 bytes");
+
+// Writes `matrix` to `path`; throws std::runtime_error on I/O failure
+void write_matrix_file(const std::string& path, const SparseSpeciesMatrix& matrix);
+
+// Converts a CSV of "site,species,count" records to a matrix file. Sites and
+// species are zero-based integers; an optional header line is skipped. The
+// records are streamed, so they must be grouped by site in ascending order;
+// within a site they may come in any order and repeats are added together.
+// Sites with no records become empty rows. Returns the written header.
+MatrixFileHeader convert_csv_to_matrix_file(const std::string& csv_path, const std::string& path);
+
+// Collective: rank 0 reads and checks the header and every rank gets a copy.
+// Throws std::runtime_error on every rank if the file is missing or not a matrix file.
+MatrixFileHeader read_matrix_header(const std::string& path, MPI_Comm comm);
+
+// Collective: each rank reads its own sites of the file with MPI-IO
+// collective reads, and nothing passes through rank 0. Throws
+// std::runtime_error on every rank if a read fails or comes back short, the
+// sections do not fit in the file, the row index is not in order, or a species
+// id or count is out of range.
+SparseSpeciesMatrix read_matrix_rows(const std::string& path, const MatrixFileHeader& header,
+                                     const RowPartition& partition, MPI_Comm comm);
+
+// Read-only memory map of a matrix file. Rows are served straight from the
+// mapping, so ranks sharing a node share one copy in the page cache. The
+// layout, row index, species ids and counts are checked when the file is
+// mapped, so row() and anything indexed by its species stay in bounds.
+class MappedMatrixFile {
+public:
+    explicit MappedMatrixFile(const std::string& path);
+    ~MappedMatrixFile();
+
+    MappedMatrixFile(const MappedMatrixFile&) = delete;
+    MappedMatrixFile& operator=(const MappedMatrixFile&) = delete;
+
+    int num_sites() const { return static_cast<int>(header.num_sites); }
+    int num_species() const { return static_cast<int>(header.num_species); }
+
+    SparseRow row(int site) const {
+        return SparseRow(species + rows[site], counts + rows[site], rows[site + 1] - rows[site]);
+    }
+
+private:
+    MatrixFileHeader header;
+    void* mapping = nullptr;
+    size_t mapped_bytes = 0;
+    const int* species = nullptr;
+    const int* counts = nullptr;
+    const uint64_t* rows = nullptr;
+};
+
+#endif // MATRIX_FILE_H
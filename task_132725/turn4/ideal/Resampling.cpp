@@ -0,0 +1,312 @@
+#include "Resampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "DiversityKernels.h"
+
+AliasTable::AliasTable(const int* counts, size_t species) : threshold(species), alias(species) {
+    // Vose's construction on counts scaled so the mean column holds exactly 1
+    double total = 0.0;
+    for (size_t i = 0; i < species; i++) {
+        total += counts[i];
+    }
+    std::vector<double> scaled(species);
+    std::vector<int> small;
+    std::vector<int> large;
+    for (size_t i = 0; i < species; i++) {
+        scaled[i] = total > 0.0 ? counts[i] * species / total : 1.0;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<int>(i));
+        alias[i] = static_cast<int>(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        int low = small.back();
+        small.pop_back();
+        int high = large.back();
+        threshold[low] = static_cast<uint32_t>(std::ldexp(scaled[low], 32));
+        alias[low] = high;
+        scaled[high] -= 1.0 - scaled[low];
+        if (scaled[high] < 1.0) {
+            large.pop_back();
+            small.push_back(high);
+        }
+    }
+    // What is left holds a full column, up to rounding
+    for (int column : small) {
+        threshold[column] = std::numeric_limits<uint32_t>::max();
+    }
+    for (int column : large) {
+        threshold[column] = std::numeric_limits<uint32_t>::max();
+    }
+}
+
+void draw_species(const AliasTable& table, uint64_t seed, uint64_t site, uint32_t replicate, SampleStream kind,
+                  size_t draws, int* species_out) {
+    const uint32_t k0 = static_cast<uint32_t>(seed);
+    const uint32_t k1 = static_cast<uint32_t>(seed >> 32);
+    const uint32_t c2 = static_cast<uint32_t>(site);
+    const uint32_t c3 = static_cast<uint32_t>(site >> 32) << 1 | static_cast<uint32_t>(kind);
+    if ((draws + 1) / 2 > static_cast<size_t>(std::numeric_limits<uint32_t>::max()) + 1) {
+        throw std::invalid_argument("draw_species: " + std::to_string(draws) + " draws overrun the stream counter");
+    }
+
+    // Each counter gives two draws, a column word and an accept word apiece.
+    // Words are generated a block at a time in one SIMD loop, then looked up.
+    const size_t block_pairs = 256;
+    uint32_t words[4][block_pairs];
+    size_t pairs = (draws + 1) / 2;
+    for (size_t first = 0; first < pairs; first += block_pairs) {
+        size_t count = std::min(block_pairs, pairs - first);
+        #pragma omp simd
+        for (size_t i = 0; i < count; i++) {
+            uint32_t w0 = static_cast<uint32_t>(first + i);
+            uint32_t w1 = replicate;
+            uint32_t w2 = c2;
+            uint32_t w3 = c3;
+            philox4x32(w0, w1, w2, w3, k0, k1);
+            words[0][i] = w0;
+            words[1][i] = w1;
+            words[2][i] = w2;
+            words[3][i] = w3;
+        }
+        int* out = species_out + 2 * first;
+        size_t outputs = std::min(2 * count, draws - 2 * first);
+        for (size_t i = 0; i < outputs; i++) {
+            out[i] = table.pick(words[2 * (i & 1)][i / 2], words[2 * (i & 1) + 1][i / 2]);
+        }
+    }
+}
+
+namespace {
+
+// Uniform doubles in (0, 1) taken in order from one Philox stream, four per counter
+class UniformStream {
+public:
+    UniformStream(uint64_t seed, uint64_t site, uint32_t replicate, SampleStream kind)
+        : k0(static_cast<uint32_t>(seed)), k1(static_cast<uint32_t>(seed >> 32)), c1(replicate),
+          c2(static_cast<uint32_t>(site)), c3(static_cast<uint32_t>(site >> 32) << 1 | static_cast<uint32_t>(kind)) {}
+
+    double next() {
+        if (used == 4) {
+            words[0] = counter++;
+            words[1] = c1;
+            words[2] = c2;
+            words[3] = c3;
+            philox4x32(words[0], words[1], words[2], words[3], k0, k1);
+            used = 0;
+        }
+        return (words[used++] + 0.5) * (1.0 / 4294967296.0);
+    }
+
+private:
+    uint32_t k0, k1, c1, c2, c3;
+    uint32_t counter = 0;
+    uint32_t words[4] = {0, 0, 0, 0};
+    int used = 4;
+};
+
+// log(k!) - Stirling's approximation of it, for BTRS
+double stirling_tail(double k) {
+    static const double small[10] = {0.0810614667953272,  0.0413406959554092,  0.0276779256849983,
+                                     0.02079067210376509, 0.0166446911898211,  0.0138761288230707,
+                                     0.0118967099458917,  0.0104112652619720,  0.00925546218271273,
+                                     0.00833056343336287};
+    if (k <= 9) {
+        return small[static_cast<int>(k)];
+    }
+    double square = (k + 1) * (k + 1);
+    return (1.0 / 12 - (1.0 / 360 - 1.0 / 1260 / square) / square) / (k + 1);
+}
+
+// Binomial(n, p) for p <= 0.5. Small means count geometric gaps; otherwise
+// Hormann's transformed rejection (BTRS), which takes a couple of uniforms
+// whatever n is.
+long long draw_binomial(long long n, double p, UniformStream& uniforms) {
+    if (n * p < 10.0) {
+        double log_q = std::log1p(-p);
+        long long successes = 0;
+        double position = 0.0;
+        for (;;) {
+            position += std::ceil(std::log(uniforms.next()) / log_q);
+            if (position > n) {
+                return successes;
+            }
+            successes++;
+        }
+    }
+    const double spread = std::sqrt(n * p * (1.0 - p));
+    const double b = 1.15 + 2.53 * spread;
+    const double a = -0.0873 + 0.0248 * b + 0.01 * p;
+    const double c = n * p + 0.5;
+    const double v_r = 0.92 - 4.2 / b;
+    const double r = p / (1.0 - p);
+    const double alpha = (2.83 + 5.1 / b) * spread;
+    const double m = std::floor((n + 1) * p);
+    for (;;) {
+        double u = uniforms.next() - 0.5;
+        double v = uniforms.next();
+        double us = 0.5 - std::fabs(u);
+        double k = std::floor((2.0 * a / us + b) * u + c);
+        if (us >= 0.07 && v <= v_r) {
+            return static_cast<long long>(k);
+        }
+        if (k < 0.0 || k > n) {
+            continue;
+        }
+        double log_v = std::log(v * alpha / (a / (us * us) + b));
+        double bound = (m + 0.5) * std::log((m + 1.0) / (r * (n - m + 1.0))) +
+                       (n + 1.0) * std::log((n - m + 1.0) / (n - k + 1.0)) +
+                       (k + 0.5) * std::log(r * (n - k + 1.0) / (k + 1.0)) + stirling_tail(m) +
+                       stirling_tail(n - m) - stirling_tail(k) - stirling_tail(n - k);
+        if (log_v <= bound) {
+            return static_cast<long long>(k);
+        }
+    }
+}
+
+// Percentile of already sorted values, by nearest rank
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(std::floor(fraction * (sorted.size() - 1) + 0.5));
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+} // namespace
+
+void draw_histogram(const int* counts, size_t species, uint64_t seed, uint64_t site, uint32_t replicate,
+                    SampleStream kind, int draws, int* histogram_out) {
+    UniformStream uniforms(seed, site, replicate, kind);
+    long long total_left = 0;
+    for (size_t i = 0; i < species; i++) {
+        total_left += counts[i];
+    }
+    long long draws_left = draws;
+    for (size_t i = 0; i < species; i++) {
+        long long drawn = 0;
+        if (draws_left > 0 && counts[i] > 0) {
+            if (counts[i] >= total_left) {
+                drawn = draws_left;
+            } else {
+                double p = static_cast<double>(counts[i]) / total_left;
+                drawn = p <= 0.5 ? draw_binomial(draws_left, p, uniforms)
+                                 : draws_left - draw_binomial(draws_left, 1.0 - p, uniforms);
+            }
+        }
+        histogram_out[i] = static_cast<int>(drawn);
+        draws_left -= drawn;
+        total_left -= counts[i];
+    }
+}
+
+std::vector<SiteResampling> resample_sites(const SparseSpeciesMatrix& rows, int first_site,
+                                           const ResampleOptions& options) {
+    int num_sites = rows.num_sites();
+    int replicates = options.replicates;
+    size_t depths = options.depths.size();
+    int max_depth = options.depths.empty() ? 0 : *std::max_element(options.depths.begin(), options.depths.end());
+
+    std::vector<AliasTable> tables(num_sites);
+    std::vector<long long> totals(num_sites);
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int site = 0; site < num_sites; site++) {
+        SparseRow row = rows.row(site);
+        tables[site] = AliasTable(row.counts(), row.size());
+        long long total = 0;
+        for (size_t i = 0; i < row.size(); i++) {
+            total += row.counts()[i];
+        }
+        totals[site] = total;
+    }
+    // Bootstrap histograms hold int counts, and rarefaction depths are ints
+    for (int site = 0; site < num_sites; site++) {
+        if (totals[site] > std::numeric_limits<int32_t>::max()) {
+            throw std::invalid_argument("resample_sites: site " + std::to_string(first_site + site) + " has " +
+                                        std::to_string(totals[site]) + " individuals, more than INT32_MAX");
+        }
+    }
+
+    // Depths from shallowest, so one pass over the draws serves them all
+    std::vector<int> depth_order(depths);
+    for (size_t d = 0; d < depths; d++) {
+        depth_order[d] = static_cast<int>(d);
+    }
+    std::sort(depth_order.begin(), depth_order.end(),
+              [&](int a, int b) { return options.depths[a] < options.depths[b]; });
+
+    // Every (site, replicate) writes its own slots, so the schedule cannot change the results
+    size_t samples = static_cast<size_t>(num_sites) * replicates;
+    std::vector<double> richness(samples * depths, 0.0);
+    std::vector<double> shannon(samples);
+    std::vector<double> simpson(samples);
+
+    #pragma omp parallel
+    {
+        std::vector<int> drawn;
+        std::vector<int> histogram;
+        #pragma omp for schedule(dynamic, 4)
+        for (size_t sample = 0; sample < samples; sample++) {
+            int site = static_cast<int>(sample / replicates);
+            uint32_t replicate = static_cast<uint32_t>(sample % replicates);
+            const AliasTable& table = tables[site];
+            uint64_t global_site = static_cast<uint64_t>(first_site) + site;
+            histogram.assign(table.size(), 0);
+
+            // Rarefaction: one stream of draws, read off at each depth
+            long long depth_limit = std::min<long long>(max_depth, totals[site]);
+            drawn.resize(depth_limit);
+            draw_species(table, options.seed, global_site, replicate, SampleStream::Rarefaction, drawn.size(),
+                         drawn.data());
+            int seen = 0;
+            long long done = 0;
+            for (int d : depth_order) {
+                long long depth = options.depths[d];
+                if (depth > totals[site]) {
+                    richness[sample * depths + d] = std::numeric_limits<double>::quiet_NaN();
+                    continue;
+                }
+                for (; done < depth; done++) {
+                    seen += histogram[drawn[done]]++ == 0;
+                }
+                richness[sample * depths + d] = seen;
+            }
+
+            // Bootstrap: as many individuals as the site has, drawn again
+            SparseRow row = rows.row(site);
+            draw_histogram(row.counts(), row.size(), options.seed, global_site, replicate, SampleStream::Bootstrap,
+                           static_cast<int>(totals[site]), histogram.data());
+            DiversityIndices indices = calculate_diversity(histogram.data(), histogram.size());
+            shannon[sample] = indices.shannon;
+            simpson[sample] = indices.simpson;
+        }
+    }
+
+    std::vector<SiteResampling> results(num_sites);
+    double tail = (1.0 - options.confidence) / 2.0;
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int site = 0; site < num_sites; site++) {
+        SiteResampling& result = results[site];
+        result.rarefied_richness.assign(depths, 0.0);
+        size_t first = static_cast<size_t>(site) * replicates;
+        for (size_t d = 0; d < depths; d++) {
+            double sum = 0.0;
+            for (int r = 0; r < replicates; r++) {
+                sum += richness[(first + r) * depths + d];
+            }
+            result.rarefied_richness[d] = replicates > 0 ? sum / replicates : 0.0;
+        }
+        std::vector<double> values(shannon.begin() + first, shannon.begin() + first + replicates);
+        std::sort(values.begin(), values.end());
+        result.shannon_low = percentile(values, tail);
+        result.shannon_high = percentile(values, 1.0 - tail);
+        values.assign(simpson.begin() + first, simpson.begin() + first + replicates);
+        std::sort(values.begin(), values.end());
+        result.simpson_low = percentile(values, tail);
+        result.simpson_high = percentile(values, 1.0 - tail);
+    }
+    return results;
+}
@@ -0,0 +1,112 @@
+#ifndef RESAMPLING_H
+#define RESAMPLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SparseSpeciesMatrix.h"
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3",
+// SC'11): turns a counter (c0..c3, in place) and a key into four random
+// words, with no state to carry between calls. Every (site, replicate) sample is its own stream, so the
+// numbers a sample sees do not depend on which thread or rank draws it.
+// Plain 32 x 32 -> 64-bit multiplies, so `#pragma omp simd` loops vectorize it.
+inline void philox_round(uint32_t& c0, uint32_t& c1, uint32_t& c2, uint32_t& c3, uint32_t k0, uint32_t k1) {
+    uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+    uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+    uint32_t next0 = static_cast<uint32_t>(product1 >> 32) ^ c1 ^ k0;
+    uint32_t next2 = static_cast<uint32_t>(product0 >> 32) ^ c3 ^ k1;
+    c1 = static_cast<uint32_t>(product1);
+    c3 = static_cast<uint32_t>(product0);
+    c0 = next0;
+    c2 = next2;
+}
+
+// The ten rounds are written out so that callers' loops have no inner loop to stop vectorization
+inline void philox4x32(uint32_t& c0, uint32_t& c1, uint32_t& c2, uint32_t& c3, uint32_t k0, uint32_t k1) {
+    const uint32_t w0 = 0x9E3779B9u;
+    const uint32_t w1 = 0xBB67AE85u;
+    philox_round(c0, c1, c2, c3, k0, k1);
+    philox_round(c0, c1, c2, c3, k0 + w0, k1 + w1);
+    philox_round(c0, c1, c2, c3, k0 + 2 * w0, k1 + 2 * w1);
+    philox_round(c0, c1, c2, c3, k0 + 3 * w0, k1 + 3 * w1);
+    philox_round(c0, c1, c2, c3, k0 + 4 * w0, k1 + 4 * w1);
+    philox_round(c0, c1, c2, c3, k0 + 5 * w0, k1 + 5 * w1);
+    philox_round(c0, c1, c2, c3, k0 + 6 * w0, k1 + 6 * w1);
+    philox_round(c0, c1, c2, c3, k0 + 7 * w0, k1 + 7 * w1);
+    philox_round(c0, c1, c2, c3, k0 + 8 * w0, k1 + 8 * w1);
+    philox_round(c0, c1, c2, c3, k0 + 9 * w0, k1 + 9 * w1);
+}
+
+// Walker's alias table over a site's counts, for drawing individuals with
+// replacement: each draw is one column pick and one comparison, with no
+// search, so blocks of draws vectorize.
+class AliasTable {
+public:
+    AliasTable() = default;
+    AliasTable(const int* counts, size_t species);
+
+    size_t size() const { return threshold.size(); }
+
+    // Species index for a draw made of two random words
+    int pick(uint32_t column_bits, uint32_t accept_bits) const {
+        uint32_t column = static_cast<uint32_t>((static_cast<uint64_t>(column_bits) * threshold.size()) >> 32);
+        return accept_bits < threshold[column] ? static_cast<int>(column) : alias[column];
+    }
+
+    const uint32_t* thresholds() const { return threshold.data(); }
+    const int* aliases() const { return alias.data(); }
+
+private:
+    std::vector<uint32_t> threshold; // accept the column when the draw is below, out of 2^32
+    std::vector<int> alias;
+};
+
+enum class SampleStream : uint32_t {
+    Rarefaction = 0,
+    Bootstrap = 1
+};
+
+// Draws `draws` individuals with replacement, in proportion to the counts the
+// table was built from, from stream (seed, site, replicate, kind). Writes the
+// species of each draw to `species_out`. The stream's 32-bit counter covers
+// 2^33 draws; throws std::invalid_argument beyond that.
+void draw_species(const AliasTable& table, uint64_t seed, uint64_t site, uint32_t replicate, SampleStream kind,
+                  size_t draws, int* species_out);
+
+// Draws `draws` individuals with replacement, in proportion to `counts`, from
+// stream (seed, site, replicate, kind), and writes how many of each species
+// were drawn to `histogram_out`. The multinomial is drawn as one binomial per
+// species, conditioned on the draws left, so the cost grows with the species
+// rather than the individuals.
+void draw_histogram(const int* counts, size_t species, uint64_t seed, uint64_t site, uint32_t replicate,
+                    SampleStream kind, int draws, int* histogram_out);
+
+struct ResampleOptions {
+    uint64_t seed = 1;
+    int replicates = 100;
+    std::vector<int> depths = {100, 1000, 10000}; // rarefaction depths, in individuals
+    double confidence = 0.95;                      // bootstrap interval
+};
+
+// Resampling results for one site. Depths beyond the site's individuals are NaN.
+struct SiteResampling {
+    std::vector<double> rarefied_richness; // mean species seen at each depth
+    double shannon_low = 0.0;
+    double shannon_high = 0.0;
+    double simpson_low = 0.0;
+    double simpson_high = 0.0;
+};
+
+// Rarefaction draws up to the deepest depth with replacement (as
+// phyloseq's rarefy_even_depth(replace = TRUE) does), reading the species
+// count at each depth along the way; the bootstrap redraws each site's total
+// with draw_histogram and takes percentile intervals of Shannon and Simpson.
+// Sites, and the replicates within each, are spread over OpenMP threads;
+// results depend only on the seed and the global site number, first_site + row.
+// Throws std::invalid_argument if a site holds more than INT32_MAX individuals.
+std::vector<SiteResampling> resample_sites(const SparseSpeciesMatrix& rows, int first_site,
+                                           const ResampleOptions& options);
+
+#endif // RESAMPLING_H
@@ -0,0 +1,86 @@
+#include "SparseSpeciesMatrix.h"
+
+#include <algorithm>
+
+SparseSpeciesMatrix SparseSpeciesMatrix::from_dense(const SpeciesMatrix& dense, int first, int last) {
+    SparseSpeciesMatrix sparse(dense.num_species());
+    for (int site = first; site < last; site++) {
+        sparse.append_row(dense.row(site));
+    }
+    return sparse;
+}
+
+void SparseSpeciesMatrix::append_row(const int* row) {
+    for (int j = 0; j < species_count; j++) {
+        if (row[j] != 0) {
+            species.push_back(j);
+            counts.push_back(row[j]);
+        }
+    }
+    offsets.push_back(counts.size());
+}
+
+void SparseSpeciesMatrix::append_row(const int* row_species, const int* row_counts, size_t nonzeros) {
+    species.insert(species.end(), row_species, row_species + nonzeros);
+    counts.insert(counts.end(), row_counts, row_counts + nonzeros);
+    offsets.push_back(counts.size());
+}
+
+SpeciesMatrix SparseSpeciesMatrix::to_dense() const {
+    SpeciesMatrix dense(num_sites(), species_count);
+    for (int site = 0; site < num_sites(); site++) {
+        int* target = dense.row(site);
+        for (SpeciesCount entry : row(site)) {
+            target[entry.species] = entry.count;
+        }
+    }
+    return dense;
+}
+
+HybridSpeciesMatrix::HybridSpeciesMatrix(const SparseSpeciesMatrix& source, int block_sites, double max_sparse_fill)
+    : site_count(source.num_sites()), species_count(source.num_species()) {
+    for (int first = 0; first < site_count; first += block_sites) {
+        Block block;
+        block.first_site = first;
+        block.num_sites = std::min(block_sites, site_count - first);
+
+        const std::vector<size_t>& offsets = source.row_offsets();
+        size_t begin = offsets[first];
+        size_t end = offsets[first + block.num_sites];
+        double cells = static_cast<double>(block.num_sites) * species_count;
+        block.sparse = cells == 0.0 || (end - begin) / cells < max_sparse_fill;
+
+        if (block.sparse) {
+            block.compressed = SparseSpeciesMatrix(species_count);
+            for (int site = first; site < first + block.num_sites; site++) {
+                SparseRow row = source.row(site);
+                block.compressed.append_row(row.species(), row.counts(), row.size());
+            }
+        } else {
+            block.dense = SpeciesMatrix(block.num_sites, species_count);
+            for (int site = 0; site < block.num_sites; site++) {
+                int* target = block.dense.row(site);
+                for (SpeciesCount entry : source.row(first + site)) {
+                    target[entry.species] = entry.count;
+                }
+            }
+        }
+        blocks.push_back(std::move(block));
+    }
+}
+
+size_t HybridSpeciesMatrix::sparse_blocks() const {
+    return std::count_if(blocks.begin(), blocks.end(), [](const Block& block) { return block.sparse; });
+}
+
+size_t HybridSpeciesMatrix::memory_bytes() const {
+    size_t bytes = 0;
+    for (const Block& block : blocks) {
+        if (block.sparse) {
+            bytes += block.compressed.memory_bytes();
+        } else {
+            bytes += block.dense.num_values() * sizeof(int) + block.dense.row_offsets().size() * sizeof(size_t);
+        }
+    }
+    return bytes;
+}
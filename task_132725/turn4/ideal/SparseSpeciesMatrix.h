@@ -0,0 +1,154 @@
+#ifndef SPARSE_SPECIES_MATRIX_H
+#define SPARSE_SPECIES_MATRIX_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "SpeciesMatrix.h"
+
+// One non-zero entry of a site's row
+struct SpeciesCount {
+    int species;
+    int count;
+};
+
+// Non-zero entries of one site, in increasing species order. counts() is a
+// plain array, so diversity kernels can run on it directly: absent species
+// contribute nothing to the totals, Shannon or Simpson sums.
+class SparseRow {
+public:
+    class iterator {
+    public:
+        iterator(const int* species, const int* counts) : species(species), counts(counts) {}
+        SpeciesCount operator*() const { return SpeciesCount{*species, *counts}; }
+        iterator& operator++() { ++species; ++counts; return *this; }
+        bool operator!=(const iterator& other) const { return counts != other.counts; }
+        bool operator==(const iterator& other) const { return counts == other.counts; }
+
+    private:
+        const int* species;
+        const int* counts;
+    };
+
+    SparseRow(const int* species, const int* counts, size_t nonzeros)
+        : species_data(species), count_data(counts), nonzeros(nonzeros) {}
+
+    size_t size() const { return nonzeros; }
+    const int* species() const { return species_data; }
+    const int* counts() const { return count_data; }
+
+    iterator begin() const { return iterator(species_data, count_data); }
+    iterator end() const { return iterator(species_data + nonzeros, count_data + nonzeros); }
+
+private:
+    const int* species_data;
+    const int* count_data;
+    size_t nonzeros;
+};
+
+// Site-by-species counts in compressed sparse row form: for each site, the
+// species present and their counts, with row offsets into both arrays.
+// Occurrence matrices are mostly zeros, so this usually takes a fraction of
+// the memory of a SpeciesMatrix.
+class SparseSpeciesMatrix {
+public:
+    explicit SparseSpeciesMatrix(int num_species = 0) : offsets(1, 0), species_count(num_species) {}
+
+    // Takes over ready-made CSR arrays; offsets has one entry per site plus one and starts at 0
+    SparseSpeciesMatrix(int num_species, std::vector<size_t> offsets, std::vector<int> species,
+                        std::vector<int> counts)
+        : offsets(std::move(offsets)), species(std::move(species)), counts(std::move(counts)),
+          species_count(num_species) {}
+
+    // Compressed copy of sites [first, last) of a dense matrix
+    static SparseSpeciesMatrix from_dense(const SpeciesMatrix& dense, int first, int last);
+
+    // Appends a site given as dense counts of length num_species()
+    void append_row(const int* counts);
+
+    // Appends a site given as its non-zero entries, in increasing species order
+    void append_row(const int* species, const int* counts, size_t nonzeros);
+
+    int num_sites() const { return static_cast<int>(offsets.size()) - 1; }
+    int num_species() const { return species_count; }
+    size_t num_nonzeros() const { return counts.size(); }
+
+    SparseRow row(int site) const {
+        return SparseRow(species.data() + offsets[site], counts.data() + offsets[site],
+                         offsets[site + 1] - offsets[site]);
+    }
+
+    SpeciesMatrix to_dense() const;
+
+    size_t memory_bytes() const {
+        return offsets.size() * sizeof(size_t) + (species.size() + counts.size()) * sizeof(int);
+    }
+
+    // Raw arrays, for sending blocks of rows over MPI
+    const std::vector<size_t>& row_offsets() const { return offsets; }
+    const int* species_data() const { return species.data(); }
+    const int* count_data() const { return counts.data(); }
+
+private:
+    std::vector<size_t> offsets;
+    std::vector<int> species;
+    std::vector<int> counts;
+    int species_count;
+};
+
+// Sites split into fixed-size blocks, each stored densely or as CSR depending
+// on how full it is. Dense rows are cheaper to scan once most species are
+// present; sparse rows win below max_sparse_fill.
+class HybridSpeciesMatrix {
+public:
+    struct Block {
+        int first_site = 0;
+        int num_sites = 0;
+        bool sparse = false;
+        SpeciesMatrix dense;
+        SparseSpeciesMatrix compressed;
+    };
+
+    // CSR stores 8 bytes per present species against 4 per species for dense
+    // rows, so sparse is smaller below a fill of 0.5; the margin pays for the
+    // dense kernel's simpler access pattern
+    static constexpr double default_max_sparse_fill = 0.4;
+
+    HybridSpeciesMatrix(const SparseSpeciesMatrix& source, int block_sites = 256,
+                        double max_sparse_fill = default_max_sparse_fill);
+
+    int num_sites() const { return site_count; }
+    int num_species() const { return species_count; }
+    size_t num_blocks() const { return blocks.size(); }
+    const Block& block(size_t index) const { return blocks[index]; }
+
+    size_t sparse_blocks() const;
+    size_t memory_bytes() const;
+
+    // Bytes the same sites would take as one SpeciesMatrix
+    size_t dense_memory_bytes() const {
+        return static_cast<size_t>(site_count) * species_count * sizeof(int) + (site_count + 1) * sizeof(size_t);
+    }
+
+    // Calls visit(counts, length) for every site in `block`, in site order.
+    // For sparse blocks only the non-zero counts are passed.
+    template <typename Visitor>
+    void for_each_site(const Block& block, Visitor&& visit) const {
+        for (int site = 0; site < block.num_sites; site++) {
+            if (block.sparse) {
+                SparseRow row = block.compressed.row(site);
+                visit(row.counts(), row.size());
+            } else {
+                visit(block.dense.row(site), static_cast<size_t>(block.dense.row_length(site)));
+            }
+        }
+    }
+
+private:
+    std::vector<Block> blocks;
+    int site_count = 0;
+    int species_count = 0;
+};
+
+#endif // SPARSE_SPECIES_MATRIX_H
@@ -0,0 +1,54 @@
+#include "SpeciesMatrix.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+SpeciesMatrix::SpeciesMatrix(int num_sites, int num_species)
+    : offsets(num_sites + 1), values(static_cast<size_t>(num_sites) * num_species), species_per_row(num_species) {
+    for (int site = 0; site <= num_sites; site++) {
+        offsets[site] = static_cast<size_t>(site) * num_species;
+    }
+}
+
+SpeciesMatrix::SpeciesMatrix(const std::vector<int>& row_lengths) : offsets(row_lengths.size() + 1, 0) {
+    species_per_row = row_lengths.empty() ? 0 : row_lengths[0];
+    for (size_t site = 0; site < row_lengths.size(); site++) {
+        offsets[site + 1] = offsets[site] + row_lengths[site];
+        if (row_lengths[site] != species_per_row) {
+            species_per_row = -1;
+        }
+    }
+    values.assign(offsets.back(), 0);
+}
+
+SpeciesMatrix SpeciesMatrix::rows(int first, int last) const {
+    std::vector<int> lengths;
+    for (int site = first; site < last; site++) {
+        lengths.push_back(row_length(site));
+    }
+    SpeciesMatrix block(lengths);
+    std::copy(values.begin() + offsets[first], values.begin() + offsets[last], block.values.begin());
+    return block;
+}
+
+SpeciesColumns SpeciesMatrix::to_columns() const {
+    if (species_per_row < 0) {
+        throw std::logic_error("SpeciesMatrix::to_columns needs rows of equal length");
+    }
+    SpeciesColumns columns(num_sites(), species_per_row);
+    // Transpose in tiles so both the reads and the writes stay in cache
+    const int tile = 64;
+    for (int site_block = 0; site_block < num_sites(); site_block += tile) {
+        int site_end = std::min(num_sites(), site_block + tile);
+        for (int species_block = 0; species_block < species_per_row; species_block += tile) {
+            int species_end = std::min(species_per_row, species_block + tile);
+            for (int site = site_block; site < site_end; site++) {
+                const int* source = row(site);
+                for (int species = species_block; species < species_end; species++) {
+                    columns.column(species)[site] = source[species];
+                }
+            }
+        }
+    }
+    return columns;
+}
@@ -0,0 +1,73 @@
+#ifndef SPECIES_MATRIX_H
+#define SPECIES_MATRIX_H
+
+#include <cstddef>
+#include <vector>
+
+class SpeciesColumns;
+
+// Site-by-species abundance counts stored row by row in one flat buffer, with
+// row offsets marking where each site starts. Sites normally all have the same
+// species list, but rows of different lengths (surveys that recorded different
+// species sets) are allowed. Rows are contiguous, so a block of sites can be
+// sent with a single MPI call and no packing.
+class SpeciesMatrix {
+public:
+    SpeciesMatrix() : offsets(1, 0) {}
+
+    // num_sites rows of num_species zero counts
+    SpeciesMatrix(int num_sites, int num_species);
+
+    // Rows with the given lengths, zero filled
+    explicit SpeciesMatrix(const std::vector<int>& row_lengths);
+
+    int num_sites() const { return static_cast<int>(offsets.size()) - 1; }
+    size_t num_values() const { return values.size(); }
+
+    // Species per row when every row has the same length, otherwise -1
+    int num_species() const { return species_per_row; }
+
+    int row_length(int site) const { return static_cast<int>(offsets[site + 1] - offsets[site]); }
+    const int* row(int site) const { return values.data() + offsets[site]; }
+    int* row(int site) { return values.data() + offsets[site]; }
+
+    int at(int site, int species) const { return row(site)[species]; }
+    int& at(int site, int species) { return row(site)[species]; }
+
+    const int* data() const { return values.data(); }
+    int* data() { return values.data(); }
+
+    // Offset of each row in data(), plus the total at the end
+    const std::vector<size_t>& row_offsets() const { return offsets; }
+
+    // Copy of sites [first, last)
+    SpeciesMatrix rows(int first, int last) const;
+
+    // Species-major copy, for scans down one species across sites; requires equal row lengths
+    SpeciesColumns to_columns() const;
+
+private:
+    std::vector<size_t> offsets;
+    std::vector<int> values;
+    int species_per_row = 0;
+};
+
+// Column-major (species-major) copy of a rectangular SpeciesMatrix
+class SpeciesColumns {
+public:
+    SpeciesColumns(int num_sites, int num_species)
+        : sites(num_sites), species(num_species), values(static_cast<size_t>(num_sites) * num_species) {}
+
+    int num_sites() const { return sites; }
+    int num_species() const { return species; }
+
+    const int* column(int species_index) const { return values.data() + static_cast<size_t>(species_index) * sites; }
+    int* column(int species_index) { return values.data() + static_cast<size_t>(species_index) * sites; }
+
+private:
+    int sites;
+    int species;
+    std::vector<int> values;
+};
+
+#endif // SPECIES_MATRIX_H
@@ -0,0 +1,1389 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <omp.h>
+#include <mpi.h>
+
+#include "BetaDiversity.h"
+#include "ChunkScheduler.h"
+#include "DiversityKernels.h"
+#include "IncrementalDiversity.h"
+#include "LoadBalancer.h"
+#include "MatrixFile.h"
+#include "Resampling.h"
+#include "MatrixDistribution.h"
+#include "SparseSpeciesMatrix.h"
+
+// Command-line settings shared by every rank
+struct Options {
+    std::string command;        // empty runs the diversity job
+    int num_sites = 4096;
+    int num_species = 1000;
+    double presence = 0.3;      // fraction of species present at a site
+    std::string schedule = "static"; // "dynamic": ranks claim chunks of sites as they go;
+                                     // "pipelined": sites arrive and are reduced in rounds
+    std::string input;          // matrix file to read instead of generating data; each rank reads its own sites
+    std::string csv;            // "convert" reads this CSV...
+    std::string output;         // ...and writes this matrix file
+    int replicates = 100;       // resampling replicates per site
+    uint64_t seed = 1;          // resampling seed; results depend on nothing else
+};
+
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+    int first = 1;
+    if (argc > 1 && argv[1][0] != '-') {
+        options.command = argv[1];
+        first = 2;
+    }
+    for (int i = first; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--sites") {
+            options.num_sites = std::atoi(argv[i + 1]);
+        } else if (flag == "--species") {
+            options.num_species = std::atoi(argv[i + 1]);
+        } else if (flag == "--presence") {
+            options.presence = std::atof(argv[i + 1]);
+        } else if (flag == "--schedule") {
+            options.schedule = argv[i + 1];
+        } else if (flag == "--input") {
+            options.input = argv[i + 1];
+        } else if (flag == "--csv") {
+            options.csv = argv[i + 1];
+        } else if (flag == "--output") {
+            options.output = argv[i + 1];
+        } else if (flag == "--replicates") {
+            options.replicates = std::atoi(argv[i + 1]);
+        } else if (flag == "--seed") {
+            options.seed = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    return options;
+}
+
+uint64_t mix_bits(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Deterministic abundance of one species at one site, so every rank can
+// generate any row: most species are absent, present ones are heavy-tailed
+int synthetic_count(uint64_t site, uint64_t species, double presence) {
+    uint64_t bits = mix_bits(site * 0x100000001b3ULL + species);
+    double uniform = (bits >> 11) * (1.0 / 9007199254740992.0);
+    if (uniform >= presence) {
+        return 0;
+    }
+    double tail = (bits & 0x7FF) / 2048.0;
+    return 1 + static_cast<int>(std::pow(1.0 - tail, -1.5));
+}
+
+// Compares the vectorized kernels against the std::log reference and times both
+bool check_diversity_kernels() {
+    std::mt19937 random(12345);
+    double max_log_error = 0.0;
+    for (int i = 0; i < 1000000; i++) {
+        double x = i < 100000 ? i + 1 : std::exp(std::uniform_real_distribution<double>(0.0, 40.0)(random));
+        max_log_error = std::max(max_log_error, std::fabs(fast_log(x) - std::log(x)));
+    }
+
+    // Shapes that stress the kernels: empty, single species, odd lengths, huge counts, mostly zeros
+    double max_shannon_error = 0.0;
+    double max_simpson_error = 0.0;
+    std::vector<int> counts;
+    for (int trial = 0; trial < 2000; trial++) {
+        size_t length = trial < 10 ? trial : 1 + random() % 5000;
+        int max_count = trial % 3 == 0 ? 5 : (trial % 3 == 1 ? 1000 : 1000000);
+        double zero_fraction = (trial % 7) / 7.0;
+        counts.assign(length, 0);
+        for (int& count : counts) {
+            if (std::uniform_real_distribution<double>(0.0, 1.0)(random) >= zero_fraction) {
+                count = std::uniform_int_distribution<int>(0, max_count)(random);
+            }
+        }
+        DiversityIndices fast = calculate_diversity(counts);
+        DiversityIndices reference = calculate_diversity_reference(counts.data(), counts.size());
+        if (fast.total != reference.total) {
+            max_shannon_error = INFINITY;
+        }
+        max_shannon_error = std::max(max_shannon_error, std::fabs(fast.shannon - reference.shannon));
+        max_simpson_error = std::max(max_simpson_error, std::fabs(fast.simpson - reference.simpson));
+    }
+
+    const double shannon_tolerance = fast_log_max_error + 1e-12;
+    const double simpson_tolerance = 1e-12;
+    bool ok = max_log_error <= fast_log_max_error && max_shannon_error <= shannon_tolerance &&
+              max_simpson_error <= simpson_tolerance;
+
+    // Throughput over a site-by-species block
+    const int sites = 20000;
+    const int species = 1000;
+    std::vector<int> block(static_cast<size_t>(sites) * species);
+    for (int site = 0; site < sites; site++) {
+        for (int j = 0; j < species; j++) {
+            block[static_cast<size_t>(site) * species + j] = synthetic_count(site, j, 0.3);
+        }
+    }
+    auto time_sites = [&](auto kernel) {
+        double best = 1e30;
+        double checksum = 0.0;
+        for (int round = 0; round < 3; round++) {
+            auto begin = std::chrono::steady_clock::now();
+            for (int site = 0; site < sites; site++) {
+                checksum += kernel(&block[static_cast<size_t>(site) * species], species).shannon;
+            }
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        }
+        return std::make_pair(sites / best, checksum);
+    };
+    auto reference_rate = time_sites(calculate_diversity_reference);
+    auto fast_rate = time_sites([](const int* counts, size_t n) { return calculate_diversity(counts, n); });
+    double bytes_per_site = species * sizeof(int);
+
+    std::cout << "Diversity kernels (" << sites << " sites x " << species << " species):\n"
+              << "  max |fast_log - log| " << max_log_error << " (bound " << fast_log_max_error << ")\n"
+              << "  max Shannon error " << max_shannon_error << ", max Simpson error " << max_simpson_error
+              << " over 2000 random count vectors\n"
+              << "  reference  " << static_cast<long>(reference_rate.first) << " sites/s ("
+              << reference_rate.first * bytes_per_site / 1e9 << " GB/s)\n"
+              << "  vectorized " << static_cast<long>(fast_rate.first) << " sites/s ("
+              << fast_rate.first * bytes_per_site / 1e9 << " GB/s), "
+              << fast_rate.first / reference_rate.first << "x\n"
+              << "  tolerance checks " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Per-site indices summed over a set of sites, and how many of those sites each species was seen at
+struct SiteSums {
+    double abundance = 0.0;
+    double shannon = 0.0;
+    double simpson = 0.0;
+    std::vector<int> occupancy;
+};
+
+// Adds every site of `matrix` to `sums`
+void accumulate_sites(const HybridSpeciesMatrix& matrix, SiteSums& sums) {
+    double total_abundance = 0.0;
+    double total_shannon = 0.0;
+    double total_simpson = 0.0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:total_abundance, total_shannon, total_simpson)
+    for (size_t b = 0; b < matrix.num_blocks(); b++) {
+        matrix.for_each_site(matrix.block(b), [&](const int* counts, size_t length) {
+            DiversityIndices indices = calculate_diversity(counts, length);
+            total_abundance += indices.total;
+            total_shannon += indices.shannon;
+            total_simpson += indices.simpson;
+        });
+    }
+    sums.abundance += total_abundance;
+    sums.shannon += total_shannon;
+    sums.simpson += total_simpson;
+
+    int num_species = matrix.num_species();
+    sums.occupancy.resize(num_species, 0);
+    #pragma omp parallel
+    {
+        std::vector<int> occupancy(num_species, 0);
+        #pragma omp for schedule(dynamic)
+        for (size_t b = 0; b < matrix.num_blocks(); b++) {
+            const HybridSpeciesMatrix::Block& block = matrix.block(b);
+            for (int i = 0; i < block.num_sites; i++) {
+                if (block.sparse) {
+                    for (SpeciesCount entry : block.compressed.row(i)) {
+                        occupancy[entry.species]++;
+                    }
+                } else {
+                    const int* row = block.dense.row(i);
+                    #pragma omp simd
+                    for (int j = 0; j < num_species; j++) {
+                        occupancy[j] += row[j] > 0;
+                    }
+                }
+            }
+        }
+        #pragma omp critical
+        for (int j = 0; j < num_species; j++) {
+            sums.occupancy[j] += occupancy[j];
+        }
+    }
+}
+
+// Sums occupancy over all ranks onto rank 0
+void reduce_occupancy(SiteSums& sums, int num_species) {
+    std::vector<int> local = std::move(sums.occupancy);
+    local.resize(num_species, 0);
+    sums.occupancy.assign(num_species, 0);
+    MPI_Reduce(local.data(), sums.occupancy.data(), num_species, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+}
+
+// Stands in for per-site work that does not need the CPU (remote lookups,
+// I/O): waits `nanoseconds_per_species` for every present species. Lets a
+// box with fewer cores than ranks show how a schedule balances work, since
+// waits overlap where computation would just be time-sliced.
+void emulate_site_cost(size_t present_species, double nanoseconds_per_species) {
+    if (nanoseconds_per_species > 0.0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(
+            static_cast<long long>(present_species * nanoseconds_per_species)));
+    }
+}
+
+// Rank 0 generates the matrix, compressing each site as it goes;
+// presence_at(site) is the fraction of species present at that site
+template <typename Presence>
+SparseSpeciesMatrix generate_sites(int rank, int num_sites, int num_species, Presence presence_at) {
+    SparseSpeciesMatrix matrix(num_species);
+    if (rank == 0) {
+        std::vector<int> row(num_species);
+        for (int i = 0; i < num_sites; i++) {
+            double presence = presence_at(i);
+            for (int j = 0; j < num_species; j++) {
+                row[j] = synthetic_count(i, j, presence);
+            }
+            matrix.append_row(row.data());
+        }
+    }
+    return matrix;
+}
+
+// Sums each rank's totals onto rank 0; `storage` receives the summed
+// {stored bytes, dense bytes, sparse blocks, blocks} of the local matrices
+SiteSums reduce_local_sums(SiteSums sums, const HybridSpeciesMatrix& local_data, int num_species, double* storage) {
+    // Reduce the results from all processes
+    double local_sums[3] = {sums.abundance, sums.shannon, sums.simpson};
+    double global_sums[3] = {0.0, 0.0, 0.0};
+    MPI_Reduce(local_sums, global_sums, 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    reduce_occupancy(sums, num_species);
+    sums.abundance = global_sums[0];
+    sums.shannon = global_sums[1];
+    sums.simpson = global_sums[2];
+
+    // Storage actually used on each rank against a dense layout of the same sites
+    double local_storage[4] = {static_cast<double>(local_data.memory_bytes()),
+                               static_cast<double>(local_data.dense_memory_bytes()),
+                               static_cast<double>(local_data.sparse_blocks()),
+                               static_cast<double>(local_data.num_blocks())};
+    MPI_Reduce(local_storage, storage, 4, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    return sums;
+}
+
+// Static schedule: every rank is sent one contiguous block of sites.
+// Returns the global sums and storage (see reduce_local_sums) on rank 0.
+SiteSums run_static(const SparseSpeciesMatrix& data, int num_sites, int num_species, double* busy_seconds,
+                    double* storage, double emulated_ns_per_species = 0.0) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    RowPartition partition = partition_rows(num_sites, size);
+    double busy_start = MPI_Wtime();
+    SparseSpeciesMatrix local_rows = scatter_rows(data, partition, 0, MPI_COMM_WORLD);
+    HybridSpeciesMatrix local_data(local_rows);
+    SiteSums sums;
+    accumulate_sites(local_data, sums);
+    emulate_site_cost(local_rows.num_nonzeros(), emulated_ns_per_species);
+    *busy_seconds = MPI_Wtime() - busy_start;
+
+    return reduce_local_sums(sums, local_data, num_species, storage);
+}
+
+// Dynamic schedule: ranks claim guided chunks from a shared counter and pull
+// each chunk's rows from rank 0 with one-sided reads, so a rank that drew
+// dense sites simply claims fewer chunks. Sums are kept per chunk and added
+// in chunk order on rank 0, which makes the result independent of which rank
+// ran which chunk, and of the number of ranks.
+SiteSums run_dynamic(const SparseSpeciesMatrix& data, int num_sites, int num_species, double* busy_seconds,
+                     double emulated_ns_per_species = 0.0) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    ChunkSchedule schedule = guided_chunks(num_sites, size);
+    std::vector<double> chunk_sums(3 * static_cast<size_t>(schedule.num_chunks()), 0.0);
+    SiteSums sums;
+    double busy_start = MPI_Wtime();
+    {
+        RemoteSparseMatrix remote(data, 0, MPI_COMM_WORLD);
+        ChunkCounter counter(0, MPI_COMM_WORLD);
+        for (int chunk = counter.next(); chunk < schedule.num_chunks(); chunk = counter.next()) {
+            SparseSpeciesMatrix chunk_rows = remote.fetch_rows(schedule.begin(chunk), schedule.end(chunk));
+            HybridSpeciesMatrix rows(chunk_rows);
+            SiteSums chunk_total;
+            chunk_total.occupancy = std::move(sums.occupancy);
+            accumulate_sites(rows, chunk_total);
+            emulate_site_cost(chunk_rows.num_nonzeros(), emulated_ns_per_species);
+            chunk_sums[3 * chunk] = chunk_total.abundance;
+            chunk_sums[3 * chunk + 1] = chunk_total.shannon;
+            chunk_sums[3 * chunk + 2] = chunk_total.simpson;
+            sums.occupancy = std::move(chunk_total.occupancy);
+        }
+        *busy_seconds = MPI_Wtime() - busy_start;
+    }
+
+    // Each chunk's slot is non-zero on exactly one rank, so this sum is exact
+    std::vector<double> all_chunks(chunk_sums.size(), 0.0);
+    MPI_Reduce(chunk_sums.data(), all_chunks.data(), static_cast<int>(chunk_sums.size()), MPI_DOUBLE, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    reduce_occupancy(sums, num_species);
+    for (int chunk = 0; chunk < schedule.num_chunks(); chunk++) {
+        sums.abundance += all_chunks[3 * chunk];
+        sums.shannon += all_chunks[3 * chunk + 1];
+        sums.simpson += all_chunks[3 * chunk + 2];
+    }
+    return sums;
+}
+
+// Pipelined schedule: each rank's block arrives in rounds of 512 sites while
+// the previous round is processed, and each round's sums are reduced with
+// MPI_Ireduce as soon as they are ready, so rank 0 holds per-round totals as
+// they complete. The job adds those totals in round order.
+SiteSums run_pipelined(const SparseSpeciesMatrix& data, int num_sites, int num_species, double* busy_seconds,
+                       double emulated_ns_per_species = 0.0) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    RowPartition partition = partition_rows(num_sites, size);
+    double busy_start = MPI_Wtime();
+    BlockStream stream(data, partition, 512, 0, MPI_COMM_WORLD);
+    int rounds = stream.num_rounds();
+    std::vector<double> round_sums(3 * static_cast<size_t>(rounds), 0.0);
+    std::vector<double> round_totals(round_sums.size(), 0.0);
+    std::vector<MPI_Request> reductions(rounds, MPI_REQUEST_NULL);
+
+    SiteSums sums;
+    for (int round = 0; round < rounds; round++) {
+        SparseSpeciesMatrix round_rows = stream.take(round);
+        HybridSpeciesMatrix rows(round_rows);
+        SiteSums round_total;
+        round_total.occupancy = std::move(sums.occupancy);
+        accumulate_sites(rows, round_total);
+        emulate_site_cost(round_rows.num_nonzeros(), emulated_ns_per_species);
+        sums.occupancy = std::move(round_total.occupancy);
+
+        double* slot = &round_sums[3 * static_cast<size_t>(round)];
+        slot[0] = round_total.abundance;
+        slot[1] = round_total.shannon;
+        slot[2] = round_total.simpson;
+        MPI_Ireduce(slot, &round_totals[3 * static_cast<size_t>(round)], 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD,
+                    &reductions[round]);
+        stream.progress();
+    }
+    MPI_Waitall(rounds, reductions.data(), MPI_STATUSES_IGNORE);
+    *busy_seconds = MPI_Wtime() - busy_start;
+
+    reduce_occupancy(sums, num_species);
+    for (int round = 0; round < rounds; round++) {
+        sums.abundance += round_totals[3 * round];
+        sums.shannon += round_totals[3 * round + 1];
+        sums.simpson += round_totals[3 * round + 2];
+    }
+    return sums;
+}
+
+// Runs the named schedule ("static", "dynamic" or "pipelined")
+SiteSums run_schedule(const std::string& schedule, const SparseSpeciesMatrix& data, int num_sites, int num_species,
+                      double* busy_seconds, double* storage, double emulated_ns_per_species = 0.0) {
+    if (schedule == "dynamic") {
+        return run_dynamic(data, num_sites, num_species, busy_seconds, emulated_ns_per_species);
+    }
+    if (schedule == "pipelined") {
+        return run_pipelined(data, num_sites, num_species, busy_seconds, emulated_ns_per_species);
+    }
+    return run_static(data, num_sites, num_species, busy_seconds, storage, emulated_ns_per_species);
+}
+
+// Runs a schedule and prints its makespan (wall time until the reduced result
+// is on rank 0) and imbalance (busiest rank's working time over the mean)
+SiteSums time_schedule(const std::string& schedule, const SparseSpeciesMatrix& data, int num_sites,
+                       int num_species, double emulated_ns_per_species) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    double busy = 0.0;
+    double storage[4];
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    SiteSums sums = run_schedule(schedule, data, num_sites, num_species, &busy, storage, emulated_ns_per_species);
+    double makespan = MPI_Wtime() - start;
+
+    double max_busy = 0.0;
+    double total_busy = 0.0;
+    MPI_Reduce(&busy, &max_busy, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&busy, &total_busy, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::cout << "    " << schedule << std::string(10 - schedule.size(), ' ') << "makespan " << makespan * 1e3
+                  << " ms, imbalance " << max_busy / (total_busy / size) << std::endl;
+    }
+    return sums;
+}
+
+// Every schedule sums the same per-site values, only in a different order
+bool sums_match(const SiteSums& a, const SiteSums& b, int num_sites) {
+    double tolerance = 1e-12 * num_sites;
+    return a.abundance == b.abundance && a.occupancy == b.occupancy &&
+           std::fabs(a.shannon - b.shannon) <= tolerance && std::fabs(a.simpson - b.simpson) <= tolerance;
+}
+
+// Runs both schedules on a skewed matrix whose first eighth of sites are
+// nearly full and the rest nearly empty, so the static schedule leaves rank 0
+// with most of the work. Makespan is the wall time until the reduced result
+// is on rank 0; imbalance is the busiest rank's working time over the mean.
+// The second pass adds an emulated 100 ns wait per present species, which
+// shows the balance when the box has fewer cores than ranks.
+bool benchmark_schedules(const Options& options) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int num_sites = options.num_sites * 4;
+    int dense_sites = num_sites / 8;
+    SparseSpeciesMatrix data = generate_sites(rank, num_sites, options.num_species, [&](int site) {
+        return site < dense_sites ? 0.95 : 0.02;
+    });
+
+    bool ok = true;
+    for (double emulated_ns : {0.0, 100.0}) {
+        if (rank == 0) {
+            std::cout << (emulated_ns > 0.0 ? "  with emulated site cost:" : "  compute only:") << std::endl;
+        }
+        SiteSums fixed = time_schedule("static", data, num_sites, options.num_species, emulated_ns);
+        SiteSums dynamic = time_schedule("dynamic", data, num_sites, options.num_species, emulated_ns);
+        ok = ok && (rank != 0 || sums_match(fixed, dynamic, num_sites));
+    }
+
+    if (rank == 0) {
+        std::cout << "  " << num_sites << " sites on " << size << " ranks, results "
+                  << (ok ? "match" : "DIFFER") << std::endl;
+    }
+    int failed = ok ? 0 : 1;
+    MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return failed == 0;
+}
+
+// Times the blocking static schedule against the pipelined one over a larger
+// matrix, where distribution and reduction are a real share of the run
+bool benchmark_pipeline(const Options& options) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int num_sites = options.num_sites * 4;
+    SparseSpeciesMatrix data = generate_sites(rank, num_sites, options.num_species,
+                                              [&](int) { return options.presence; });
+    SiteSums blocking = time_schedule("static", data, num_sites, options.num_species, 0.0);
+    SiteSums pipelined = time_schedule("pipelined", data, num_sites, options.num_species, 0.0);
+
+    int failed = rank == 0 && !sums_match(blocking, pipelined, num_sites) ? 1 : 0;
+    if (rank == 0) {
+        std::cout << "  " << num_sites << " sites on " << size << " ranks, results "
+                  << (failed ? "DIFFER" : "match") << std::endl;
+    }
+    MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return failed == 0;
+}
+
+// Writes a copy of the matrix file at `path` with `edit` applied to its bytes
+void write_damaged_copy(const std::string& path, const std::string& copy_path,
+                        const std::function<void(std::vector<char>&)>& edit) {
+    std::vector<char> bytes;
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    std::fseek(file, 0, SEEK_END);
+    bytes.resize(std::ftell(file));
+    std::rewind(file);
+    size_t read = std::fread(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+    bytes.resize(read);
+    edit(bytes);
+    file = std::fopen(copy_path.c_str(), "wb");
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+}
+
+// Both readers must refuse a truncated file, one whose row index runs
+// backwards and one with a species id past num_species, rather than reading
+// past the data. Collective.
+bool damaged_files_rejected(const std::string& path, const MatrixFileHeader& header, const RowPartition& partition) {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    const std::string truncated_path = path + ".truncated";
+    const std::string unordered_path = path + ".unordered";
+    const std::string bad_species_path = path + ".bad_species";
+    if (rank == 0) {
+        write_damaged_copy(path, truncated_path, [](std::vector<char>& bytes) { bytes.resize(bytes.size() - 8); });
+        write_damaged_copy(path, unordered_path, [&](std::vector<char>& bytes) {
+            uint64_t backwards = header.num_nonzeros;
+            std::memcpy(bytes.data() + header.rows_offset + sizeof(uint64_t), &backwards, sizeof(backwards));
+        });
+        write_damaged_copy(path, bad_species_path, [&](std::vector<char>& bytes) {
+            int32_t bad_species = 0x40000000;
+            std::memcpy(bytes.data() + header.species_offset + header.num_nonzeros / 2 * sizeof(int32_t),
+                        &bad_species, sizeof(bad_species));
+        });
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    int rejected = 0;
+    for (const std::string& damaged : {truncated_path, unordered_path, bad_species_path}) {
+        try {
+            read_matrix_rows(damaged, header, partition, MPI_COMM_WORLD);
+        } catch (const std::runtime_error&) {
+            rejected++;
+        }
+        try {
+            MappedMatrixFile mapped(damaged);
+        } catch (const std::runtime_error&) {
+            rejected++;
+        }
+    }
+    int all_rejected = 0;
+    MPI_Allreduce(&rejected, &all_rejected, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::remove(truncated_path.c_str());
+        std::remove(unordered_path.c_str());
+        std::remove(bad_species_path.c_str());
+        std::cout << "  damaged files rejected " << all_rejected << " of 6" << std::endl;
+    }
+    return all_rejected == 6;
+}
+
+// Writes a generated matrix as CSV, converts it, and times reading it back:
+// MPI-IO collective reads of each rank's rows, and a memory map per rank.
+// Both must give the same sums as the matrix that was written, and both must
+// reject damaged copies of the file.
+bool benchmark_io(const Options& options) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int num_sites = options.num_sites * 4;
+    SparseSpeciesMatrix data = generate_sites(rank, num_sites, options.num_species,
+                                              [&](int) { return options.presence; });
+    const std::string csv_path = "/tmp/diversity_io_benchmark.csv";
+    const std::string path = "/tmp/diversity_io_benchmark.bin";
+    if (rank == 0) {
+        std::FILE* csv = std::fopen(csv_path.c_str(), "w");
+        std::fprintf(csv, "site,species,count\n");
+        for (int site = 0; site < num_sites; site++) {
+            for (SpeciesCount entry : data.row(site)) {
+                std::fprintf(csv, "%d,%d,%d\n", site, entry.species, entry.count);
+            }
+        }
+        std::fclose(csv);
+        auto begin = std::chrono::steady_clock::now();
+        MatrixFileHeader header = convert_csv_to_matrix_file(csv_path, path);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "  convert " << header.num_nonzeros << " CSV records in " << seconds * 1e3 << " ms ("
+                  << header.num_nonzeros / seconds / 1e6 << " M records/s)" << std::endl;
+        std::remove(csv_path.c_str());
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double busy = 0.0;
+    double storage[4];
+    SiteSums expected = run_static(data, num_sites, options.num_species, &busy, storage);
+    MatrixFileHeader header = read_matrix_header(path, MPI_COMM_WORLD);
+    RowPartition partition = partition_rows(static_cast<int>(header.num_sites), size);
+    double file_bytes = header.rows_offset + (header.num_sites + 1) * sizeof(uint64_t);
+
+    // MPI-IO: best of three, as the file is in the page cache after the first
+    double best = 1e30;
+    SparseSpeciesMatrix local_rows;
+    for (int round = 0; round < 3; round++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        local_rows = read_matrix_rows(path, header, partition, MPI_COMM_WORLD);
+        MPI_Barrier(MPI_COMM_WORLD);
+        best = std::min(best, MPI_Wtime() - start);
+    }
+    HybridSpeciesMatrix local_data(local_rows);
+    SiteSums from_file;
+    accumulate_sites(local_data, from_file);
+    from_file = reduce_local_sums(from_file, local_data, options.num_species, storage);
+
+    // Memory map: every rank walks its own rows in place
+    double mapped_best = 1e30;
+    double mapped_sums[3] = {0.0, 0.0, 0.0};
+    {
+        MappedMatrixFile mapped(path);
+        for (int round = 0; round < 3; round++) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double start = MPI_Wtime();
+            double local_sums[3] = {0.0, 0.0, 0.0};
+            for (int site = partition.begin(rank); site < partition.end(rank); site++) {
+                SparseRow row = mapped.row(site);
+                DiversityIndices indices = calculate_diversity(row.counts(), row.size());
+                local_sums[0] += indices.total;
+                local_sums[1] += indices.shannon;
+                local_sums[2] += indices.simpson;
+            }
+            MPI_Reduce(local_sums, mapped_sums, 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+            mapped_best = std::min(mapped_best, MPI_Wtime() - start);
+        }
+    }
+
+    bool damaged_ok = damaged_files_rejected(path, header, partition);
+    int failed = 0;
+    if (rank == 0) {
+        double tolerance = 1e-12 * num_sites;
+        bool ok = sums_match(expected, from_file, num_sites) && mapped_sums[0] == expected.abundance &&
+                  std::fabs(mapped_sums[1] - expected.shannon) <= tolerance &&
+                  std::fabs(mapped_sums[2] - expected.simpson) <= tolerance;
+        failed = ok && damaged_ok ? 0 : 1;
+        std::cout << "  MPI-IO read " << file_bytes / 1e6 << " MB on " << size << " ranks in " << best * 1e3
+                  << " ms (" << file_bytes / best / 1e9 << " GB/s)\n"
+                  << "  mmap read and diversity pass in " << mapped_best * 1e3 << " ms ("
+                  << file_bytes / mapped_best / 1e9 << " GB/s)\n"
+                  << "  results " << (ok ? "match" : "DIFFER") << std::endl;
+        std::remove(path.c_str());
+    }
+    MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return failed == 0;
+}
+
+// Loads each rank's sites into the incremental engine, then streams batches
+// of new observations and corrections, refreshing the global summary after
+// each batch. Compares the per-batch cost with a full recompute, and checks
+// the final summary against one computed from scratch. Also checks that a row
+// with an unknown species and a count overflowing an int are refused.
+bool benchmark_incremental(const Options& options) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int num_sites = options.num_sites * 4;
+    SparseSpeciesMatrix data = generate_sites(rank, num_sites, options.num_species,
+                                              [&](int) { return options.presence; });
+    double busy = 0.0;
+    double storage[4];
+    MPI_Barrier(MPI_COMM_WORLD);
+    double full_start = MPI_Wtime();
+    run_static(data, num_sites, options.num_species, &busy, storage);
+    double full_seconds = MPI_Wtime() - full_start;
+
+    RowPartition partition = partition_rows(num_sites, size);
+    SparseSpeciesMatrix local_rows = scatter_rows(data, partition, 0, MPI_COMM_WORLD);
+    IncrementalDiversity engine(partition.begin(rank), partition.count(rank), options.num_species);
+    double load_start = MPI_Wtime();
+    engine.load(local_rows);
+    double load_seconds = MPI_Wtime() - load_start;
+
+    // Every rank draws the same batches and applies the changes to its own sites;
+    // one in five is a correction removing some of what was counted
+    SpeciesMatrix shadow = local_rows.to_dense();
+    const int batches = 50;
+    const int batch_size = 1000;
+    std::vector<Observation> batch;
+    double apply_seconds = 0.0;
+    double refresh_seconds = 0.0;
+    DiversitySummary summary;
+    for (int b = 0; b < batches; b++) {
+        batch.clear();
+        for (int i = 0; i < batch_size; i++) {
+            uint64_t bits = mix_bits(static_cast<uint64_t>(b) * batch_size + i);
+            int site = static_cast<int>(bits % num_sites);
+            int species = static_cast<int>((bits >> 24) % options.num_species);
+            if (site < partition.begin(rank) || site >= partition.end(rank)) {
+                continue;
+            }
+            int delta = 1 + static_cast<int>((bits >> 48) % 5);
+            if ((bits >> 56) % 5 == 0) {
+                delta = -std::min(delta, engine.count(site, species));
+            }
+            batch.push_back(Observation{site, species, delta});
+            shadow.at(site - partition.begin(rank), species) += delta;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        engine.apply(batch);
+        double applied = MPI_Wtime();
+        summary = engine.global_summary(MPI_COMM_WORLD);
+        apply_seconds += applied - start;
+        refresh_seconds += MPI_Wtime() - applied;
+    }
+
+    // From scratch over the shadow copy, with the reference kernel
+    double local_sums[3] = {0.0, 0.0, 0.0};
+    std::vector<int> local_occupancy(options.num_species, 0);
+    for (int site = 0; site < shadow.num_sites(); site++) {
+        DiversityIndices indices = calculate_diversity_reference(shadow.row(site), shadow.row_length(site));
+        local_sums[0] += indices.total;
+        local_sums[1] += indices.shannon;
+        local_sums[2] += indices.simpson;
+        for (int j = 0; j < options.num_species; j++) {
+            local_occupancy[j] += shadow.at(site, j) > 0;
+        }
+    }
+    double sums[3];
+    std::vector<int> occupancy(options.num_species);
+    MPI_Reduce(local_sums, sums, 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local_occupancy.data(), occupancy.data(), options.num_species, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    // One site, four species: species 7 is unknown, and INT_MAX more of species 0 overflows
+    int refused = 0;
+    IncrementalDiversity small(0, 1, 4);
+    try {
+        small.load(SparseSpeciesMatrix(4, {0, 2}, {0, 7}, {5, 1}));
+    } catch (const std::out_of_range&) {
+        refused++;
+    }
+    small.load(SparseSpeciesMatrix(4, {0, 1}, {0}, {5}));
+    try {
+        small.apply({Observation{0, 0, std::numeric_limits<int>::max()}});
+    } catch (const std::invalid_argument&) {
+        refused++;
+    }
+    bool refused_ok = refused == 2 && small.count(0, 0) == 5;
+
+    int failed = 0;
+    if (rank == 0) {
+        long long observed = std::count_if(occupancy.begin(), occupancy.end(), [](int sites) { return sites > 0; });
+        bool ok = refused_ok && summary.abundance == sums[0] && summary.species_observed == observed &&
+                  std::fabs(summary.mean_shannon - sums[1] / num_sites) <= 1e-9 &&
+                  std::fabs(summary.mean_simpson - sums[2] / num_sites) <= 1e-9;
+        failed = ok ? 0 : 1;
+        std::cout << "  full job over " << num_sites << " sites: " << full_seconds * 1e3 << " ms\n"
+                  << "  engine load: " << load_seconds * 1e3 << " ms\n"
+                  << "  batch of " << batch_size << " changes: apply " << apply_seconds / batches * 1e6
+                  << " us, global refresh " << refresh_seconds / batches * 1e6 << " us\n"
+                  << "  mean Shannon " << summary.mean_shannon << ", mean Simpson " << summary.mean_simpson
+                  << ", results " << (ok ? "match" : "DIFFER") << " a full recompute, bad input "
+                  << (refused_ok ? "refused" : "ACCEPTED") << std::endl;
+    }
+    MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return failed == 0;
+}
+
+// Writes Bray-Curtis distance matrices for growing numbers of sites with
+// every rank and thread, times them, and spot-checks pairs read back from the
+// file against the reference. Times for 10k and 100k sites are projected
+// from the largest run, as the work grows with the square of the sites. Also
+// checks sites with counts too large for an int chunk sum.
+bool benchmark_beta(const Options& options) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    const std::string path = "/tmp/diversity_beta_benchmark.bin";
+    bool ok = true;
+    double largest_rate = 0.0;
+    for (int num_sites : {options.num_sites / 4, options.num_sites / 2, options.num_sites}) {
+        SparseSpeciesMatrix data = generate_sites(rank, num_sites, options.num_species,
+                                                  [&](int) { return options.presence; });
+        broadcast_rows(data, 0, MPI_COMM_WORLD);
+        SpeciesMatrix sites = data.to_dense();
+
+        for (BetaMetric metric : {BetaMetric::BrayCurtis, BetaMetric::Jaccard}) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double start = MPI_Wtime();
+            write_distance_matrix(sites, metric, path, MPI_COMM_WORLD);
+            MPI_Barrier(MPI_COMM_WORLD);
+            double seconds = MPI_Wtime() - start;
+            double pairs = 0.5 * num_sites * (num_sites - 1.0);
+
+            if (rank == 0) {
+                std::FILE* file = std::fopen(path.c_str(), "rb");
+                double max_error = 0.0;
+                for (int sample = 0; sample < 1000; sample++) {
+                    uint64_t bits = mix_bits(sample);
+                    int i = static_cast<int>(bits % num_sites);
+                    int j = static_cast<int>((bits >> 32) % num_sites);
+                    if (i == j) {
+                        continue;
+                    }
+                    if (i > j) {
+                        std::swap(i, j);
+                    }
+                    float stored = -1.0f;
+                    std::fseek(file, static_cast<long>(condensed_index(num_sites, i, j) * sizeof(float)), SEEK_SET);
+                    if (std::fread(&stored, sizeof(float), 1, file) != 1) {
+                        stored = -1.0f;
+                    }
+                    float expected = beta_distance_reference(sites.row(i), sites.row(j), sites.num_species(), metric);
+                    max_error = std::max(max_error, static_cast<double>(std::fabs(stored - expected)));
+                }
+                std::fclose(file);
+                ok = ok && max_error <= 1e-6;
+                std::cout << "  " << (metric == BetaMetric::BrayCurtis ? "Bray-Curtis" : "Jaccard    ") << " "
+                          << num_sites << " sites: " << seconds * 1e3 << " ms, " << pairs / seconds / 1e6
+                          << " M pairs/s, " << pairs * sizeof(float) / 1e6 << " MB written, max error "
+                          << max_error << std::endl;
+                if (metric == BetaMetric::BrayCurtis) {
+                    largest_rate = pairs / seconds;
+                }
+            }
+        }
+    }
+
+    int failed = 0;
+    if (rank == 0) {
+        // 1024 species of up to 2^27 individuals each: any 512-species chunk sum overflows an int
+        SpeciesMatrix large(3, 1024);
+        for (int site = 0; site < 3; site++) {
+            for (int k = 0; k < 1024; k++) {
+                large.at(site, k) = static_cast<int>((mix_bits(site * 1024 + k) >> 37) + (1 << 26));
+            }
+        }
+        std::vector<float> distances = distance_matrix(large, BetaMetric::BrayCurtis);
+        double large_error = 0.0;
+        for (int i = 0; i < 3; i++) {
+            for (int j = i + 1; j < 3; j++) {
+                float expected = beta_distance_reference(large.row(i), large.row(j), 1024, BetaMetric::BrayCurtis);
+                large_error = std::max(large_error, static_cast<double>(
+                                                        std::fabs(distances[condensed_index(3, i, j)] - expected)));
+            }
+        }
+        ok = ok && large_error <= 1e-6;
+        std::cout << "  Bray-Curtis with counts up to 2^27: max error " << large_error << std::endl;
+        for (double projected : {1e4, 1e5}) {
+            double pairs = 0.5 * projected * (projected - 1.0);
+            std::cout << "  projected Bray-Curtis for " << projected << " sites on " << size << " ranks: "
+                      << pairs / largest_rate << " s, " << pairs * sizeof(float) / 1e9 << " GB" << std::endl;
+        }
+        std::remove(path.c_str());
+        failed = ok ? 0 : 1;
+    }
+    MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return failed == 0;
+}
+
+// FNV-1a over the bytes of every result, in site order
+uint64_t resampling_checksum(const std::vector<double>& values) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data());
+    for (size_t i = 0; i < values.size() * sizeof(double); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Rarefaction and bootstrap over 1/32 of the usual sites, run once on
+// one thread and once on three; both runs, and runs with any number of ranks,
+// must give bit-identical results for the same seed
+bool benchmark_resampling(const Options& options) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int num_sites = std::max(1, options.num_sites / 32);
+    SparseSpeciesMatrix data = generate_sites(rank, num_sites, options.num_species,
+                                              [&](int) { return options.presence; });
+    RowPartition partition = partition_rows(num_sites, size);
+    SparseSpeciesMatrix local_rows = scatter_rows(data, partition, 0, MPI_COMM_WORLD);
+
+    ResampleOptions resample;
+    resample.seed = options.seed;
+    resample.replicates = options.replicates;
+    const int values_per_site = static_cast<int>(resample.depths.size()) + 4;
+
+    uint64_t checksums[2] = {0, 0};
+    double seconds[2] = {0.0, 0.0};
+    std::vector<double> all_values;
+    int max_threads = omp_get_max_threads();
+    for (int run = 0; run < 2; run++) {
+        omp_set_num_threads(run == 0 ? 1 : 3);
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        std::vector<SiteResampling> results = resample_sites(local_rows, partition.begin(rank), resample);
+        MPI_Barrier(MPI_COMM_WORLD);
+        seconds[run] = MPI_Wtime() - start;
+
+        std::vector<double> local_values;
+        for (const SiteResampling& result : results) {
+            local_values.insert(local_values.end(), result.rarefied_richness.begin(), result.rarefied_richness.end());
+            local_values.insert(local_values.end(), {result.shannon_low, result.shannon_high, result.simpson_low,
+                                                     result.simpson_high});
+        }
+        std::vector<int> value_counts(size);
+        std::vector<int> value_displacements(size);
+        for (int r = 0; r < size; r++) {
+            value_counts[r] = partition.count(r) * values_per_site;
+            value_displacements[r] = partition.begin(r) * values_per_site;
+        }
+        all_values.assign(rank == 0 ? static_cast<size_t>(num_sites) * values_per_site : 0, 0.0);
+        MPI_Gatherv(local_values.data(), static_cast<int>(local_values.size()), MPI_DOUBLE, all_values.data(),
+                    value_counts.data(), value_displacements.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        checksums[run] = resampling_checksum(all_values);
+    }
+    omp_set_num_threads(max_threads);
+
+    int failed = 0;
+    if (rank == 0) {
+        double total = 0.0;
+        for (int site = 0; site < num_sites; site++) {
+            for (SpeciesCount entry : data.row(site)) {
+                total += entry.count;
+            }
+        }
+        double draws = options.replicates * (total + num_sites * static_cast<double>(resample.depths.back()));
+        bool ok = checksums[0] == checksums[1];
+        failed = ok ? 0 : 1;
+        std::cout << "  " << num_sites << " sites x " << options.replicates << " replicates on " << size
+                  << " ranks, seed " << options.seed << "\n"
+                  << "  1 thread:  " << seconds[0] * 1e3 << " ms (" << draws / seconds[0] / 1e6
+                  << " M individuals/s), checksum " << std::hex << checksums[0] << std::dec << "\n"
+                  << "  3 threads: " << seconds[1] * 1e3 << " ms, checksum " << std::hex << checksums[1]
+                  << std::dec << "\n"
+                  << "  site 0: richness";
+        for (size_t d = 0; d < resample.depths.size(); d++) {
+            std::cout << " " << all_values[d] << "@" << resample.depths[d];
+        }
+        size_t ci = resample.depths.size();
+        std::cout << ", Shannon 95% CI [" << all_values[ci] << ", " << all_values[ci + 1] << "], Simpson ["
+                  << all_values[ci + 2] << ", " << all_values[ci + 3] << "]\n"
+                  << "  results " << (ok ? "identical" : "DIFFER") << " across thread counts" << std::endl;
+    }
+    MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return failed == 0;
+}
+
+// The single mutex-and-condition-variable queue LoadBalancer used before work
+// stealing, kept as the baseline for benchmark_tasks. Tasks added by a running
+// task after stopWorkers() begins may be dropped, so callers wait first.
+class MutexQueueBalancer {
+public:
+    explicit MutexQueueBalancer(size_t num_threads) : num_threads(num_threads) {}
+
+    template <typename TaskType>
+    void addTask(TaskType&& task) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            tasks.emplace(std::forward<TaskType>(task));
+        }
+        condition.notify_one();
+    }
+
+    void start() {
+        for (size_t i = 0; i < num_threads; i++) {
+            workers.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queue_mutex);
+                        condition.wait(lock, [this] { return stop || !tasks.empty(); });
+                        if (stop && tasks.empty()) {
+                            return;
+                        }
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+private:
+    size_t num_threads;
+    std::mutex queue_mutex;
+    std::queue<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    bool stop = false;
+    std::condition_variable condition;
+};
+
+// A task of a few dozen nanoseconds: hash the task index a few times
+uint64_t tiny_task(uint64_t index) {
+    uint64_t x = index;
+    for (int i = 0; i < 8; i++) {
+        x = mix_bits(x);
+    }
+    return x;
+}
+
+// Runs num_tasks tiny tasks on `balancer` and returns the seconds taken.
+// "flat" adds every task from this thread; "nested" adds 64 tasks which each
+// add their share of the rest from inside the pool. `results` must hold
+// num_tasks slots; each task writes its own.
+template <typename Balancer>
+double run_tiny_tasks(size_t num_threads, const std::string& shape, size_t num_tasks, std::vector<uint64_t>& results) {
+    std::atomic<size_t> done{0};
+    auto start = std::chrono::steady_clock::now();
+    Balancer balancer(num_threads);
+    balancer.start();
+    if (shape == "flat") {
+        for (size_t i = 0; i < num_tasks; i++) {
+            balancer.addTask([i, &results, &done] {
+                results[i] = tiny_task(i);
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+    } else {
+        const size_t parents = 64;
+        for (size_t p = 0; p < parents; p++) {
+            balancer.addTask([p, num_tasks, &balancer, &results, &done] {
+                for (size_t i = p; i < num_tasks; i += parents) {
+                    balancer.addTask([i, &results, &done] {
+                        results[i] = tiny_task(i);
+                        done.fetch_add(1, std::memory_order_relaxed);
+                    });
+                }
+            });
+        }
+    }
+    while (done.load() < num_tasks) {
+        std::this_thread::yield();
+    }
+    balancer.stopWorkers();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One million tiny tasks through the old single-queue balancer and the
+// work-stealing one, added from outside and from inside the pool, on 1, 2 and
+// 4 threads. Rank 0 only; every task's result is checked.
+bool benchmark_tasks(const Options&) {
+    const size_t num_tasks = 1000000;
+    std::vector<uint64_t> expected(num_tasks);
+    for (size_t i = 0; i < num_tasks; i++) {
+        expected[i] = tiny_task(i);
+    }
+
+    std::cout << "  " << num_tasks << " tiny tasks, " << std::thread::hardware_concurrency()
+              << " hardware threads; M tasks/s (mutex queue / work stealing)\n";
+    bool ok = true;
+    for (const std::string shape : {"flat", "nested"}) {
+        std::cout << "  " << (shape == "flat" ? "added from outside:" : "added from tasks:  ");
+        for (size_t threads : {1, 2, 4}) {
+            std::vector<uint64_t> results(num_tasks, 0);
+            double mutex_seconds = run_tiny_tasks<MutexQueueBalancer>(threads, shape, num_tasks, results);
+            ok = ok && results == expected;
+            std::fill(results.begin(), results.end(), 0);
+            double stealing_seconds = run_tiny_tasks<LoadBalancer>(threads, shape, num_tasks, results);
+            ok = ok && results == expected;
+            std::cout << "  " << threads << "T " << num_tasks / mutex_seconds / 1e6 << " / "
+                      << num_tasks / stealing_seconds / 1e6;
+        }
+        std::cout << "\n";
+    }
+    std::cout << "  results " << (ok ? "match" : "DIFFER") << std::endl;
+    return ok;
+}
+
+// Diversity sums over part of one site's counts, added to the site's totals
+struct SiteAccumulator {
+    std::mutex mutex;
+    double total = 0.0;
+    double sum_squares = 0.0;
+    double sum_n_log_n = 0.0;
+
+    void add(const int* counts, size_t length) {
+        double total_part = 0.0, squares_part = 0.0, n_log_n_part = 0.0;
+        for (size_t i = 0; i < length; i++) {
+            double n = counts[i];
+            total_part += n;
+            squares_part += n * n;
+            n_log_n_part += n > 0 ? n * std::log(n) : 0.0;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        total += total_part;
+        sum_squares += squares_part;
+        sum_n_log_n += n_log_n_part;
+    }
+};
+
+// Largest-first against FIFO on sites whose richness is heavy-tailed: site
+// richness follows a Pareto distribution with shape 0.9, so the richest site
+// holds about a third of the work. Each site waits an emulated 4 us per
+// species (see emulate_site_cost) besides computing its indices, and sites
+// are added in shuffled order. Makespan is from start() until every site is
+// done. Unsplit, no schedule beats the richest site; split, the bound is an
+// even share of all the work.
+bool benchmark_costs(const Options&) {
+    const int num_sites = 1000;
+    const size_t num_threads = 4;
+    const double species_ns = 4000.0;
+
+    std::vector<std::vector<int>> sites(num_sites);
+    std::vector<int> order(num_sites);
+    size_t total_species = 0, largest = 0;
+    for (int site = 0; site < num_sites; site++) {
+        size_t richness = static_cast<size_t>(10.0 * std::pow((site + 0.5) / num_sites, -1.0 / 0.9));
+        sites[site].resize(richness);
+        for (size_t species = 0; species < richness; species++) {
+            sites[site][species] = 1 + static_cast<int>(mix_bits(static_cast<uint64_t>(site) << 32 | species) % 100);
+        }
+        total_species += richness;
+        largest = std::max(largest, richness);
+        order[site] = site;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+    std::vector<DiversityIndices> expected(num_sites);
+    for (int site = 0; site < num_sites; site++) {
+        expected[site] = calculate_diversity_reference(sites[site].data(), sites[site].size());
+    }
+
+    bool ok = true;
+    // Runs every site on `balancer` via add(balancer, site, accumulators) and checks the indices
+    auto run = [&](LoadBalancer& balancer, const char* label, auto add) {
+        std::vector<SiteAccumulator> accumulators(num_sites);
+        for (int site : order) {
+            add(balancer, site, accumulators);
+        }
+        auto start = std::chrono::steady_clock::now();
+        balancer.start();
+        balancer.stopWorkers();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double worst = 0.0;
+        for (int site = 0; site < num_sites; site++) {
+            const SiteAccumulator& sums = accumulators[site];
+            DiversityIndices got = diversity_from_sums(sums.total, sums.sum_squares, sums.sum_n_log_n);
+            worst = std::max({worst, std::fabs(got.shannon - expected[site].shannon),
+                              std::fabs(got.simpson - expected[site].simpson),
+                              std::fabs(got.total - expected[site].total)});
+        }
+        ok = ok && worst < 1e-9;
+        std::cout << "  " << label << seconds * 1e3 << " ms" << (worst < 1e-9 ? "" : "  (indices DIFFER)") << "\n";
+    };
+    auto whole_site = [&](int site, std::vector<SiteAccumulator>& accumulators) {
+        return [&, site] {
+            accumulators[site].add(sites[site].data(), sites[site].size());
+            emulate_site_cost(sites[site].size(), species_ns);
+        };
+    };
+    auto kind_of = [&](int site) {
+        size_t bucket = 0;
+        while ((size_t{2} << bucket) <= sites[site].size()) {
+            bucket++;
+        }
+        return TaskKind{bucket};
+    };
+
+    std::cout << "  " << num_sites << " sites, " << total_species << " species in all, the richest " << largest
+              << "; " << num_threads << " threads\n  richest site " << largest * species_ns / 1e6
+              << " ms, even share " << total_species / num_threads * species_ns / 1e6 << " ms\n";
+
+    LoadBalancer fifo(num_threads);
+    run(fifo, "FIFO:                       ", [&](LoadBalancer& balancer, int site, auto& accumulators) {
+        balancer.addTask(whole_site(site, accumulators));
+    });
+
+    LoadBalancer given(num_threads, SchedulingMode::LargestFirst);
+    run(given, "largest first, given costs: ", [&](LoadBalancer& balancer, int site, auto& accumulators) {
+        balancer.addTask(whole_site(site, accumulators), static_cast<double>(sites[site].size()));
+    });
+
+    // Kinds are richness classes (powers of two); the first run teaches the
+    // balancer their costs and the second uses them
+    LoadBalancer learned(num_threads, SchedulingMode::LargestFirst);
+    for (const char* label : {"largest first, first run:   ", "largest first, learned:     "}) {
+        run(learned, label, [&](LoadBalancer& balancer, int site, auto& accumulators) {
+            balancer.addTask(kind_of(site), whole_site(site, accumulators));
+        });
+    }
+
+    LoadBalancer split(num_threads, SchedulingMode::LargestFirst);
+    run(split, "largest first, split sites: ", [&](LoadBalancer& balancer, int site, auto& accumulators) {
+        balancer.addRangeTask(0, sites[site].size(), static_cast<double>(sites[site].size()),
+                              [&, site](size_t first, size_t last) {
+            accumulators[site].add(sites[site].data() + first, last - first);
+            emulate_site_cost(last - first, species_ns);
+        });
+    });
+
+    // An uncosted task added from a task waits on the worker's own deque, and
+    // must still run after every costed task that is waiting
+    std::vector<char> ran;
+    LoadBalancer ordered(1, SchedulingMode::LargestFirst);
+    ordered.addTask([&] {
+        ran.push_back('x');
+        ordered.addTask([&] { ran.push_back('u'); });
+    }, 10.0);
+    ordered.addTask([&] { ran.push_back('y'); }, 5.0);
+    ordered.start();
+    ordered.stopWorkers();
+    bool order_ok = std::string(ran.begin(), ran.end()) == "xyu";
+
+    std::cout << "  indices " << (ok ? "match" : "DIFFER") << ", uncosted tasks run "
+              << (order_ok ? "after" : "BEFORE") << " waiting costed tasks" << std::endl;
+    return ok && order_ok;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    Options options = parse_options(argc, argv);
+    if (options.command == "kernels") {
+        int failed = 0;
+        if (rank == 0) {
+            failed = check_diversity_kernels() ? 0 : 1;
+        }
+        MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Finalize();
+        return failed;
+    }
+    if (options.command == "convert") {
+        int failed = 0;
+        if (rank == 0) {
+            try {
+                MatrixFileHeader header = convert_csv_to_matrix_file(options.csv, options.output);
+                std::cout << "Wrote " << options.output << ": " << header.num_sites << " sites, "
+                          << header.num_species << " species, " << header.num_nonzeros << " non-zero counts"
+                          << std::endl;
+            } catch (const std::exception& error) {
+                std::cerr << error.what() << std::endl;
+                failed = 1;
+            }
+        }
+        MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Finalize();
+        return failed;
+    }
+    if (options.command == "costs") {
+        int failed = 0;
+        if (rank == 0) {
+            std::cout << "FIFO vs largest-first scheduling of heavy-tailed sites:" << std::endl;
+            failed = benchmark_costs(options) ? 0 : 1;
+        }
+        MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Finalize();
+        return failed;
+    }
+    if (options.command == "tasks") {
+        int failed = 0;
+        if (rank == 0) {
+            std::cout << "Single-queue vs work-stealing task balancing:" << std::endl;
+            failed = benchmark_tasks(options) ? 0 : 1;
+        }
+        MPI_Bcast(&failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Finalize();
+        return failed;
+    }
+    if (options.command == "resample") {
+        if (rank == 0) {
+            std::cout << "Rarefaction and bootstrap resampling:" << std::endl;
+        }
+        bool ok = benchmark_resampling(options);
+        MPI_Finalize();
+        return ok ? 0 : 1;
+    }
+    if (options.command == "beta") {
+        if (rank == 0) {
+            std::cout << "Beta-diversity distance matrices:" << std::endl;
+        }
+        bool ok = benchmark_beta(options);
+        MPI_Finalize();
+        return ok ? 0 : 1;
+    }
+    if (options.command == "incremental") {
+        if (rank == 0) {
+            std::cout << "Incremental diversity updates:" << std::endl;
+        }
+        bool ok = benchmark_incremental(options);
+        MPI_Finalize();
+        return ok ? 0 : 1;
+    }
+    if (options.command == "io") {
+        if (rank == 0) {
+            std::cout << "Matrix file conversion and read throughput:" << std::endl;
+        }
+        bool ok = benchmark_io(options);
+        MPI_Finalize();
+        return ok ? 0 : 1;
+    }
+    if (options.command == "pipeline") {
+        if (rank == 0) {
+            std::cout << "Blocking vs pipelined distribution and reduction:" << std::endl;
+        }
+        bool ok = benchmark_pipeline(options);
+        MPI_Finalize();
+        return ok ? 0 : 1;
+    }
+    if (options.command == "schedule") {
+        if (rank == 0) {
+            std::cout << "Static vs dynamic scheduling on skewed sites:" << std::endl;
+        }
+        bool ok = benchmark_schedules(options);
+        MPI_Finalize();
+        return ok ? 0 : 1;
+    }
+
+    int total_tasks = options.num_sites;
+    double busy = 0.0;
+    double storage[4] = {0.0, 0.0, 0.0, 0.0};
+    SiteSums sums;
+    if (!options.input.empty()) {
+        // Every rank reads its own sites from the file
+        MatrixFileHeader header;
+        try {
+            header = read_matrix_header(options.input, MPI_COMM_WORLD);
+        } catch (const std::exception& error) {
+            if (rank == 0) {
+                std::cerr << error.what() << std::endl;
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        total_tasks = static_cast<int>(header.num_sites);
+        options.num_species = static_cast<int>(header.num_species);
+        options.schedule = "static";
+        RowPartition partition = partition_rows(total_tasks, size);
+        SparseSpeciesMatrix local_rows;
+        try {
+            local_rows = read_matrix_rows(options.input, header, partition, MPI_COMM_WORLD);
+        } catch (const std::exception& error) {
+            if (rank == 0) {
+                std::cerr << error.what() << std::endl;
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        HybridSpeciesMatrix local_data(local_rows);
+        accumulate_sites(local_data, sums);
+        sums = reduce_local_sums(sums, local_data, options.num_species, storage);
+    } else {
+        SparseSpeciesMatrix biodiversity_data = generate_sites(rank, options.num_sites, options.num_species,
+                                                               [&](int) { return options.presence; });
+        sums = run_schedule(options.schedule, biodiversity_data, total_tasks, options.num_species, &busy, storage);
+    }
+
+    if (rank == 0) {
+        std::cout << "Sites: " << total_tasks << ", species: " << options.num_species << std::endl;
+        std::cout << "Total abundance: " << sums.abundance << std::endl;
+        std::cout << "Mean Shannon entropy: " << sums.shannon / total_tasks << std::endl;
+        std::cout << "Mean Simpson diversity: " << sums.simpson / total_tasks << std::endl;
+        int observed = static_cast<int>(std::count_if(sums.occupancy.begin(), sums.occupancy.end(),
+                                                      [](int sites) { return sites > 0; }));
+        std::cout << "Species observed: " << observed << " of " << options.num_species << std::endl;
+        if (options.schedule == "static") {
+            std::cout << "Matrix storage: " << storage[0] / 1e6 << " MB, dense would be " << storage[1] / 1e6
+                      << " MB (" << storage[1] / storage[0] << "x smaller, " << storage[2] << " of " << storage[3]
+                      << " blocks sparse)" << std::endl;
+        }
+    }
+
+    MPI_Finalize();
+    return 0;
+}